@@ -7,6 +7,7 @@
 #include "ast_stmt.h"
 #include "symtable.h"     
 #include "errors.h"   
+#include "checkcache.h"
          
 Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
     Assert(n != NULL);
@@ -16,6 +17,7 @@ Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
 VarDecl::VarDecl(Identifier *n, Type *t, Expr *e) : Decl(n) {
     Assert(n != NULL && t != NULL);
     (type=t)->SetParent(this);
+    assignTo = NULL;
     if (e) (assignTo=e)->SetParent(this);
 }
   
@@ -30,6 +32,7 @@ FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
     (returnType=r)->SetParent(this);
     (formals=d)->SetParentAll(this);
     body = NULL;
+    firstLine = lastLine = 0;
 }
 
 void FnDecl::SetFunctionBody(Stmt *b) { 
@@ -73,6 +76,14 @@ void FnDecl::Check() {
     symtab->AddFnDeclSymbol(id->GetName(), this);
     //symtab->AddSymbol(id->GetName(),this);
 
+    // Nothing the body depends on changed since the last run, reuse its result
+    if (CheckCache::Replay(this, symtab))
+        return;
+
+    int mark = ReportError::NumBuffered();
+    set<string> deps;
+    symtab->StartRecordingDependencies(&deps);
+
     // Push a new scope for this function declarartion
     symtab->PushScope(Func);
 
@@ -92,4 +103,7 @@ void FnDecl::Check() {
     // Finish semantic check for this function declaration,
     // thus pop its scope
     symtab->PopScope();
+
+    symtab->StopRecordingDependencies();
+    CheckCache::Record(this, symtab, deps, mark);
 }
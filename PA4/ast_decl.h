@@ -65,11 +65,15 @@ class FnDecl : public Decl
     List<VarDecl*> *formals;
     Type *returnType;
     Stmt *body;
+    int firstLine, lastLine;    // source lines of the whole definition
     
   public:
-    FnDecl() : Decl(), formals(NULL), returnType(NULL), body(NULL) {}
+    FnDecl() : Decl(), formals(NULL), returnType(NULL), body(NULL), firstLine(0), lastLine(0) {}
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
     void SetFunctionBody(Stmt *b);
+    void SetSourceLines(yyltype span) { firstLine = span.first_line; lastLine = span.last_line; }
+    int GetFirstLine() const { return firstLine; }
+    int GetLastLine() const { return lastLine; }
     const char *GetPrintNameForNode() { return "FnDecl"; }
     void PrintChildren(int indentLevel);
 
@@ -8,6 +8,7 @@
 #include "ast_expr.h"
 #include "errors.h"
 #include "symtable.h"
+#include "checkcache.h"
 #include "string.h"
 
 Program::Program(List<Decl*> *d) {
@@ -96,12 +97,16 @@ void Program::Check() {
      *      and polymorphism in the node classes.
      */
 
+    CheckCache::Load();
+
     if ( decls->NumElements() > 0 ) {
         for ( int i = 0; i < decls->NumElements(); ++i ) {
             Decl *d = decls->Nth(i);
             d->Check();
         }
     }
+
+    CheckCache::Save();
 }
 
 void StmtBlock::Check() {
@@ -0,0 +1,189 @@
+/**
+ * File: checkcache.cc
+ * -------------------
+ * Implementation of the incremental checking cache. The cache file is plain
+ * text, one record per line:
+ *
+ *    glc-check-cache 1
+ *    fn <name> <body hash>
+ *    dep <name> <signature>
+ *    diag <line within the function> <first column> <last column> <message>
+ *
+ * dep and diag lines belong to the closest fn line above them.
+ */
+
+#include "checkcache.h"
+#include "ast_decl.h"
+#include "ast_type.h"
+#include "lexer.h"      // for GetLineNumbered
+#include "symtable.h"
+#include "utility.h"
+#include <fstream>
+#include <sstream>
+#include <inttypes.h>
+
+static const char *CacheHeader = "glc-check-cache 1";
+
+string CheckCache::cacheFile;
+map<string, CheckCache::Entry> CheckCache::previous;
+map<string, CheckCache::Entry> CheckCache::current;
+int CheckCache::numReused = 0;
+int CheckCache::numChecked = 0;
+
+// 64-bit FNV-1a
+static uint64_t Hash(uint64_t h, const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static const uint64_t HashSeed = 14695981039346656037ULL;
+
+/**
+ * Fingerprint of the source lines a function spans. Runs of whitespace
+ * count as a single blank so re-indenting a function doesn't invalidate it,
+ * but anything else (including comments) does.
+ */
+uint64_t CheckCache::HashLines(int firstLine, int lastLine) {
+    uint64_t h = HashSeed;
+    for (int n = firstLine; n <= lastLine; n++) {
+        const char *line = GetLineNumbered(n);
+        if (!line) continue;
+
+        bool blank = true;
+        for (const char *c = line; *c; c++) {
+            if (*c == ' ' || *c == '\t' || *c == '\r') {
+                blank = true;
+                continue;
+            }
+            if (blank) h = Hash(h, " ", 1);
+            blank = false;
+            h = Hash(h, c, 1);
+        }
+        h = Hash(h, "\n", 1);
+    }
+    return h;
+}
+
+/**
+ * Signature of a global declaration as seen by the code referring to it.
+ * 0 stands for "not declared".
+ */
+uint64_t CheckCache::Signature(Decl *d) {
+    if (!d) return 0;
+
+    ostringstream s;
+    if (FnDecl *fn = dynamic_cast<FnDecl*>(d)) {
+        List<VarDecl*> *formals = fn->GetFormals();
+        s << "fn " << fn->GetType() << "(";
+        for (int i = 0; i < formals->NumElements(); i++)
+            s << formals->Nth(i)->GetType() << ",";
+        s << ")";
+    } else if (VarDecl *var = dynamic_cast<VarDecl*>(d)) {
+        s << "var " << var->GetType();
+    }
+
+    string sig = s.str();
+    uint64_t h = Hash(HashSeed, sig.data(), sig.size());
+    return h ? h : 1;
+}
+
+void CheckCache::Load() {
+    if (!IsEnabled()) return;
+
+    ifstream in(cacheFile.c_str());
+    string line;
+    if (!getline(in, line) || line != CacheHeader)
+        return; // missing or from another version, start from scratch
+
+    Entry *entry = NULL;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string kind, name;
+        fields >> kind;
+
+        if (kind == "fn") {
+            fields >> name;
+            entry = &previous[name];
+            fields >> hex >> entry->bodyHash;
+        } else if (kind == "dep" && entry) {
+            uint64_t sig;
+            fields >> name >> hex >> sig;
+            entry->deps[name] = sig;
+        } else if (kind == "diag" && entry) {
+            ReportError::Diagnostic d;
+            fields >> d.line >> d.firstColumn >> d.lastColumn;
+            fields.get(); // the blank before the message
+            getline(fields, d.msg);
+            entry->diags.push_back(d);
+        }
+    }
+}
+
+void CheckCache::Save() {
+    if (!IsEnabled()) return;
+
+    ostringstream out;
+    out << CacheHeader << "\n" << hex;
+    for (map<string, Entry>::iterator it = current.begin(); it != current.end(); ++it) {
+        Entry &e = it->second;
+        out << "fn " << it->first << " " << e.bodyHash << "\n";
+        for (map<string, uint64_t>::iterator dep = e.deps.begin(); dep != e.deps.end(); ++dep)
+            out << "dep " << dep->first << " " << dep->second << "\n";
+        for (size_t i = 0; i < e.diags.size(); i++) {
+            ReportError::Diagnostic &d = e.diags[i];
+            out << dec << "diag " << d.line << " " << d.firstColumn << " "
+                << d.lastColumn << " " << d.msg << "\n" << hex;
+        }
+    }
+
+    ofstream file(cacheFile.c_str());
+    file << out.str();
+
+    PrintDebug("incremental", "%d functions checked, %d reused", numChecked, numReused);
+}
+
+bool CheckCache::Replay(FnDecl *fn, SymbolTable *symtab) {
+    if (!IsEnabled() || fn->GetFirstLine() == 0) return false;
+
+    string name = fn->GetIdentifier()->GetName();
+    map<string, Entry>::iterator prev = previous.find(name);
+    if (prev == previous.end()) return false;
+
+    Entry &e = prev->second;
+    if (e.bodyHash != HashLines(fn->GetFirstLine(), fn->GetLastLine()))
+        return false;
+
+    for (map<string, uint64_t>::iterator dep = e.deps.begin(); dep != e.deps.end(); ++dep)
+        if (Signature(symtab->FindSymbolInAllScopes(dep->first)) != dep->second)
+            return false;
+
+    // The function may have moved, its diagnostics are kept relative to it
+    for (size_t i = 0; i < e.diags.size(); i++) {
+        ReportError::Diagnostic d = e.diags[i];
+        if (d.line) d.line += fn->GetFirstLine() - 1;
+        ReportError::Report(d);
+    }
+
+    current[name] = e;
+    numReused++;
+    return true;
+}
+
+void CheckCache::Record(FnDecl *fn, SymbolTable *symtab, const set<string> &deps, int mark) {
+    numChecked++;
+    if (!IsEnabled() || fn->GetFirstLine() == 0) return;
+
+    Entry &e = current[fn->GetIdentifier()->GetName()];
+    e.bodyHash = HashLines(fn->GetFirstLine(), fn->GetLastLine());
+
+    e.deps.clear();
+    for (set<string>::const_iterator name = deps.begin(); name != deps.end(); ++name)
+        e.deps[*name] = Signature(symtab->FindSymbolInAllScopes(*name));
+
+    e.diags = ReportError::BufferedSince(mark);
+    for (size_t i = 0; i < e.diags.size(); i++)
+        if (e.diags[i].line) e.diags[i].line -= fn->GetFirstLine() - 1;
+}
@@ -0,0 +1,69 @@
+/**
+ * File: checkcache.h
+ * ------------------
+ * Incremental semantic checking. Each function is fingerprinted by the text
+ * of the source lines it spans; its diagnostics are kept together with the
+ * signatures of every global name its body looked up (called functions and
+ * global variables). On the next run a function whose text is unchanged and
+ * whose dependencies still have the same signatures is not checked again,
+ * its previous diagnostics are replayed instead.
+ *
+ * The cache lives in the file given with --check-cache=<file>. Without it
+ * every function is checked as usual.
+ */
+
+#ifndef _H_checkcache
+#define _H_checkcache
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "errors.h"
+
+using namespace std;
+
+class Decl;
+class FnDecl;
+class SymbolTable;
+
+class CheckCache {
+  public:
+    static void SetFile(const char *path) { cacheFile = path; }
+    static bool IsEnabled() { return !cacheFile.empty(); }
+
+    // Reads the previous run's results, writes this run's results
+    static void Load();
+    static void Save();
+
+    // Replays the cached diagnostics of fn and returns true when nothing it
+    // depends on changed; symtab must be at global scope.
+    static bool Replay(FnDecl *fn, SymbolTable *symtab);
+
+    // Stores the result of checking fn: the global names it looked up and
+    // the diagnostics reported since the mark taken before checking it.
+    static void Record(FnDecl *fn, SymbolTable *symtab, const set<string> &deps, int mark);
+
+    // Counters shown with -d incremental
+    static int NumReused() { return numReused; }
+    static int NumChecked() { return numChecked; }
+
+  private:
+    struct Entry {
+        uint64_t bodyHash;
+        map<string, uint64_t> deps;                 // name -> signature
+        vector<ReportError::Diagnostic> diags;      // line 1 is the function's first line
+    };
+
+    static uint64_t HashLines(int firstLine, int lastLine);
+    static uint64_t Signature(Decl *d);
+
+    static string cacheFile;
+    static map<string, Entry> previous;   // loaded from the cache file
+    static map<string, Entry> current;    // what Save() will write
+    static int numReused;
+    static int numChecked;
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include <sstream>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 using namespace std;
 
@@ -18,27 +19,148 @@ using namespace std;
 #include "ast_decl.h"
 
 int ReportError::numErrors = 0;
+int ReportError::maxErrors = 0;
+diagFormatT ReportError::outputFormat = TextFormat;
+vector<ReportError::Diagnostic> ReportError::diagnostics;
+unordered_set<string> ReportError::reported;
 
-void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
+void ReportError::UnderlineErrorInLine(string &out, const char *line, const Diagnostic &d) {
     if (!line) return;
-    cerr << line << endl;
-    for (int i = 1; i <= pos->last_column; i++)
-        cerr << (i >= pos->first_column ? '^' : ' ');
-    cerr << endl;
+    out += line;
+    out += '\n';
+    for (int i = 1; i <= d.lastColumn; i++)
+        out += (i >= d.firstColumn ? '^' : ' ');
+    out += '\n';
 }
 
- 
- 
-void ReportError::OutputError(yyltype *loc, string msg) {
+/**
+ * Records the diagnostic instead of printing it. A diagnostic identical to
+ * one already reported (same span, same message) is a cascade and dropped.
+ * Once the --max-errors limit is hit everything buffered is rendered and
+ * the compiler stops.
+ */
+void ReportError::Report(const Diagnostic &d) {
+    ostringstream key;
+    key << d.line << ':' << d.firstColumn << ':' << d.lastColumn << ':' << d.msg;
+    if (!reported.insert(key.str()).second)
+        return;
+
+    diagnostics.push_back(d);
     numErrors++;
-    fflush(stdout); // make sure any buffered text has been output
-    if (loc) {
-        cerr << endl << "*** Error line " << loc->first_line << "." << endl;
-        UnderlineErrorInLine(GetLineNumbered(loc->first_line), loc);
-    } else {
-        cerr << endl << "*** Error." << endl;
+
+    if (maxErrors > 0 && numErrors >= maxErrors) {
+        Flush();
+        exit(-1);
+    }
+}
+
+void ReportError::OutputError(yyltype *loc, string msg) {
+    Diagnostic d;
+    d.line = loc ? loc->first_line : 0;
+    d.firstColumn = loc ? loc->first_column : 0;
+    d.lastColumn = loc ? loc->last_column : 0;
+    d.msg = msg;
+    Report(d);
+}
+
+vector<ReportError::Diagnostic> ReportError::BufferedSince(int mark) {
+    return vector<Diagnostic>(diagnostics.begin() + mark, diagnostics.end());
+}
+
+void ReportError::RenderText(string &out) {
+    for (const Diagnostic &d : diagnostics) {
+        if (d.line) {
+            out += "\n*** Error line " + to_string(d.line) + ".\n";
+            UnderlineErrorInLine(out, GetLineNumbered(d.line), d);
+        } else {
+            out += "\n*** Error.\n";
+        }
+        out += "*** " + d.msg + "\n\n";
+    }
+    if (maxErrors > 0 && numErrors >= maxErrors)
+        out += "*** Too many errors, stopping after " + to_string(maxErrors) + ".\n";
+}
+
+static void AppendJsonString(string &out, const string &s) {
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else
+                    out += c;
+        }
+    }
+    out += '"';
+}
+
+void ReportError::RenderJson(string &out) {
+    out += "{\"diagnostics\":[";
+    for (size_t i = 0; i < diagnostics.size(); ++i) {
+        const Diagnostic &d = diagnostics[i];
+        out += (i ? ",\n" : "\n");
+        out += "{\"severity\":\"error\",\"line\":" + to_string(d.line)
+             + ",\"column\":" + to_string(d.firstColumn)
+             + ",\"endColumn\":" + to_string(d.lastColumn) + ",\"message\":";
+        AppendJsonString(out, d.msg);
+        out += '}';
+    }
+    out += "\n],\"errorCount\":" + to_string(numErrors) + ",\"truncated\":";
+    out += (maxErrors > 0 && numErrors >= maxErrors) ? "true" : "false";
+    out += "}\n";
+}
+
+void ReportError::RenderSarif(string &out) {
+    out += "{\"version\":\"2.1.0\","
+           "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+           "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"glc\"}},\"results\":[";
+    for (size_t i = 0; i < diagnostics.size(); ++i) {
+        const Diagnostic &d = diagnostics[i];
+        out += (i ? ",\n" : "\n");
+        out += "{\"level\":\"error\",\"message\":{\"text\":";
+        AppendJsonString(out, d.msg);
+        out += "}";
+        if (d.line) {
+            // SARIF columns are 1-based with an exclusive end
+            out += ",\"locations\":[{\"physicalLocation\":{"
+                   "\"artifactLocation\":{\"uri\":\"stdin\"},"
+                   "\"region\":{\"startLine\":" + to_string(d.line)
+                 + ",\"startColumn\":" + to_string(d.firstColumn)
+                 + ",\"endColumn\":" + to_string(d.lastColumn + 1) + "}}}]";
+        }
+        out += '}';
     }
-    cerr << "*** " << msg << endl << endl;
+    out += "\n]}]}\n";
+}
+
+/**
+ * Renders every buffered diagnostic in the selected format and writes the
+ * result to stderr in one go. Called once, when the compiler exits or the
+ * error limit is reached.
+ */
+void ReportError::Flush() {
+    string out;
+    switch (outputFormat) {
+        case TextFormat:  if (diagnostics.empty()) return;
+                          RenderText(out);
+                          break;
+        case JsonFormat:  RenderJson(out);
+                          break;
+        case SarifFormat: RenderSarif(out);
+                          break;
+    }
+    diagnostics.clear();
+
+    fflush(stdout); // make sure any buffered text has been output
+    fwrite(out.data(), 1, out.size(), stderr);
+    fflush(stderr);
 }
 
 
@@ -83,6 +205,7 @@ void ReportError::DeclConflict(Decl *decl, Decl *prevDecl) {
 }
 
 void ReportError::InvalidInitialization(Identifier *id, Type *lType, Type *rType) {
+    if (lType->IsError() || rType->IsError()) return; // cascaded, already reported
     ostringstream s;
     s << "Wrong initialization of identifier '" << id << "': idType '" 
       << lType << "' exprType '" << rType << "'" ;
@@ -113,6 +236,7 @@ void ReportError::LessFormals(Identifier *id, int expCount, int actualCount) {
 
 void ReportError::FormalsTypeMismatch(Identifier *id, int pos, Type *expType, Type *actualType)
 { 
+    if (actualType->IsError()) return; // cascaded, already reported
     ostringstream s;
     s << "Formal type mismatch in function '" << id << "' at pos " << pos 
       << ": expected '" << expType << "', given '" << actualType <<"'";
@@ -132,18 +256,21 @@ void ReportError::NotAnArray(Identifier *id) {
 }
 
 void ReportError::IncompatibleOperands(Operator *op, Type *lhs, Type *rhs) {
+    if (lhs->IsError() || rhs->IsError()) return; // cascaded, already reported
     ostringstream s;
     s << "Incompatible operands: " << lhs << " " << op << " " << rhs;
     OutputError(op->GetLocation(), s.str());
 }
      
 void ReportError::IncompatibleOperand(Operator *op, Type *rhs) {
+    if (rhs->IsError()) return; // cascaded, already reported
     ostringstream s;
     s << "Incompatible operand: " << op << " " << rhs;
     OutputError(op->GetLocation(), s.str());
 }
 
 void ReportError::ReturnMismatch(ReturnStmt *rStmt, Type *given, Type *expected) {
+    if (given->IsError()) return; // cascaded, already reported
     ostringstream s;
     s << "Incompatible return: " << given << " given, " << expected << " expected";
     OutputError(rStmt->GetLocation(), s.str());
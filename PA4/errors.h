@@ -14,6 +14,8 @@
 #define _errors_h_
 
 #include <string>
+#include <vector>
+#include <unordered_set>
 #include "location.h"
 #include "ast_decl.h"
 
@@ -49,6 +51,12 @@ class ReturnStmt;
 class Decl;
 class Operator;
 
+typedef enum {
+      TextFormat,
+      JsonFormat,
+      SarifFormat
+} diagFormatT;
+
 typedef enum {
       LookingForType,
       LookingForVariable,
@@ -101,12 +109,40 @@ class ReportError {
   static void Formatted(yyltype *loc, const char *format, ...);
 
 
-  // Returns number of error messages printed
+  // Returns number of error messages reported (after de-duplication)
   static int NumErrors() { return numErrors; }
-  
+
+  // Diagnostics are buffered as they are reported and rendered with a
+  // single write to stderr by Flush(). SetMaxErrors(0) means no limit.
+  static void SetFormat(diagFormatT format) { outputFormat = format; }
+  static void SetMaxErrors(int max) { maxErrors = max; }
+  static void Flush();
+
+  // Compact copy of the location, the yyltype itself may not outlive us
+  struct Diagnostic {
+      int line, firstColumn, lastColumn;    // line 0 means no location
+      string msg;
+  };
+
+  // Used by the incremental checker to capture the diagnostics of one
+  // function (everything buffered after NumBuffered() was taken) and to
+  // report them again on a later run without re-checking.
+  static int NumBuffered() { return diagnostics.size(); }
+  static vector<Diagnostic> BufferedSince(int mark);
+  static void Report(const Diagnostic &d);
+
  private:
-  static void UnderlineErrorInLine(const char *line, yyltype *pos);
+
+  static void UnderlineErrorInLine(string &out, const char *line, const Diagnostic &d);
+  static void RenderText(string &out);
+  static void RenderJson(string &out);
+  static void RenderSarif(string &out);
   static void OutputError(yyltype *loc, string msg);
+
+  static vector<Diagnostic> diagnostics;
+  static unordered_set<string> reported;    // keys of diagnostics seen so far
+  static diagFormatT outputFormat;
+  static int maxErrors;
   static int numErrors;
 };
 #endif
@@ -17,7 +17,8 @@
  * on any debugging flags requested by the user when invoking the program.
  * InitScanner() is used to set up the scanner.
  * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * attempt to parse a complete program from the input. Diagnostics are
+ * buffered while parsing/checking and written out by ReportError::Flush().
  */
 int main(int argc, char *argv[])
 {
@@ -25,6 +26,7 @@ int main(int argc, char *argv[])
     InitLexer();
     InitParser();
     yyparse();
+    ReportError::Flush();
     return (ReportError::NumErrors() == 0? 0 : -1);
 }
 
@@ -202,7 +202,7 @@ TypeSpecifier         : T_Void     { $$ = Type::voidType; }
                       ;
 
 FuncDefinition        : FuncPrototype CompoundStmtWithScope
-                        { ($$=$1)->SetFunctionBody($2); }
+                        { ($$=$1)->SetFunctionBody($2); $$->SetSourceLines(@$); }
                       | FuncPrototype T_Semicolon
                         { $$ = $1; }
                       ;
@@ -10,6 +10,7 @@ SymbolTable::SymbolTable() {
     Scope initial_scope;
     initial_scope.has_return = false;
     initial_scope.creator = Program;
+    dependencies = NULL;
 
     symtab_vec.push_back(initial_scope);
     current_scope = &(symtab_vec.back());
@@ -91,11 +92,8 @@ FnDecl* SymbolTable::GetLatestFnDecl() {
 }
 
 Decl* SymbolTable::FindSymbolInCurrentScope(string name) {
-    typedef map<string, Decl*>::const_iterator MapIterator;    
-    for (MapIterator iter = (current_scope->scope_map).begin(); iter != (current_scope->scope_map).end(); iter++)
-    {            
-        if(iter->first == name) return iter->second;    
-    }
+    map<string, Decl*>::const_iterator iter = (current_scope->scope_map).find(name);
+    if (iter != (current_scope->scope_map).end()) return iter->second;
     
     // cout << "Cannot find symbol: " << name << " in SymbolTable::FindSymbolInCurrentScope()!!!" << endl;
     return NULL;
@@ -104,13 +102,23 @@ Decl* SymbolTable::FindSymbolInCurrentScope(string name) {
 Decl* SymbolTable::FindSymbolInAllScopes(string name) {
     for (int i = symtab_vec.size() - 1; i >= 0 ; i--)
     {
-        typedef map<string, Decl*>::const_iterator MapIterator;    
-        for (MapIterator iter = symtab_vec[i].scope_map.begin(); iter != symtab_vec[i].scope_map.end(); iter++)
-        {            
-            if(iter->first == name) return iter->second;                            
+        map<string, Decl*>::const_iterator iter = symtab_vec[i].scope_map.find(name);
+        if (iter != symtab_vec[i].scope_map.end()) {
+            if (i == 0 && dependencies) dependencies->insert(name);
+            return iter->second;
         }
     }  
 
+    if (dependencies) dependencies->insert(name);
+
     // cout << "Cannot find symbol: " << name << " in SymbolTable::FindSymbolInAllScopes()!!!" << endl;
     return NULL;    
 }
+
+void SymbolTable::StartRecordingDependencies(set<string> *names) {
+    dependencies = names;
+}
+
+void SymbolTable::StopRecordingDependencies() {
+    dependencies = NULL;
+}
@@ -5,6 +5,7 @@
  */
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <iostream>
@@ -27,6 +28,7 @@ class SymbolTable {
         vector<Scope> symtab_vec;
         Scope *current_scope;
         FnDecl* latestFnDecl;
+        set<string> *dependencies;  // names resolved outside the function, or NULL
 
     public:
         SymbolTable();     
@@ -45,4 +47,10 @@ class SymbolTable {
         Decl* FindSymbolInCurrentScope(string name);
         Decl* FindSymbolInAllScopes(string name);
 
+        // While recording, every lookup that resolves at global scope (or
+        // fails) is remembered, so the incremental checker knows what a
+        // function body depends on besides its own text.
+        void StartRecordingDependencies(set<string> *names);
+        void StopRecordingDependencies();
+
 };
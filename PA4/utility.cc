@@ -5,6 +5,8 @@
  */
 
 #include "utility.h"
+#include "errors.h"
+#include "checkcache.h"
 #include <stdarg.h>
 #include <string.h>
 #include <vector>
@@ -20,6 +22,7 @@ void Failure(const char *format, ...) {
   va_start(args, format);
   vsprintf(errbuf, format, args);
   va_end(args);
+  ReportError::Flush(); // don't lose diagnostics buffered so far
   fflush(stdout);
   fprintf(stderr,"\n*** Failure: %s\n\n", errbuf);
   abort();
@@ -59,18 +62,35 @@ void PrintDebug(const char *key, const char *format, ...) {
 }
 
 void ParseCommandLine(int argc, char *argv[]) {
-  if (argc == 1)
+  int i = 1;
+
+  // Diagnostic options come before the debug keys
+  for (; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+    if (strncmp(argv[i], "--max-errors=", 13) == 0)
+      ReportError::SetMaxErrors(atoi(argv[i] + 13));
+    else if (strcmp(argv[i], "--diagnostics-format=text") == 0)
+      ReportError::SetFormat(TextFormat);
+    else if (strcmp(argv[i], "--diagnostics-format=json") == 0)
+      ReportError::SetFormat(JsonFormat);
+    else if (strcmp(argv[i], "--diagnostics-format=sarif") == 0)
+      ReportError::SetFormat(SarifFormat);
+    else if (strncmp(argv[i], "--check-cache=", 14) == 0)
+      CheckCache::SetFile(argv[i] + 14);
+    else
+      break;
+  }
+
+  if (i == argc)
     return;
   
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
+  if (strcmp(argv[i], "-d") != 0) { // first arg is not -d
     printf("Incorrect Use:   ");
     for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
     printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
+    printf("Correct Usage:   [--max-errors=N] [--diagnostics-format=text|json|sarif] [--check-cache=<file>] -d <debug-key-1> <debug-key-2> ... \n");
     exit(2);
   }
 
-  for (int i = 2; i < argc; i++)
+  for (i++; i < argc; i++)
     SetDebugForKey(argv[i], true);
 }
-
@@ -76,9 +76,11 @@ bool IsDebugOn(const char *key);
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the debugging flags from the command line.  Leading
+ * --max-errors=N and --diagnostics-format=text|json|sarif options configure
+ * the error reporter, --check-cache=<file> turns on incremental checking
+ * (see checkcache.h). After those it verifies that the next argument is -d,
+ * and then interpret all the arguments that follow as being flags to turn on.
  */
 
 void ParseCommandLine(int argc, char *argv[]);
@@ -29,8 +29,35 @@ map<string, int> Node::tempRegister = { {"main", 1} };
 
 string Node::current_context = "";
 int Node::stackRegister = 0;
-int Node::labelCounter = 0;
-vector<TACObject> Node::TACContainer = {};
+vector<TACFunction> Node::TACProgram = { TACFunction(-1) };
+int Node::currentFunction = 0;
+
+void Node::Gen(tacop op, Operand dst, Operand a, Operand b) {
+    CurrentFunction().code.emplace_back(op, dst, a, b);
+}
+
+Operand Node::NewTemp() {
+    int n = tempRegister[current_context]++;
+    stackRegister++;
+    return Operand::Reg(CurrentFunction().NewTemp(n));
+}
+
+Operand Node::NewTemp(TACFunction &fn) {
+    string context = fn.name >= 0 ? SymbolName(fn.name) : "";
+    return Operand::Reg(fn.NewTemp(tempRegister[context]++));
+}
+
+Operand Node::NewLabel() {
+    return Operand::Label(NewLabelNumber());
+}
+
+Operand Node::Variable(const char *name) {
+    return Operand::Reg(CurrentFunction().Variable(Intern(name)));
+}
+
+Operand Node::LocalVariable(const char *name) {
+    return Operand::Reg(CurrentFunction().LocalVariable(Intern(name)));
+}
 
 /* The Print method is used to print the parse tree nodes.
  * If this node has a location (most nodes do, but some do not), it
@@ -52,14 +79,18 @@ void Node::Print(int indentLevel, const char *label) {
    PrintChildren(indentLevel);
 } 
 	 
-string Node::Emit() {
+Operand Node::Emit() {
     cout << "In Node class's Emit()" << endl;
-    return NULL;
+    return Operand();
 }     
 Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
     name = strdup(n);
 } 
 
+Identifier::~Identifier() {
+    free(name);
+}
+
 void Identifier::PrintChildren(int indentLevel) {
     printf("%s", name);
 }
@@ -40,32 +40,11 @@
 #include <set>
 #include <map>
 #include "colormod.h"
+#include "tac.h"
 
 using namespace std;
 class SymbolTable;
 
-enum tactype { label, instr, stmt, call, print, branch, jump };
-enum sccode { sc_None,
-    sc_PrintInt, sc_ReadInt,
-    sc_MemAlloc  // for BeginFunc ? not sure
-};
-
-struct TACObject{
-    string lhs;    // lhs of the TAC
-    string rhs;    // rhs of the TAC
-    int bytes;     // # of bytes for this TAC
-    tactype type;
-    sccode sc_code;
-
-    TACObject(string lhs, string rhs, int b, tactype type, sccode sc_code = sc_None ) :
-    lhs(lhs),
-    rhs(rhs),
-    bytes(b),
-    type(type),
-    sc_code(sc_code) {
-    }
-};
-
 class Node  {
   protected:
     yyltype *location;
@@ -74,17 +53,28 @@ class Node  {
 
     // Declare any global variables you need here
     // And initialize them in ast.cc
-    static int labelCounter;
-    static vector<TACObject> TACContainer;
+    static vector<TACFunction> TACProgram;     // [0] holds top-level code, [1] the function being lowered
+    static int currentFunction;                // index into TACProgram
+
+    // Helpers for the Emit() methods, they append to the current function
+    static TACFunction &CurrentFunction() { return TACProgram[currentFunction]; }
+    static void Gen(tacop op, Operand dst = Operand(), Operand a = Operand(), Operand b = Operand());
+    static Operand NewTemp();
+    static Operand NewLabel();
+    static Operand Variable(const char *name);
+    static Operand LocalVariable(const char *name);
 
   public:
     static map<string, int> tempRegister;
     static string current_context;
     static int stackRegister;
 
+    // A fresh temp of the given function, for the passes that add code
+    static Operand NewTemp(TACFunction &fn);
+
     Node(yyltype loc);
     Node();
-    virtual ~Node() {}
+    virtual ~Node() { delete location; }
     
     yyltype *GetLocation()   { return location; }
     void SetParent(Node *p)  { parent = p; }
@@ -96,7 +86,7 @@ class Node  {
     // subclasses should override PrintChildren() instead
     void Print(int indentLevel, const char *label = NULL); 
     virtual void PrintChildren(int indentLevel)  {}
-    virtual string Emit();
+    virtual Operand Emit();
 };
    
 
@@ -107,11 +97,12 @@ class Identifier : public Node
     
   public:
     Identifier(yyltype loc, const char *name);
+    ~Identifier();
     const char *GetPrintNameForNode()   { return "Identifier"; }
     void PrintChildren(int indentLevel);
     char *GetName() const { return name; }
 
-    // virtual string Emit();
+    // virtual Operand Emit();
 };
 
 
@@ -12,29 +12,41 @@ Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
     (id=n)->SetParent(this);
 }
 
+// The types are shared, the nodes below them are deleted with them
+Decl::~Decl() {
+    delete id;
+}
+
 
-VarDecl::VarDecl(Identifier *n, Type *t, Expr *e) : Decl(n) {
+VarDecl::VarDecl(Identifier *n, Type *t, Expr *e) : Decl(n), assignTo(NULL) {
     Assert(n != NULL && t != NULL);
     (type=t)->SetParent(this);
     if (e) (assignTo=e)->SetParent(this);
 }
 
+VarDecl::~VarDecl() {
+    delete assignTo;
+}
+
 void VarDecl::PrintChildren(int indentLevel) {
    if (type) type->Print(indentLevel+1);
    if (id) id->Print(indentLevel+1);
    if (assignTo) assignTo->Print(indentLevel+1, "(initializer) ");
 }
 
-string VarDecl::Emit() {
-    string varName = GetIdentifier()->GetName();
+Operand VarDecl::Emit() {
     stackRegister++; // add total register during declaration? (what if variable use same name?)
 
+    // outside of a function the variable is a global
+    const char *name = GetIdentifier()->GetName();
+    Operand var = currentFunction ? LocalVariable(name) : Variable(name);
+
     if (assignTo) {
-        string rhsRegName = assignTo->Emit();
-        TACContainer.emplace_back (varName, rhsRegName, 4, stmt);
-    }     
+        Operand rhs = assignTo->Emit();
+        Gen(op_Copy, var, rhs);
+    }
 
-    return "VarDecl::Emit()";
+    return Operand();
 }
 
 FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
@@ -44,27 +56,40 @@ FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
     body = NULL;
 }
 
+FnDecl::~FnDecl() {
+    if (formals) {
+        formals->DeleteAll();
+        delete formals;
+    }
+    delete body;
+}
+
 void FnDecl::SetFunctionBody(Stmt *b) {
     (body=b)->SetParent(this);
 }
 
-string FnDecl::Emit() {
+Operand FnDecl::Emit() {
     stackRegister = 0;  // beginning of function stack
     current_context = id->GetName();
     tempRegister[current_context] = 1;
 
-    TACContainer.emplace_back(id->GetName(), "", 0, label);
+    TACProgram.emplace_back(Intern(id->GetName()));
+    currentFunction = TACProgram.size() - 1;
+
     for(int i = 0; i < formals->NumElements(); ++i)
-        TACContainer.emplace_back("LoadParam", formals->Nth(i)->GetIdentifier()->GetName(), 0, instr);
+        Gen(op_LoadParam, LocalVariable(formals->Nth(i)->GetIdentifier()->GetName()), Operand::Imm(i));
     //stackRegister += formals->NumElements();
 
-    TACContainer.emplace_back("BeginFunc", "?", 0, instr, sc_MemAlloc);
-    size_t begin_pos = TACContainer.size() - 1;
+    Gen(op_BeginFunc);
+    size_t begin_pos = CurrentFunction().code.size() - 1;
     body->Emit();
-    TACContainer.emplace_back("EndFunc", "", 0, instr);
-    TACContainer[begin_pos].bytes = stackRegister*4;
-    TACContainer[begin_pos].rhs = to_string(stackRegister*4);
-    return "FnDecl::Emit()";
+    Gen(op_EndFunc);
+    CurrentFunction().code[begin_pos].a = Operand::Imm(stackRegister*4);
+
+    // whatever follows at global scope is top-level code again
+    currentFunction = 0;
+    current_context = "";
+    return Operand();
 }
 
 void FnDecl::PrintChildren(int indentLevel) {
@@ -30,6 +30,8 @@ class Decl : public Node
   public:
     Decl() : id(NULL) {}
     Decl(Identifier *name);
+    ~Decl();
+    Identifier *GetIdentifier() const { return id; }
 };
 
 class VarDecl : public Decl
@@ -41,10 +43,10 @@ class VarDecl : public Decl
   public:
     VarDecl() : type(NULL), assignTo(NULL) {}
     VarDecl(Identifier *name, Type *type, Expr *assignTo = NULL);
-    Identifier *GetIdentifier() const { return id; }
+    ~VarDecl();
     const char *GetPrintNameForNode() { return "VarDecl"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class VarDeclError : public VarDecl
@@ -64,10 +66,11 @@ class FnDecl : public Decl
   public:
     FnDecl() : Decl(), formals(NULL), returnType(NULL), body(NULL) {}
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
+    ~FnDecl();
     void SetFunctionBody(Stmt *b);
     const char *GetPrintNameForNode() { return "FnDecl"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class FormalsError : public FnDecl
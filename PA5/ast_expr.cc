@@ -55,8 +55,15 @@ CompoundExpr::CompoundExpr(Expr *l, Operator *o)
         Assert(l != NULL && o != NULL);
         (left=l)->SetParent(this);
         (op=o)->SetParent(this);
+        right = NULL;
     }
 
+CompoundExpr::~CompoundExpr() {
+    delete op;
+    delete left;
+    delete right;
+}
+
 void CompoundExpr::PrintChildren(int indentLevel) {
     if (left) left->Print(indentLevel+1);
     op->Print(indentLevel+1);
@@ -71,6 +78,12 @@ SelectionExpr::SelectionExpr(Expr *c, Expr *t, Expr *f)
         (falseExpr=f)->SetParent(this);
     }
 
+SelectionExpr::~SelectionExpr() {
+    delete cond;
+    delete trueExpr;
+    delete falseExpr;
+}
+
 void SelectionExpr::PrintChildren(int indentLevel) {
     cond->Print(indentLevel+1);
     trueExpr->Print(indentLevel+1, "(true) ");
@@ -85,6 +98,15 @@ Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
     (actuals=a)->SetParentAll(this);
 }
 
+Call::~Call() {
+    delete base;
+    delete field;
+    if (actuals) {
+        actuals->DeleteAll();
+        delete actuals;
+    }
+}
+
 void Call::PrintChildren(int indentLevel) {
     if (base) base->Print(indentLevel+1);
     if (field) field->Print(indentLevel+1);
@@ -99,142 +121,229 @@ VarExpr::VarExpr(yyltype loc, Identifier *ident) : Expr(loc) {
     id = ident;
 }
 
-string IntConstant::Emit() {
-    return to_string(value);
+VarExpr::~VarExpr() {
+    delete id;
 }
 
-string BoolConstant::Emit() {
-    return value ? "true" : "false";
+Operand IntConstant::Emit() {
+    return Operand::Imm(value);
 }
 
-string Operator::Emit() {
-    return string(tokenString);
+Operand BoolConstant::Emit() {
+    return Operand::Bool(value);
 }
 
-string Call::Emit() {
-    bool print_func = false;
-    bool stdin_func = false;
-
-    map<string,sccode> sc_str_code {
-            {"readIntFromSTDIN", sc_ReadInt},
-            {"printInt", sc_PrintInt}
-    };
+/**
+ * Maps the token of a binary operator (or of a compound assignment, whose
+ * first character is the operator) to its TAC opcode.
+ */
+static tacop BinaryOpcode(const string &tok) {
+    static const map<string, tacop> opcodes {
+            {"+", op_Add}, {"-", op_Sub}, {"*", op_Mul}, {"/", op_Div},
+            {"<", op_Less}, {"<=", op_LessEqual}, {">", op_Greater}, {">=", op_GreaterEqual},
+            {"==", op_Equal}, {"!=", op_NotEqual}, {"&&", op_And}, {"||", op_Or} };
+
+    auto it = opcodes.find(tok);
+    Assert(it != opcodes.end());
+    return it->second;
+}
 
-    sccode code     = sc_None;               // certain function call may trigger system call
+Operand Call::Emit() {
     string field_name(field->GetName());    //  cleaner code
 
-    if (strstr(field_name.c_str(), "read")) {
-        stdin_func = true;
-        code       = sc_str_code[field_name];
-    }
-
-    if (strstr(field_name.c_str(), "print")) {
-        print_func = true;
-        code       = sc_str_code[field_name];
-    }
+    bool print_func = strstr(field_name.c_str(), "print") != NULL;
+    bool stdin_func = strstr(field_name.c_str(), "read") != NULL;
 
+    vector<Operand> args;
     for (int i = 0; i < actuals->NumElements(); ++i) {
-        string argName = actuals->Nth(i)->Emit();
+        args.push_back(actuals->Nth(i)->Emit());
         if (!print_func && !stdin_func) {
             if (i == 0)
-                TACContainer.emplace_back("SaveRegisters", "", 0, instr, code);
-            TACContainer.emplace_back("PushParam", argName, 0, instr, code);
+                Gen(op_SaveRegisters);
+            Gen(op_PushParam, Operand(), args.back());
         }
     }
 
-    string registerStr = "";
+    Operand result;
 
     if (print_func) {
-        TACContainer.emplace_back("Print", actuals->Nth(0)->Emit(), 0, print, code);
+        Gen(op_Print, Operand(), args[0]);
+    } else if (stdin_func) {
+        result = NewTemp();
+        Gen(op_ReadInt, result);
     } else {
-        registerStr = "t" + to_string(tempRegister[current_context]);
-        tempRegister[current_context]++; stackRegister++;
-        string rhs = string(field->GetName()) + " " + to_string(actuals->NumElements());
-        TACContainer.emplace_back(registerStr, rhs, 0, call, code);
+        result = NewTemp();
+        Gen(op_Call, result, Operand::Sym(Intern(field_name)), Operand::Imm(actuals->NumElements()));
     }
 
     if (!print_func && !stdin_func) {
-        TACContainer.emplace_back("PopParam", to_string(actuals->NumElements() * 4), 0, instr);
-        TACContainer.emplace_back("RestoreRegisters", "", 0, instr, code);
+        Gen(op_PopParam, Operand(), Operand::Imm(actuals->NumElements() * 4));
+        Gen(op_RestoreRegisters);
     }
 
-    return registerStr;
+    return result;
 }
 
-string VarExpr::Emit() {
-    string localVarName = id->GetName();
-    return string(localVarName);
+Operand VarExpr::Emit() {
+    return Variable(id->GetName());
 }
 
-string EmptyExpr::Emit() {
-    return "EmptyExpr Emit";
+Operand EmptyExpr::Emit() {
+    return Operand();
 }
 
-string ArithmeticExpr::Emit() {
-    string leftStr;
+Operand ArithmeticExpr::Emit() {
+    string opString = op->GetTokenString();
+
+    // prefix ++x / --x update the variable and yield its new value
+    if (left == nullptr && (opString == "++" || opString == "--")) {
+        Operand var = right->Emit();
+        Gen(opString == "++" ? op_Add : op_Sub, var, var, Operand::Imm(1));
+        return var;
+    }
+
+    Operand leftOpnd;
     if (left != nullptr)
-        leftStr = left->Emit();
-    string rightStr = right->Emit();
-    string opString = op->Emit();
+        leftOpnd = left->Emit();
+    Operand rightOpnd = right->Emit();
 
-    string registerStr = "t" + to_string(tempRegister[current_context]);
-    tempRegister[current_context]++; stackRegister++;
-    string assignTo = leftStr + string(" ") + opString + string(" ") + rightStr;
-    TACContainer.emplace_back (registerStr, assignTo, 4, stmt);
+    // unary plus is a no-op
+    if (left == nullptr && opString == "+")
+        return rightOpnd;
 
-    return registerStr;
-}
+    Operand result = NewTemp();
+    if (left == nullptr)
+        Gen(op_Neg, result, rightOpnd);
+    else
+        Gen(BinaryOpcode(opString), result, leftOpnd, rightOpnd);
 
-string RelationalExpr::Emit() {
-    string leftStr = left->Emit();
-    string rightStr = right->Emit();
-    string opString = op->Emit();
+    return result;
+}
 
-    string registerStr = "t" + to_string(tempRegister[current_context]);
-    tempRegister[current_context]++; stackRegister++;
-    string assignTo = leftStr + string(" ") + opString + string(" ") + rightStr;
+Operand RelationalExpr::Emit() {
+    Operand leftOpnd = left->Emit();
+    Operand rightOpnd = right->Emit();
 
-    TACContainer.emplace_back(registerStr, assignTo, 4, stmt);
+    Operand result = NewTemp();
+    Gen(BinaryOpcode(op->GetTokenString()), result, leftOpnd, rightOpnd);
 
-    return registerStr;
+    return result;
 }
 
-string AssignExpr::Emit() {
-    string lhs = left->Emit();
-    string rhs = right->Emit();
-    string opString = op->Emit();
+Operand AssignExpr::Emit() {
+    Operand lhs = left->Emit();
+    Operand rhs = right->Emit();
+    string opString = op->GetTokenString();
 
     if (opString.compare("=") != 0)
-        rhs = (lhs + " " + opString[0] + " " + rhs);
+        Gen(BinaryOpcode(opString.substr(0, 1)), lhs, lhs, rhs);
+    else
+        Gen(op_Copy, lhs, rhs);
+
+    return lhs;
+}
 
-    TACContainer.emplace_back(lhs, rhs, 0, stmt);
+void Expr::EmitBranch(Operand trueLabel, Operand falseLabel) {
+    Gen(op_IfGoto, trueLabel, Emit());
+    Gen(op_Goto, falseLabel);
+}
+
+/**
+ * Returns true if the code from the given index on only computes temps:
+ * running it when its value isn't needed changes nothing. A division
+ * could be by zero, so it doesn't count.
+ */
+static bool onlyComputesTemps(const TACFunction &fn, int start) {
+    for (int i = start; i < fn.code.size(); i++) {
+        const TACObject &taco = fn.code[i];
+        bool pure = taco.op == op_Copy || taco.op == op_Neg || (IsBinary(taco.op) && taco.op != op_Div);
+        if (!pure || fn.regs[taco.dst.value].name >= 0)
+            return false;
+    }
+    return true;
+}
 
-    return "AssignExpr::Emit()";
+/**
+ * The value of a side of && or || as 0 or 1. A comparison, a logical
+ * expression and a constant already are; a variable or a call may hold any
+ * nonzero value for true, which and and or would get wrong, so it is
+ * compared with 0.
+ */
+Operand LogicalExpr::AsBoolean(Expr *side, Operand value) {
+    if (value.IsImm())
+        return value.kind == opnd_Bool ? value : Operand::Imm(value.value != 0);
+    if (dynamic_cast<RelationalExpr*>(side) || dynamic_cast<EqualityExpr*>(side) ||
+        dynamic_cast<LogicalExpr*>(side))
+        return value;
+    Operand result = NewTemp();
+    Gen(op_NotEqual, result, value, Operand::Imm(0));
+    return result;
 }
 
-string LogicalExpr::Emit() {
-    return "LogicalExpr::Emit()";
+/**
+ * In a value, a && b and a || b are computed without branches when b has
+ * no effect, both sides made 0 or 1 first. Otherwise b is only evaluated
+ * when a doesn't decide the result, and the result is a variable assigned
+ * on both ways.
+ */
+Operand LogicalExpr::Emit() {
+    bool isAnd = strcmp(op->GetTokenString(), "&&") == 0;
+    Operand leftOpnd = AsBoolean(left, left->Emit());
+    int start = CurrentFunction().code.size();
+    Operand rightOpnd = AsBoolean(right, right->Emit());
+
+    if (onlyComputesTemps(CurrentFunction(), start)) {
+        Operand result = NewTemp();
+        Gen(isAnd ? op_And : op_Or, result, leftOpnd, rightOpnd);
+        return result;
+    }
+
+    vector<TACObject> &code = CurrentFunction().code;
+    vector<TACObject> rightCode(code.begin() + start, code.end());
+    code.erase(code.begin() + start, code.end());
+
+    Operand result = Operand::Reg(CurrentFunction().NewVariable(Intern("cond")));
+    Operand endLabel = NewLabel();
+    Gen(op_Copy, result, leftOpnd);
+    if (isAnd) {
+        Operand rightLabel = NewLabel();
+        Gen(op_IfGoto, rightLabel, leftOpnd);
+        Gen(op_Goto, endLabel);
+        Gen(op_Label, rightLabel);
+    } else {
+        Gen(op_IfGoto, endLabel, leftOpnd);
+    }
+    code.insert(code.end(), rightCode.begin(), rightCode.end());
+    Gen(op_Copy, result, rightOpnd);
+    Gen(op_Label, endLabel);
+    return result;
 }
 
-string EqualityExpr::Emit() {
-    string leftStr = left->Emit();
-    string rightStr = right->Emit();
-    string opString = op->Emit();
+// As a condition, the right side is only tested when the left one doesn't decide
+void LogicalExpr::EmitBranch(Operand trueLabel, Operand falseLabel) {
+    Operand rightLabel = NewLabel();
+    if (strcmp(op->GetTokenString(), "&&") == 0)
+        left->EmitBranch(rightLabel, falseLabel);
+    else
+        left->EmitBranch(trueLabel, rightLabel);
+    Gen(op_Label, rightLabel);
+    right->EmitBranch(trueLabel, falseLabel);
+}
 
-    string registerStr = "t" + to_string(tempRegister[current_context]);
-    tempRegister[current_context]++; stackRegister++;
-    string assignTo = leftStr + string(" ") + opString + string(" ") + rightStr;
+Operand EqualityExpr::Emit() {
+    Operand leftOpnd = left->Emit();
+    Operand rightOpnd = right->Emit();
 
-    TACContainer.emplace_back(registerStr, assignTo, 4, stmt);
+    Operand result = NewTemp();
+    Gen(BinaryOpcode(op->GetTokenString()), result, leftOpnd, rightOpnd);
 
-    return registerStr;
+    return result;
 }
 
-string PostfixExpr::Emit() {
-    string leftStr = left->Emit();
-    string opString = op->Emit();
-    string assignTo = leftStr + " " + opString[0] + " 1";
-    TACContainer.emplace_back(leftStr, assignTo, 0, stmt);
+Operand PostfixExpr::Emit() {
+    Operand var = left->Emit();
+    string opString = op->GetTokenString();
+    Gen(opString == "++" ? op_Add : op_Sub, var, var, Operand::Imm(1));
 
-    return "PostfixExpr::Emit()";
+    return var;
 }
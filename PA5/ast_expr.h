@@ -26,6 +26,9 @@ class Expr : public Stmt
   public:
     Expr(yyltype loc) : Stmt(loc) {}
     Expr() : Stmt() {}
+
+    // Jumps to trueLabel if the expression holds, to falseLabel otherwise
+    virtual void EmitBranch(Operand trueLabel, Operand falseLabel);
 };
 
 class ExprError : public Expr
@@ -42,7 +45,7 @@ class EmptyExpr : public Expr
 {
   public:
     const char *GetPrintNameForNode() { return "Empty"; }
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class IntConstant : public Expr
@@ -55,7 +58,7 @@ class IntConstant : public Expr
     const char *GetPrintNameForNode() { return "IntConstant"; }
     void PrintChildren(int indentLevel);
     int GetValue() { return value; }
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class BoolConstant : public Expr
@@ -68,7 +71,7 @@ class BoolConstant : public Expr
     const char *GetPrintNameForNode() { return "BoolConstant"; }
     void PrintChildren(int indentLevel);
     bool GetValue() { return value; }
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class Operator : public Node
@@ -80,7 +83,7 @@ class Operator : public Node
     Operator(yyltype loc, const char *tok);
     const char *GetPrintNameForNode() { return "Operator"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    const char *GetTokenString() { return tokenString; }
  };
 
 class CompoundExpr : public Expr
@@ -93,6 +96,7 @@ class CompoundExpr : public Expr
     CompoundExpr(Expr *lhs, Operator *op, Expr *rhs); // for binary
     CompoundExpr(Operator *op, Expr *rhs);             // for unary
     CompoundExpr(Expr *lhs, Operator *op);             // for unary
+    ~CompoundExpr();
     void PrintChildren(int indentLevel);
 };
 
@@ -102,7 +106,7 @@ class ArithmeticExpr : public CompoundExpr
     ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "ArithmeticExpr"; }
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class RelationalExpr : public CompoundExpr
@@ -110,7 +114,7 @@ class RelationalExpr : public CompoundExpr
   public:
     RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "RelationalExpr"; }
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class EqualityExpr : public CompoundExpr
@@ -118,16 +122,20 @@ class EqualityExpr : public CompoundExpr
   public:
     EqualityExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "EqualityExpr"; }
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class LogicalExpr : public CompoundExpr
 {
+  protected:
+    static Operand AsBoolean(Expr *side, Operand value);
+
   public:
     LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "LogicalExpr"; }
-    virtual string Emit();
+    virtual Operand Emit();
+    virtual void EmitBranch(Operand trueLabel, Operand falseLabel);
 };
 
 class SelectionExpr : public Expr
@@ -136,6 +144,7 @@ class SelectionExpr : public Expr
     Expr *cond, *trueExpr, *falseExpr;
   public:
     SelectionExpr(Expr *c, Expr *t, Expr *f);
+    ~SelectionExpr();
     void PrintChildren(int indentLevel);
     const char *GetPrintNameForNode() { return "SelectionExpr"; }
 };
@@ -145,7 +154,7 @@ class AssignExpr : public CompoundExpr
   public:
     AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "AssignExpr"; }
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class PostfixExpr : public CompoundExpr
@@ -153,7 +162,7 @@ class PostfixExpr : public CompoundExpr
   public:
     PostfixExpr(Expr *lhs, Operator *op) : CompoundExpr(lhs,op) {}
     const char *GetPrintNameForNode() { return "PostfixExpr"; }
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 /* Like field access, call is used both for qualified base.field()
@@ -170,9 +179,10 @@ class Call : public Expr
   public:
     Call() : Expr(), base(NULL), field(NULL), actuals(NULL) {}
     Call(yyltype loc, Expr *base, Identifier *field, List<Expr*> *args);
+    ~Call();
     const char *GetPrintNameForNode() { return "Call"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class VarExpr : public Expr
@@ -181,10 +191,11 @@ class VarExpr : public Expr
     Identifier *id;
   public:
     VarExpr(yyltype loc, Identifier *ident);
+    ~VarExpr();
     const char *GetPrintNameForNode() { return "VarExpr"; }
     void PrintChildren(int identLevel);
     string GetName() {return id->GetName();}
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 #endif
@@ -6,30 +6,37 @@
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "ast_expr.h"
+#include "cfg.h"
+#include "ssa.h"
+#include "dataflow.h"
+#include "loops.h"
+#include "inline.h"
+#include "passes.h"
+#include "simplify.h"
+#include "layout.h"
+#include "regalloc.h"
+#include "mips.h"
+#include "errors.h"
+#include <algorithm>
 #include <cctype>
-#include <unordered_map>
+#include <chrono>
+#include <climits>
+#include <cstring>
 #include <utility>
 #include <sstream>
 #include <iterator>
 #include <iomanip>
 
-typedef pair<string, string> Trump;
-
-Program::Program(List<Decl*> *d) {
-    Assert(d != NULL);
-    (decls=d)->SetParentAll(this);
-}
-
-void Program::PrintChildren(int indentLevel) {
-    decls->PrintAll(indentLevel+1);
-    printf("\n");
-}
-
 StmtBlock::StmtBlock(List<Stmt*> *s) {
     Assert(s != NULL);
     (stmts=s)->SetParentAll(this);
 }
 
+StmtBlock::~StmtBlock() {
+    stmts->DeleteAll();
+    delete stmts;
+}
+
 void StmtBlock::PrintChildren(int indentLevel) {
     stmts->PrintAll(indentLevel+1);
 }
@@ -40,12 +47,22 @@ ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) {
     (body=b)->SetParent(this);
 }
 
+ConditionalStmt::~ConditionalStmt() {
+    delete test;
+    delete body;
+}
+
 ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(t, b) {
     Assert(i != NULL && t != NULL && s != NULL && b != NULL);
     (init=i)->SetParent(this);
     (step=s)->SetParent(this);
 }
 
+ForStmt::~ForStmt() {
+    delete init;
+    delete step;
+}
+
 void ForStmt::PrintChildren(int indentLevel) {
     init->Print(indentLevel+1, "(init) ");
     test->Print(indentLevel+1, "(test) ");
@@ -64,6 +81,10 @@ IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) {
     if (elseBody) elseBody->SetParent(this);
 }
 
+IfStmt::~IfStmt() {
+    delete elseBody;
+}
+
 void IfStmt::PrintChildren(int indentLevel) {
     if (test) test->Print(indentLevel+1, "(test) ");
     if (body) body->Print(indentLevel+1, "(then) ");
@@ -75,6 +96,10 @@ ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) {
     (expr=e)->SetParent(this);
 }
 
+ReturnStmt::~ReturnStmt() {
+    delete expr;
+}
+
 void ReturnStmt::PrintChildren(int indentLevel) {
     expr->Print(indentLevel+1);
 }
@@ -84,202 +109,47 @@ DeclStmt::DeclStmt(yyltype loc, Decl *decl) : Stmt(loc) {
     (varDecl=decl)->SetParent(this);
 }
 
-void DeclStmt::PrintChildren(int indentLevel) {
-    varDecl->Print(indentLevel+1);
-}
-
-void split(const string& s, const string& delim, vector<string>& v, bool clear = true) {
-    int start = 0;
-    int end = s.find(delim, start);
-
-    if (clear)
-        v.clear();
-
-    while (end != string::npos) {
-        v.push_back(s.substr(start, end - start));
-        start = end + delim.length();
-        end = s.find(delim, start);
-    }
-
-   v.push_back(s.substr(start, s.length()));
-}
-
-bool isNumeric(const string& s) {
-    return s.find_first_not_of("0123456789") == string::npos;
+DeclStmt::~DeclStmt() {
+    delete varDecl;
 }
 
-bool isOperator(const string& s) {
-    return s.find_first_not_of("+-/*%^=") == string::npos;
-}
-
-/**
- * evaluate arithmetic expressions in code
- * @param TACContainer
- * @return
- */
-void constantFolding(vector<TACObject>& TACContainer) {
-    vector<string> split_result;
-
-    for (int i = 0; i < TACContainer.size(); ++i) {
-        if (TACContainer[i].type != stmt)
-            continue;
-
-        split(TACContainer[i].rhs, " ", split_result);
-        
-        if (split_result.size() != 3)
-            continue;
-
-        bool qualified = isNumeric(split_result[0]) && isNumeric(split_result[2]);
-
-
-        if (qualified) {
-
-            int a = split_result[0] == "" ? 0 : stoi(split_result[0]);
-            int b = stoi(split_result[2]);
-
-            string op = split_result[1];
-            if (op.compare("+") == 0)
-                TACContainer[i].rhs = to_string(a + b);
-            else if (op.compare("-") == 0)
-                TACContainer[i].rhs = to_string(a - b);
-            else if (op.compare("/") == 0)
-                TACContainer[i].rhs = to_string(a / b);
-            else if (op.compare("*") == 0) {
-                TACContainer[i].rhs = to_string(a * b);
-            }
-        }
-    }
-}
-
-/**
- * remove unused initalized variables from code
- * @param TACContainer
- * @return
- */
-void deadCodeElimination(vector<TACObject>& TACContainer) {
-    vector<pair<int,string>> variables;
-    vector<string> used_tokens;
-
-    // collect all tokens both rhs and lhs
-    for (int j = 0; j < TACContainer.size(); ++j) {
-        TACObject &taco = TACContainer[j];
-        if (taco.type == stmt) {
-            split(taco.rhs, " ", used_tokens, false); // false here means update the used_tokens, instead of reseting it
-            variables.emplace_back(j, taco.lhs);
-        } else if (taco.type == branch)
-            split(taco.lhs, " ", used_tokens, false); // for branch, lhs may contain variables used in the code
-        else if (taco.type == instr && taco.lhs == "Return")
-            split(taco.rhs, " ", used_tokens, false); // for return, rhs may contains variable
-    }
-
-    // Cleans up token that is not a variable (integer and operators)
-    for (int i = 0; i < used_tokens.size(); ++i)
-        if (isNumeric(used_tokens[i]) || isOperator(used_tokens[i]))
-            used_tokens.erase(used_tokens.begin() + i-- );
-
-    set<string> rhs_unique(used_tokens.begin(), used_tokens.end());
-
-
-    // remove varible that does not appear in rhs_token (add index to remove first)
-    vector<int> index_to_delete;
-    for (auto var : variables)
-        if (rhs_unique.find(var.second) == rhs_unique.end())
-            index_to_delete.insert(index_to_delete.begin(), var.first);
-    for (auto item : index_to_delete)
-        TACContainer.erase(TACContainer.begin() + item);
+void DeclStmt::PrintChildren(int indentLevel) {
+    varDecl->Print(indentLevel+1);
 }
 
-
-/**
- * turn X = 5; X = X + 3  -->  X = 5 + 3
- * @param TACContainer
- * @return
- */
-void constantPropagation(vector<TACObject>& TACContainer) {
-
-    unordered_map<string, string> value_map;
-    // collect all tokens both rhs and lhs
-    vector<string> rhs_tokens;
-    for (auto &taco : TACContainer) {
-        if (taco.type == stmt) {
-            if (isNumeric(taco.rhs)) {
-                if (value_map.find(taco.lhs) != value_map.end())    // re-assignment, stop
-                    break;
-                value_map[taco.lhs] = taco.rhs;                     // save initialized values
-            }
-            else { // do replacement
-                split(taco.rhs, " ", rhs_tokens);
-                bool changed = false;
-                for (auto &token : rhs_tokens) {
-                    if (value_map.find(token) != value_map.end() ) {
-                        token = value_map[token];
-                        changed = true;
-                    }
-                }
-                if (changed) {
-                    stringstream imploded;
-                    copy(rhs_tokens.begin(), rhs_tokens.end(), ostream_iterator<string>(imploded, " "));
-                    taco.rhs = imploded.str();
-                    taco.rhs.pop_back();  // remove last space from the join operation
-                }
-            }
-        }
-    }
-
-//    for (auto pair : value_map)
-//        cout << pair.first << "," << pair.second << endl;
-
+// Virtual registers that hold compiler temps rather than variables
+static bool isTemp(const TACFunction &fn, const Operand &o) {
+    return o.IsReg() && fn.regs[o.value].name < 0;
 }
 
 /**
- * Function assigns a temporary register to each variable found within the TAC
- * container.
+ * The passes leave gaps in the temp numbers (and add temps numbered past
+ * the end), so the ones left are numbered again in order of first use,
+ * from t1.
  *
- * @param
- * @return 
+ * @param fn : the function to renumber
  */
-void linearScan(map<string, Trump>& regMap, vector<TACObject>& container) {
-    vector<string> rhs_tokens;
-    string curr_context;
-    unordered_map<string, int> registerCount;
-
-    for (auto &taco : container) {
-        if (taco.type == label && taco.lhs[0] != 'L') {
-            curr_context = taco.lhs;
-            continue;
-        }
-
-        if (taco.type != stmt)
-            continue; 
-
-        split(taco.rhs, " ", rhs_tokens);
-
-        if (rhs_tokens.size() != 1) {
-            if (regMap.find(taco.lhs) != regMap.end())
-                continue;
-
-            if (taco.lhs[0] == 't') {
-                regMap[taco.lhs] = make_pair(taco.lhs, curr_context);
+static void renumberTemps(TACFunction &fn) {
+    vector<bool> numbered(fn.regs.size(), false);
+    int next = 1;
+    for (const TACObject &taco : fn.code) {
+        for (const Operand *o : { &taco.dst, &taco.a, &taco.b }) {
+            if (!isTemp(fn, *o) || numbered[o->value])
                 continue;
-            }
-
-            auto reg = "t" + to_string(Node::tempRegister[curr_context]);
-            Node::tempRegister[curr_context]++; Node::stackRegister++;
-            regMap[taco.lhs] = make_pair(reg, curr_context);
-        } else {
-            if (taco.rhs[0] == 't') {
-                regMap[taco.lhs] = make_pair(taco.rhs, curr_context);
-            } else {
-                auto reg = "t" + to_string(Node::tempRegister[curr_context]);
-                Node::tempRegister[curr_context]++; Node::stackRegister++;
-                regMap[taco.lhs] = make_pair(reg, curr_context);
-            }
+            numbered[o->value] = true;
+            fn.regs[o->value].temp = next++;
         }
     }
 }
 
+// A source operand of a MIPS instruction: a register name or an immediate
+struct MIPSOperand {
+    bool isImm;
+    int imm;
+    string reg;
+};
 
-string binaryExprToMIPS(string c, string a, string b, string op) {
+string binaryExprToMIPS(string c, MIPSOperand a, MIPSOperand b, tacop op) {
     /*
      * The parameters are ordered based on the binary expression.
      * c := a op b 
@@ -304,372 +174,871 @@ string binaryExprToMIPS(string c, string a, string b, string op) {
      * value
      */
 
-    if (op == ">")
-        return binaryExprToMIPS(c, b, a, "<");
-    if (op == ">=")
-        return binaryExprToMIPS(c, b, a, "<=");
+    // How to translate a := 4 + 3 to MIPS? Unoptimized code isn't folded,
+    // so do it here: li $rd, 7.
+    int folded;
+    if (a.isImm && b.isImm && FoldBinary(op, a.imm, b.imm, folded))
+        return "  li $" + c + ", " + to_string(folded);
+
+    if (op == op_Greater)
+        return binaryExprToMIPS(c, b, a, op_Less);
+    if (op == op_GreaterEqual)
+        return binaryExprToMIPS(c, b, a, op_LessEqual);
 
 
     string mipsCode = "";
     string instr = "";
-    string rs = "$" + a;
-    string rt = "$" + b; 
+    string rs = "$" + a.reg;
+    string rt = "$" + b.reg; 
     string rd = "$" + c;
 
-    const string &context = Node::current_context;
-
     // Assume parameter 'b' not a constant. Use R-Type instruction.
     bool iType = false;
 
     // How to translate 100 < $t0 to MIPS? First use li to store 100 into
-    // register $rs, then use slt $rd, $rs, $rt
-    if (isNumeric(a) && (op == "<" || op == "<=")) {
-        rs  = "$t" + to_string(Node::tempRegister[context]);
-        Node::tempRegister[context]++; Node::stackRegister;
+    // the scratch register $v1, then use slt $rd, $v1, $rt
+    if (a.isImm && (op == op_Less || op == op_LessEqual)) {
+        rs  = "$v1";
 
-        mipsCode += "  li " + rs + ", " + a + "\n";
+        mipsCode += "  li " + rs + ", " + to_string(a.imm) + "\n";
     }
 
     // How to translate a := 4 + a to MIPS? Change positions to a := a + 4, and
     // use addi.
-    if (isNumeric(a) && (op != "<" && op != "<=")) {
+    if (a.isImm && (op != op_Less && op != op_LessEqual)) {
         iType = true;
-        rt = a;
-        rs = "$" + b;
+        rt = to_string(a.imm);
+        rs = "$" + b.reg;
     }
 
     // How to translate $t0 < 140 to MIPS? Use I-type instruction.
-    if (isNumeric(b)) {
+    if (b.isImm) {
         iType = true;
-        rt = b;
+        rt = to_string(b.imm);
     }
 
-    if (op == "<") {
+    if (op == op_Less) {
         instr = "  slt";
         instr += (iType) ? "i" : "";
 
         mipsCode += instr + " " + rd + ", " + rs + ", " + rt;
         return mipsCode;
     } 
-    if (op == "<=") {
+    if (op == op_LessEqual) {
 
-        mipsCode += binaryExprToMIPS(c, a, b, ">") + "\n";
+        mipsCode += binaryExprToMIPS(c, a, b, op_Greater) + "\n";
         mipsCode += "  not "  + rd + ", " + rd + "\n";
         mipsCode += "  andi " + rd + ", " + rd + ", 1";
         return mipsCode;
     }
-    if (op == "+") {
+    if (op == op_Add) {
         instr = "  add";
         instr += (iType) ? "i" : "";
 
         mipsCode += instr + " " + rd + ", " + rs + ", " + rt;
         return mipsCode;
-    } 
-
-    return "ERROR operator (" + op + ") not supported!";
-}
-
-void generateIR(const vector<TACObject>& TACContainer) {
-    for (int i = 0; i < TACContainer.size(); ++i) {
-        switch(TACContainer[i].type) {
-            case label:  cout << TACContainer[i].lhs + ":" << endl;
-                break;
+    }
+    // How to translate a := b && c to MIPS? Booleans are 0 or 1, so it is
+    // and $rd, $rs, $rt (or for ||).
+    if (op == op_And || op == op_Or) {
+        instr = (op == op_And) ? "  and" : "  or";
+        instr += (iType) ? "i" : "";
 
-            case stmt:   cout << "    " + TACContainer[i].lhs << " := " << TACContainer[i].rhs << endl;
-                break;
+        mipsCode += instr + " " + rd + ", " + rs + ", " + rt;
+        return mipsCode;
+    }
+    // How to translate a := b == c to MIPS? The exclusive or is 0 exactly
+    // when they are equal: xor $rd, $rs, $rt, then sltiu $rd, $rd, 1 (for
+    // != sltu $rd, $zero, $rd). xori only takes an unsigned 16 bit constant,
+    // any other one is loaded into $v1.
+    if (op == op_Equal || op == op_NotEqual) {
+        if (iType && (stoll(rt) < 0 || stoll(rt) > 65535)) {
+            mipsCode += "  li $v1, " + rt + "\n";
+            rt = "$v1";
+            iType = false;
+        }
+        instr = "  xor";
+        instr += (iType) ? "i" : "";
 
-            case instr:  cout << "    " + TACContainer[i].lhs << " " + TACContainer[i].rhs << endl;
-                break;
+        mipsCode += instr + " " + rd + ", " + rs + ", " + rt + "\n";
+        if (op == op_Equal)
+            mipsCode += "  sltiu " + rd + ", " + rd + ", 1";
+        else
+            mipsCode += "  sltu " + rd + ", $zero, " + rd;
+        return mipsCode;
+    }
+    // How to translate a := b * 8 to MIPS? A product by a power of two is
+    // a left shift, sll $rd, $rs, 3.
+    if (op == op_Mul && iType) {
+        unsigned factor = a.isImm ? a.imm : b.imm;
+        if (factor != 0 && (factor & (factor - 1)) == 0) {
+            int shift = 0;
+            while (factor >>= 1)
+                shift++;
+            mipsCode += "  sll " + rd + ", " + rs + ", " + to_string(shift);
+            return mipsCode;
+        }
+    }
 
-            case print:
-            case call:   cout << "    " + TACContainer[i].lhs << " call " + TACContainer[i].rhs << endl;
-                break;
+    return "ERROR operator (" + string(OperatorString(op)) + ") not supported!";
+}
 
-            case branch: cout << "    if " + TACContainer[i].lhs << " goto " + TACContainer[i].rhs << endl;
-                break;
+/**
+ * Branches to the label if a op b holds, for a comparison whose value is
+ * only read by the branch: zero is compared with blez, bgtz, bltz or bgez,
+ * equality with beq or bne, and the other comparisons are one slt or slti
+ * into $v1 followed by a beq or bne on it.
+ *
+ * @param a, b  : the operands compared
+ * @param op    : the comparison
+ * @param label : where to go if it holds
+ * @return the MIPS code, empty if the branch is never taken
+ */
+string branchToMIPS(MIPSOperand a, MIPSOperand b, tacop op, const string &label) {
+    if (op == op_Greater)
+        return branchToMIPS(b, a, op_Less, label);
+    if (op == op_GreaterEqual)
+        return branchToMIPS(b, a, op_LessEqual, label);
 
-            case jump:   cout << "    goto " + TACContainer[i].lhs << endl;
-                break;
+    int result;
+    if (a.isImm && b.isImm)
+        return FoldBinary(op, a.imm, b.imm, result) && result ? "  j " + label : "";
 
-            default:     cout << " ERRRORRR !!!! " << endl;
+    string mipsCode = "";
+    if (op == op_Equal || op == op_NotEqual) {
+        if (a.isImm)
+            swap(a, b);
+        string rt = "$zero";
+        if (b.isImm && b.imm != 0) {
+            mipsCode += "  li $v1, " + to_string(b.imm) + "\n";
+            rt = "$v1";
+        } else if (!b.isImm) {
+            rt = "$" + b.reg;
         }
+        string instr = (op == op_Equal) ? "  beq " : "  bne ";
+        return mipsCode + instr + "$" + a.reg + ", " + rt + ", " + label;
     }
+
+    // c < b is c + 1 <= b, and a <= c is a < c + 1, so a constant other
+    // than 0 ends up where slti takes it
+    if (op == op_Less && a.isImm && a.imm != 0) {
+        if (a.imm == INT_MAX)
+            return "";
+        a.imm++;
+        op = op_LessEqual;
+    } else if (op == op_LessEqual && b.isImm && b.imm != 0) {
+        if (b.imm == INT_MAX)
+            return "  j " + label;
+        b.imm++;
+        op = op_Less;
+    }
+
+    if (b.isImm && b.imm == 0)
+        return string(op == op_Less ? "  bltz $" : "  blez $") + a.reg + ", " + label;
+    if (a.isImm && a.imm == 0)
+        return string(op == op_Less ? "  bgtz $" : "  bgez $") + b.reg + ", " + label;
+
+    // a < b is taken when slt sets $v1, a <= b when b < a doesn't
+    MIPSOperand x = (op == op_Less) ? a : b, y = (op == op_Less) ? b : a;
+    string instr = y.isImm ? "  slti" : "  slt";
+    string rt = y.isImm ? to_string(y.imm) : "$" + y.reg;
+    mipsCode += instr + " $v1, $" + x.reg + ", " + rt + "\n";
+    mipsCode += string(op == op_Less ? "  bne" : "  beq") + " $v1, $zero, " + label;
+    return mipsCode;
 }
 
 /**
  * Debug function to print out the detail of TACObject
  *
+ * @param fn   : the function the TACObject belongs to
  * @param taco : the TACObject of interest
+ * @param out  : where to print it
  */
-void printTAC(const TACObject& taco) {
-    map<tactype ,string> tactype_map {
-            {label, "Label"}, {instr, "instr"}, {stmt, "stmt"},
-            {call, "call"}, {print, "print"}, {branch, "branch"}, {jump, "jump"}, };
+void printTAC(const TACFunction& fn, const TACObject& taco, ostream& out = cout) {
+    out << setw(20) << "(" << taco.op << ")"
+        << "\tdst :  " << setw(5) << OperandString(fn, taco.dst) << setw(8)
+        << "\ta :  " << setw(5) << OperandString(fn, taco.a) << setw(8)
+        << "\tb :  " << setw(5) << OperandString(fn, taco.b) << endl;
+}
 
-    cout << setw(20) << "(" <<  tactype_map[taco.type] << ")"
-        << "\tlhs :  " << setw(5) << taco.lhs << setw(8)
-        << "\trhs :  " << setw(5) << taco.rhs << setw(8)
-        << "\tbytes: " << setw(5) << taco.bytes << endl;
+// The words after $gp the global variables live in, handed out as each is first seen
+struct GlobalArea {
+    vector<int> word;                   // symbol -> its word, -1 if it has none yet
+    int words = 0;
+
+    int WordOf(int sym) {
+        if (sym >= word.size())
+            word.resize(sym + 1, -1);
+        if (word[sym] < 0)
+            word[sym] = words++;
+        return word[sym];
+    }
+};
+
+/**
+ * Where the values of the function being generated are kept: a machine
+ * register, or a word of memory for a spilled register (its stack slot), a
+ * spilled parameter (the slot it was passed in) and a global (its word
+ * after $gp). Values in memory are loaded into a scratch register before
+ * they are read and stored from one after they are computed.
+ *
+ * The frame holds, from the bottom up, the $t registers saved around the
+ * call needing the most of them, the stack slots, and the $s registers
+ * and $ra the function saves on entry.
+ */
+struct Storage {
+    const TACFunction &fn;
+    RegisterAllocation alloc;
+    vector<int> param;                  // parameter index of each virtual register, -1 if none
+    int paramCount;
+    int saveArea;                       // bytes at the bottom of the frame $t registers are saved to
+    int frame;                          // bytes of the whole frame
+    vector<string> saved;               // registers saved on entry, at the top of the frame
+    int pushed;                         // bytes of arguments pushed for the call being made
+    GlobalArea &globals;
+
+    Storage(const TACFunction &fn, GlobalArea &globals) : fn(fn), globals(globals) {}
+};
+
+static bool inMemory(const Storage &s, int reg) {
+    return s.alloc.reg[reg] < 0;
 }
 
-bool does_trump_exists(string key, map<string, Trump>& regMap) {
-    for (const auto &v : regMap) {
-        if (v.first == key)
-            return true;
+// The memory operand of a value kept in memory
+static string homeOf(Storage &s, int reg) {
+    if (!s.fn.IsLocal(reg)) {
+        return to_string(4 * s.globals.WordOf(s.fn.regs[reg].name)) + "($gp)";
     }
+    int offset = s.param[reg] >= 0 ? s.frame + 4 * (s.paramCount - 1 - s.param[reg])
+                                   : s.saveArea + 4 * s.alloc.slot[reg];
+    return to_string(offset + s.pushed) + "($sp)";
+}
 
-    return false;
+/**
+ * The machine register holding a source operand. A value kept in memory is
+ * loaded into the scratch register first, and so is a constant.
+ */
+static string registerOf(Storage &s, const Operand &o, const string &scratch, MIPSCode &mips) {
+    if (o.IsImm()) {
+        mips.Add("  li $" + scratch + ", " + to_string(o.value));
+        return scratch;
+    }
+    if (!inMemory(s, o.value))
+        return MachineRegisters[s.alloc.reg[o.value]];
+    mips.Add("  lw $" + scratch + ", " + homeOf(s, o.value));
+    return scratch;
+}
+
+static MIPSOperand mipsOperand(Storage &s, const Operand &o, const string &scratch, MIPSCode &mips) {
+    MIPSOperand m = { o.IsImm(), o.value, "" };
+    if (o.IsReg())
+        m.reg = registerOf(s, o, scratch, mips);
+    return m;
+}
+
+// The register a result is computed in: its own, or $a3 to be stored from
+static string targetOf(const Storage &s, int reg) {
+    return inMemory(s, reg) ? "a3" : MachineRegisters[s.alloc.reg[reg]];
+}
+
+// Stores a result computed in the given register if it's kept in memory
+static void storeResult(Storage &s, int reg, const string &from, MIPSCode &mips) {
+    if (inMemory(s, reg))
+        mips.Add("  sw $" + from + ", " + homeOf(s, reg));
 }
 
-void generateMIPS(vector<TACObject>& TACContainer, const bool& debug = false) {
-    map<string, pair<string, string>> regMap;
+// Restores the registers saved on entry, before the frame is popped
+static void restoreSaved(const Storage &s, MIPSCode &mips) {
+    int offset = s.frame - 4 * s.saved.size() + s.pushed;
+    for (int k = 0; k < s.saved.size(); k++)
+        mips.Add("  lw $" + s.saved[k] + ", " + to_string(offset + 4 * k) + "($sp)");
+}
 
-    vector<string> rhs_tokens;
-    //bool is_main = false;
+// Makes the register hold the value of the source operand
+static void copyTo(Storage &s, const string &to, const Operand &o, MIPSCode &mips) {
+    if (o.IsImm())
+        mips.Add("  li $" + to + ", " + to_string(o.value));
+    else if (inMemory(s, o.value))
+        mips.Add("  lw $" + to + ", " + homeOf(s, o.value));
+    else
+        mips.Add("  move $" + to + ", $" + MachineRegisters[s.alloc.reg[o.value]]);
+}
 
-    string stack_size = "";
-    int pushparam_taken = 0;
-    int registerNum = 0;
+// What the code generator keeps from one function to the next: the words
+// of the globals, and what the reports add up
+struct CodeGenerator {
+    GlobalArea globals;
+    string allocator;
+    MIPSCode mips;                      // the code of the function being generated
+    int functions = 0, tacCount = 0;
+    int before = 0, after = 0;          // MIPS instructions around the peephole optimizer
+    double generationSeconds = 0, allocationSeconds = 0;
+    int spilled = 0, copies = 0, moves = 0, throughMemory = 0;
+
+    CodeGenerator() {
+        // -O2 colors the interference graph, the lower levels take linear scan
+        allocator = GetStringOption("regalloc", GetOption("opt-level", 2) >= 2 ? "graph" : "linear");
+        if (allocator != "graph" && allocator != "linear") {
+            cerr << "Unknown register allocator \"" << allocator << "\", the allocators are graph and linear" << endl;
+            exit(2);
+        }
+    }
+};
+
+// Runs the peephole optimizer over the code generated and prints it
+static void flushMIPS(CodeGenerator &gen, ostream &out) {
+    gen.before += gen.mips.Size();
+    if (GetOption("peephole", 1))
+        gen.mips.Peephole();
+    gen.after += gen.mips.Size();
+    gen.mips.Print(out);
+    gen.mips.Clear();
+}
 
-    linearScan(regMap, TACContainer);
+/**
+ * Generates the MIPS code of a function and prints it, once the peephole
+ * optimizer is through with it.
+ *
+ * @param gen      : what the generator keeps from one function to the next
+ * @param fn       : the function, or top-level code
+ * @param out      : where to print the code
+ * @param label    : false to leave out the function's label
+ * @param callMain : true for top-level code that main is called after
+ */
+static void generateMIPS(CodeGenerator &gen, TACFunction &fn, ostream &out, bool label = true,
+                         bool callMain = false, const bool& debug = false) {
+    MIPSCode &mips = gen.mips;
+    auto generationStart = chrono::steady_clock::now();
 
     /** DEBUG **/
     Color::Modifier c_red(Color::Code::FG_RED);
     Color::Modifier c_green(Color::Code::FG_GREEN);
     Color::Modifier c_blue(Color::Code::FG_BLUE);
     Color::Modifier c_def(Color::Code::FG_DEFAULT);
-    if (debug) {
-        cout << c_blue << "(regMap content): " << endl;
-        for (const auto& trump : regMap)
-            cout << "---(dbg) " << setw(7) << trump.first << ":" << setw(7) << trump.second.first << endl;
-        cout << c_def << endl; }
     /** END DEBUG **/
 
-    cout << "  jal main" << endl;
-    for (auto &taco : TACContainer) {
+    gen.functions++;
+    gen.tacCount += fn.code.size();
+    if (fn.name >= 0) {
+        if (label)
+            mips.Add(SymbolName(fn.name) + ":");
+        Node::current_context = SymbolName(fn.name);
+    }
+
+    Storage storage(fn, gen.globals);
+    auto start = chrono::steady_clock::now();
+    storage.alloc = gen.allocator == "graph" ? graphColoringAllocation(fn) : linearScanAllocation(fn);
+    gen.allocationSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    gen.spilled += storage.alloc.spilled;
+    for (const auto &taco : fn.code) {
+        if (taco.op != op_Copy || !taco.a.IsReg())
+            continue;
+        gen.copies++;
+        if (inMemory(storage, taco.dst.value) || inMemory(storage, taco.a.value))
+            gen.throughMemory++;
+        else if (storage.alloc.reg[taco.dst.value] != storage.alloc.reg[taco.a.value])
+            gen.moves++;
+    }
+    storage.param.assign(fn.regs.size(), -1);
+    storage.paramCount = 0;
+    for (const auto &taco : fn.code)
+        if (taco.op == op_LoadParam) {
+            storage.param[taco.dst.value] = taco.a.value;
+            storage.paramCount++;
+        }
+    bool isMain = fn.name >= 0 && SymbolName(fn.name) == "main";
+    auto tailCall = [&](int i) {
+        return fn.name >= 0 && !isMain && fn.code[i].b.value <= storage.paramCount && isTailCall(fn.code, i);
+    };
+
+    // the $t registers holding values live across each call are saved
+    // around it, the $s registers the function changes once on entry
+    vector<vector<int>> callerSaved(fn.code.size());
+    int mostSaved = 0;
+    bool calls = false;
+    for (int i = 0; i < fn.code.size(); i++) {
+        if (fn.code[i].op != op_Call)
+            continue;
+        for (int r : storage.alloc.liveAcross[i]) {
+            int machine = storage.alloc.reg[r];
+            if (machine >= 0 && machine < FirstCalleeSaved)
+                callerSaved[i].push_back(machine);
+        }
+        sort(callerSaved[i].begin(), callerSaved[i].end());
+        callerSaved[i].erase(unique(callerSaved[i].begin(), callerSaved[i].end()), callerSaved[i].end());
+        mostSaved = max(mostSaved, (int)callerSaved[i].size());
+        calls |= !tailCall(i);
+    }
+    if (fn.name >= 0 && !isMain) {
+        vector<bool> calleeSaved(NumMachineRegisters, false);
+        for (int machine : storage.alloc.reg)
+            if (machine >= FirstCalleeSaved)
+                calleeSaved[machine] = true;
+        for (int machine = FirstCalleeSaved; machine < NumMachineRegisters; machine++)
+            if (calleeSaved[machine])
+                storage.saved.push_back(MachineRegisters[machine]);
+        if (calls)
+            storage.saved.push_back("ra");
+    }
+    storage.saveArea = 4 * mostSaved;
+    storage.frame = storage.saveArea + 4 * storage.alloc.slots + 4 * storage.saved.size();
+    storage.pushed = 0;
+    int &pushed = storage.pushed;
+    const int &stack_size = storage.frame;
+
+    /** DEBUG **/ if (debug) {
+    cout << c_blue << "(allocation): " << endl;
+    for (int r = 0; r < fn.regs.size(); r++)
+        if (fn.IsLocal(r) && (storage.alloc.reg[r] >= 0 || storage.alloc.slot[r] >= 0))
+            cout << "---(dbg) " << setw(7) << OperandString(fn, Operand::Reg(r)) << ":" << setw(7)
+                 << (inMemory(storage, r) ? homeOf(storage, r) : MachineRegisters[storage.alloc.reg[r]]) << endl;
+    cout << c_def << endl; }
+    /** END DEBUG **/
+
+    // the prologue comes before the parameters are loaded, which may
+    // go in the $s registers it saves
+    if (stack_size > 0)
+        mips.Add("  addi $sp, $sp, -" + to_string(stack_size));
+    for (int k = 0; k < storage.saved.size(); k++)
+        mips.Add("  sw $" + storage.saved[k] + ", " +
+                 to_string(stack_size - 4 * (storage.saved.size() - k)) + "($sp)");
+
+    vector<int> reads(fn.regs.size(), 0);
+    for (const auto &taco : fn.code)
+        for (const Operand *o : { &taco.a, &taco.b })
+            if (o->IsReg())
+                reads[o->value]++;
+
+    for (int i = 0; i < fn.code.size(); i++) {
+        auto &taco = fn.code[i];
 
         /** DEBUG **/ if (debug) {
-        cout << c_blue ;
-        printTAC(taco);
-        cout << c_def ; }
+        ostringstream tac;
+        tac << c_blue ;
+        printTAC(fn, taco, tac);
+        tac << c_def ;
+        mips.Add(tac.str()); }
         /** END DEBUG **/
 
-        switch(taco.type) {
-            case label:  cout << taco.lhs + ":" << endl;
-                         if (taco.lhs[0] != 'L') 
-                             Node::current_context = taco.lhs;
+        switch(taco.op) {
+            case op_Label:  mips.Add(OperandString(fn, taco.dst) + ":");
                          break;
-            case stmt:
-                split(taco.rhs, " ", rhs_tokens);
-
-                // Case 1) Variable is assigned a register.
-                // Examples:  a := t1, b := t4, c := t0
-                if (rhs_tokens.size() == 1 && rhs_tokens[0][0] == 't') {
-                    regMap[taco.lhs].first = taco.rhs;
-                } 
-                // Case 2) Variable is assigned a constant.
-                // Examples:  a := 2, b := 4, c := 8
-                else if (rhs_tokens.size() == 1) {
-                   // varConstToMIPS(regMap[taco.lhs], taco.rhs);
-                    cout << "  li $" + regMap[taco.lhs].first + ", " + taco.rhs 
-                         << endl;
-                } 
-                // Case 3) Variable is assigned to a binary expression.
-                // Examples:  a := t3 + t1, b := t6 + t0
-                else {
-                    string a = rhs_tokens[0];
-                    string b = rhs_tokens[2];
 
-                    if (does_trump_exists(rhs_tokens[0], regMap))
-                        a = regMap[rhs_tokens[0]].first;
-                    if (does_trump_exists(rhs_tokens[2], regMap))
-                        b = regMap[rhs_tokens[2]].first;
-
-                    auto code = binaryExprToMIPS(regMap[taco.lhs].first, a, b, rhs_tokens[1]);
+            // Case 1) Variable is assigned a register.
+            // Examples:  a := t1, b := t4, c := t0
+            // Case 2) Variable is assigned a constant.
+            // Examples:  a := 2, b := 4, c := 8
+            // Case 3) Variable is assigned another variable.
+            // Examples:  a := b
+            // A variable kept in memory is stored to straight from where
+            // the value is.
+            case op_Copy: {
+                int lhs = taco.dst.value;
+                if (inMemory(storage, lhs))
+                    storeResult(storage, lhs, registerOf(storage, taco.a, "a3", mips), mips);
+                else
+                    copyTo(storage, targetOf(storage, lhs), taco.a, mips);
+                break;
+            }
 
-                    cout << code << endl;
+            case op_BeginFunc:
+                break;
+            case op_Return:
+                if (!taco.a.IsNone())
+                    copyTo(storage, "v0", taco.a, mips);
+
+                // returning from the middle of the function runs the epilogue here
+                if (i + 1 < fn.code.size() && fn.code[i + 1].op != op_EndFunc) {
+                    restoreSaved(storage, mips);
+                    if (stack_size > 0)
+                        mips.Add("  addi $sp, $sp, " + to_string(stack_size));
+                    if (Node::current_context != "main")
+                        mips.Add("  jr $ra");
+                    else
+                        mips.Add("  li $v0, 10\n  syscall");
                 }
-
+                break;
+            case op_LoadParam:
+                // the last argument pushed is on top, right above the
+                // frame; a spilled parameter is read where it was passed
+                if (!inMemory(storage, taco.dst.value))
+                    mips.Add("  lw $" + targetOf(storage, taco.dst.value) + ", " + homeOf(storage, taco.dst.value));
+                break;
+            case op_PushParam:
+                mips.Add("  addi $sp, $sp, -4");
+                pushed += 4;
+                mips.Add("  sw $" + registerOf(storage, taco.a, "v1", mips) + ", 0($sp)");
+                break;
+            case op_PopParam:
+                mips.Add("  addi $sp, $sp, " + to_string(taco.a.value));
+                pushed -= taco.a.value;
+                break;
+            case op_EndFunc:
+                if (fn.name < 0)
+                    break;
+                restoreSaved(storage, mips);
+                if (stack_size > 0)
+                    mips.Add("  addi $sp, $sp, " + to_string(stack_size));
+                if (Node::current_context != "main")
+                    mips.Add("  jr $ra");
                 break;
 
-//            case instr:  cout << "(DEBUG) sc_code : " << taco.sc_code << endl;
-            case instr:   
-                if (taco.lhs == "BeginFunc") {
-                    cout << "  addi $sp, $sp, -" + taco.rhs << endl;
-                    stack_size = taco.rhs;
-                } else if (taco.lhs == "Return") {
-                    cout << "  move $v0, $" + regMap[taco.rhs].first << endl;
-                    registerNum = 0;
-                } else if (taco.lhs == "LoadParam") {
-                    cout << "  lw $t" + to_string(registerNum)
-                         << ", " << to_string(registerNum * 4) << "($sp)" 
-                         << endl;
-                    regMap[taco.rhs] = make_pair("t" + to_string(registerNum++), "");
-                } else if (taco.lhs == "PushParam") {
-                    cout << "  addi $sp, $sp, -4" << endl;
-                    cout << "  sw $" + regMap[taco.rhs].first + ", 0($sp)" << endl;
-                    pushparam_taken++;
-                } else if (taco.lhs == "EndFunc") {
-                    cout << "  addi $sp, $sp, " + stack_size << endl;
-                    if (Node::current_context != "main")
-                        cout << "  jr $ra" << endl;
-                } else if (taco.lhs == "SaveRegisters") {
-                    int count = 0;
-                    cout << "  # save registers..." << endl;
-                    for (const auto &r : regMap) {
-                        Trump trump = r.second;
-                        if (trump.second == "main") {
-                            cout << "  sw $" + trump.first + ", " + to_string(count * 4) + "($sp)" << endl;
-                            count++;
-                        }
-                    }
+            // the registers to save are only known at the call, calls
+            // without arguments have none of these and calls made for an
+            // argument come in between
+            case op_SaveRegisters:
+            case op_RestoreRegisters:
+                break;
 
-                } else if (taco.lhs == "RestoreRegisters") {
-                    cout << "  addi $sp, $sp, " + to_string(4 * pushparam_taken) << endl;
-                    cout << "  # restore registers..." << endl;
-                    int count = 0;
-                     for (const auto &r : regMap) {
-                        Trump trump = r.second;
-                        if (trump.second == "main") {
-                            cout << "  sw $" + trump.first + ", " + to_string(count * 4) + "($sp)" << endl;
-                            count++;
-                        }
+            case op_ReadInt:
+                mips.Add("  li $v0, 5\n"
+                         "  syscall");
+                if (inMemory(storage, taco.dst.value))
+                    storeResult(storage, taco.dst.value, "v0", mips);
+                else
+                    mips.Add("  move $" + targetOf(storage, taco.dst.value) + ", $v0");
+                break;
+            case op_Call:
+                // a call in tail position returns straight to our caller:
+                // its arguments take the place of ours and our frame is
+                // popped, then it's jumped to with our return address
+                if (tailCall(i)) {
+                    restoreSaved(storage, mips);
+                    for (int k = 0; k < pushed; k += 4) {
+                        mips.Add("  lw $v1, " + to_string(k) + "($sp)");
+                        mips.Add("  sw $v1, " + to_string(pushed + stack_size + k) + "($sp)");
                     }
+                    mips.Add("  addi $sp, $sp, " + to_string(pushed + stack_size));
+                    mips.Add("  j " + OperandString(fn, taco.a));
+                    pushed = 0;
+                    i += fn.code[i + 3].op == op_Return ? 3 : 2;
+                    break;
                 }
+                if (!callerSaved[i].empty())
+                    mips.Add("  # save registers...");
+                for (int k = 0; k < callerSaved[i].size(); k++)
+                    mips.Add("  sw $" + string(MachineRegisters[callerSaved[i][k]]) + ", " +
+                             to_string(pushed + 4 * k) + "($sp)");
+                mips.Add("  jal " + OperandString(fn, taco.a));
+                if (inMemory(storage, taco.dst.value))
+                    storeResult(storage, taco.dst.value, "v0", mips);
+                else
+                    mips.Add("  move $" + targetOf(storage, taco.dst.value) + ", $v0");
+                if (!callerSaved[i].empty())
+                    mips.Add("  # restore registers...");
+                for (int k = 0; k < callerSaved[i].size(); k++)
+                    mips.Add("  lw $" + string(MachineRegisters[callerSaved[i][k]]) + ", " +
+                             to_string(pushed + 4 * k) + "($sp)");
                 break;
+            case op_Print:
+                mips.Add("  li $v0, 1");
+                copyTo(storage, "a0", taco.a, mips);
+                mips.Add("  syscall");
                 break;
 
-            case call:
-                switch (taco.sc_code) {
-                    case sc_ReadInt:
-                        cout << "  li $v0, 5"       << endl
-                             << "  syscall"         << endl
-                             << "  move $" << taco.lhs << ", $v0" << endl;
-                        break;
-                    case sc_None:
-                        split(taco.rhs, " ", rhs_tokens);
-                        cout << "  jal " + rhs_tokens[0] << endl;
-                        cout << "  move $" + taco.lhs + ", $v0" << endl;
-                        break;
-                    default:
-                        cout << "ERROR" << endl;
-                        break;
-                }
+            case op_IfGoto:
+                if (taco.a.IsReg())
+                    mips.Add("  bne $" + registerOf(storage, taco.a, "a1", mips) + ", $zero, " + OperandString(fn, taco.dst));
+                else if (taco.a.IsNone() || taco.a.value != 0)
+                    mips.Add("  j " + OperandString(fn, taco.dst));
                 break;
-            case print: cout << "  li $v0, 1\n"
-                              << "  move $a0, $" + regMap[taco.rhs].first << "\n"
-                              << "  syscall" 
-                         << endl;
-                         break;
 
-            case branch: cout << "  bne $" + taco.lhs + ", $zero, " + taco.rhs 
-                         << endl;
+            case op_Goto:   mips.Add("  j " + OperandString(fn, taco.dst));
                          break;
 
-            case jump:   cout << "  j " + taco.lhs << endl; 
-                         break;
+            default:
+                // Case 4) Variable is assigned to a unary or binary expression.
+                // Examples:  a := t3 + t1, b := t6 + t0
+                if (taco.op == op_Neg || IsBinary(taco.op)) {
+                    MIPSOperand a = mipsOperand(storage, taco.a, "a1", mips);
+                    MIPSOperand b = mipsOperand(storage, taco.b, "a2", mips);
+                    tacop op = taco.op;
+
+                    // Case 5) A comparison only read by the branch right
+                    // after it is the branch.
+                    // Examples:  t2 := t1 < 10, if t2 goto L3
+                    bool compare = op >= op_Less && op <= op_NotEqual;
+                    if (compare && isTemp(fn, taco.dst) && reads[taco.dst.value] == 1 && i + 1 < fn.code.size() &&
+                        fn.code[i + 1].op == op_IfGoto && fn.code[i + 1].a == taco.dst) {
+                        mips.Add(branchToMIPS(a, b, op, OperandString(fn, fn.code[i + 1].dst)));
+                        i++;
+                        break;
+                    }
+                    if (op == op_Neg) {
+                        b = a;
+                        a = { true, 0, "" };
+                        op = op_Sub;
+                    }
+
+                    string target = targetOf(storage, taco.dst.value);
+                    auto code = binaryExprToMIPS(target, a, b, op);
 
-            default:     cout << "(TACO Type Error) type: " << taco.type << endl;
+                    mips.Add(code);
+                    storeResult(storage, taco.dst.value, target, mips);
+                } else
+                    mips.Add("(TACO Type Error) op: " + to_string(taco.op));
         }
     }
+    if (fn.name < 0 && stack_size > 0)
+        mips.Add("  addi $sp, $sp, " + to_string(stack_size));
+    // the top-level code sets the globals up before main is called
+    if (callMain)
+        mips.Add("  jal main");
+
+    flushMIPS(gen, out);
+    gen.generationSeconds += chrono::duration<double>(chrono::steady_clock::now() - generationStart).count();
+}
+
+// Ends the program, and reports on the code generated
+static void finishMIPS(CodeGenerator &gen, ostream &out) {
+    gen.mips.Add("  # End Program");
+    gen.mips.Add("  li $v0, 10");
+    gen.mips.Add("  syscall");
+    flushMIPS(gen, out);
+
+    if (GetOption("time-passes", 0)) {
+        cerr << "===--- Code generation report ---===" << endl;
+        cerr << "Functions: " << gen.functions << ", TAC instructions: " << gen.tacCount
+             << ", MIPS emitted in " << fixed << setprecision(3) << gen.generationSeconds * 1000 << " ms" << endl;
+        cerr << "===--- Peephole report ---===" << endl;
+        cerr << "MIPS instructions: " << gen.before << " before, " << gen.after << " after" << endl;
+        gen.mips.PrintReport(cerr);
+        cerr << "===--- Register allocation report ---===" << endl;
+        cerr << "Allocator: " << gen.allocator << ", " << fixed << setprecision(3) << gen.allocationSeconds * 1000 << " ms" << endl;
+        cerr << "Virtual registers spilled: " << gen.spilled << endl;
+        cerr << "Copies: " << gen.copies << ", " << gen.moves << " left as moves, " << gen.throughMemory << " through memory" << endl;
+    }
+}
+
+// The passes run at -O0, -O1 and -O2 (the default) without -passes=
+static const char *Pipeline_O0 = "";
+static const char *Pipeline_O1 = "rotate,(fold,constprop,dce),layout";
+static const char *Pipeline_O2 = "tre,inline,(fold,constprop,gvn,dce),unroll,(fold,constprop,gvn,dce),licm,unswitch,"
+                                  "iv,rotate,(fold,constprop,gvn,dce),layout";
+
+static const int DefaultInlineWindow = 1000;
+
+Program::Program() : generator(NULL), functionsStarted(false), mainDecl(NULL), compiled(tmpfile()) {
+    passes = new PassManager;
+    passes->Register("tre", eliminateTailRecursion);
+    passes->Register("inline", inlineCalls);
+    passes->Register("fold", algebraicSimplification);
+    passes->Register("constprop", constantPropagation);
+    passes->Register("gvn", globalValueNumbering);
+    passes->Register("licm", loopInvariantCodeMotion);
+    passes->Register("iv", strengthReduction);
+    passes->Register("unroll", loopUnrolling);
+    passes->Register("rotate", loopRotation);
+    passes->Register("unswitch", loopUnswitching);
+    passes->Register("dce", deadCodeElimination);
+    passes->Register("layout", blockLayout);
+
+    pipeline = GetStringOption("passes", NULL);
+    if (pipeline == NULL) {
+        int level = GetOption("opt-level", 2);
+        pipeline = level <= 0 ? Pipeline_O0 : level == 1 ? Pipeline_O1 : Pipeline_O2;
+    }
+    if (!IsDebugOn("tac"))
+        generator = new CodeGenerator;
+}
 
-    // End of Program
-    cout << "  # End Program" << endl;
-    cout << "  li $v0, 10" << endl;
-    cout << "  syscall" << endl;
-//    for (const auto &asd : regMap)
-//        cout << asd.first << " is mapped to " << asd.second.first << " in " << asd.second.second << endl;
+/**
+ * Runs the passes on a function, or on top-level code, and generates its
+ * code.
+ *
+ * @param fn       : the function, done with once this returns
+ * @param label    : false to leave out the function's label
+ * @param callMain : true for top-level code that main is called after
+ * @return its MIPS code, or its TAC with -d tac
+ */
+string Program::Compile(TACFunction &fn, bool label, bool callMain) {
+    passes->Run(fn, pipeline);
+    renumberTemps(fn);
+    ostringstream code;
+    if (IsDebugOn("cfg") && !fn.code.empty())
+        CFG(fn).Print(code);
+    if (IsDebugOn("reaching") && !fn.code.empty()) {
+        CFG cfg(fn);
+        ReachingDefinitions(cfg).Print(cfg, code);
+    }
+
+    if (generator)
+        generateMIPS(*generator, fn, code, label, callMain);
+    else
+        generateIR(fn, code, label);
+
+    // no temps are made for the function any more
+    if (fn.name >= 0)
+        tempRegister.erase(SymbolName(fn.name));
+    return code.str();
 }
 
-string Program::Emit() {
-    if ( decls->NumElements() > 0 )
-        for ( int i = 0; i < decls->NumElements(); ++i )
-            decls->Nth(i)->Emit();
+void Program::Compile(Decl *decl) {
+    if (ReportError::NumErrors() > 0)
+        return;
+
+    // a global's initializer goes with the top-level code
+    FnDecl *fn = dynamic_cast<FnDecl*>(decl);
+    if (fn == NULL) {
+        decl->Emit();
+        delete decl;
+        return;
+    }
 
-    constantFolding(TACContainer);
-    //constantPropagation(TACContainer);
-    //deadCodeElimination(TACContainer);
+    if (!functionsStarted) {
+        Put(Compile(TACProgram[0], true, true));
+        TACProgram[0] = TACFunction(-1);
+        functionsStarted = true;
+    }
+    if (mainDecl == NULL && strcmp(fn->GetIdentifier()->GetName(), "main") == 0) {
+        mainDecl = fn;
+        return;
+    }
 
-    //generateIR(TACContainer);
-    generateMIPS(TACContainer);
-    return "Program::Emit()";
+    fn->Emit();
+    delete fn;
+    int name = TACProgram.back().name;
+    string code = Compile(TACProgram.back());
+    TACProgram.pop_back();
+    if (isInlineCandidate(name))
+        Hold(name, code);
+    else
+        Put(code);
 }
 
-string StmtBlock::Emit() {
+// Holds back the code of a function that may be inlined; once the window
+// is full the oldest one held comes out, and isn't inlined any more
+void Program::Hold(int name, const string &code) {
+    held.emplace_back(name, code);
+    if (held.size() <= GetOption("inline-window", DefaultInlineWindow))
+        return;
+    Put(held.front().second);
+    forgetInlineCandidate(held.front().first);
+    held.pop_front();
+}
+
+// Adds code to what was compiled so far, kept in the temporary file until
+// the end; without one it goes straight out
+void Program::Put(const string &code) {
+    if (compiled)
+        fwrite(code.data(), 1, code.size(), compiled);
+    else
+        cout << code;
+}
+
+Operand Program::Emit() {
+    if (!functionsStarted) {
+        Put(Compile(TACProgram[0]));
+    } else {
+        // top-level code after the first function runs at the start of main
+        bool late = !TACProgram[0].code.empty();
+        string code = late ? Compile(TACProgram[0]) : "";
+        if (mainDecl != NULL) {
+            if (late)
+                code = "main:\n" + code;
+            mainDecl->Emit();
+            delete mainDecl;
+            code += Compile(TACProgram.back(), !late);
+            TACProgram.pop_back();
+        }
+
+        // main ends the program, so what was held back comes before it
+        for (const auto &function : held)
+            if (!allCallsInlined(function.first))
+                Put(function.second);
+        Put(code);
+    }
+    if (ReportError::NumErrors() > 0)
+        return Operand();
+
+    // the whole program compiled, what was kept back can come out
+    if (compiled) {
+        char buffer[BUFSIZ];
+        rewind(compiled);
+        for (size_t n; (n = fread(buffer, 1, sizeof buffer, compiled)) > 0; )
+            cout.write(buffer, n);
+        fclose(compiled);
+        compiled = NULL;
+    }
+
+    if (GetOption("time-passes", 0))
+        passes->PrintReport(cerr);
+    if (generator)
+        finishMIPS(*generator, cout);
+    return Operand();
+}
+
+Operand StmtBlock::Emit() {
     for(int i = 0; i < stmts->NumElements(); i++){
         Stmt* ith_statement = stmts->Nth(i);
         ith_statement->Emit();
     }
 
-    return "StmtBlock::Emit()";
+    return Operand();
 }
 
-string ForStmt::Emit() {
-    string inc_var = init->Emit();
+Operand ForStmt::Emit() {
+    init->Emit();
 
-    string label0 = "L" + to_string(labelCounter++);
-    string label1 = "L" + to_string(labelCounter++);
-    string label2 = "L" + to_string(labelCounter++);
+    Operand label0 = NewLabel();
+    Operand label1 = NewLabel();
+    Operand label2 = NewLabel();
 
-    TACContainer.emplace_back(label0, "", 0, label);
-    TACContainer.emplace_back(test->Emit(), label1, 0, branch);
-    TACContainer.emplace_back(label2, "", 0, jump);
-    TACContainer.emplace_back(label1, "", 0, label);
+    Gen(op_Label, label0);
+    test->EmitBranch(label1, label2);
+    Gen(op_Label, label1);
     body->Emit();
     step->Emit();
-    TACContainer.emplace_back(label0, "", 0, jump);
-    TACContainer.emplace_back(label2, "", 0, label);
-    return "ForStmt::Emit()";
+    Gen(op_Goto, label0);
+    Gen(op_Label, label2);
+    return Operand();
 }
 
-string WhileStmt::Emit() {
-    string label0 = "L" + to_string(labelCounter++);
-    string label1 = "L" + to_string(labelCounter++);
-    string label2 = "L" + to_string(labelCounter++);
+Operand WhileStmt::Emit() {
+    Operand label0 = NewLabel();
+    Operand label1 = NewLabel();
+    Operand label2 = NewLabel();
 
-    TACContainer.emplace_back(label0, "", 0, label);
-    TACContainer.emplace_back(test->Emit(), label1, 0, branch);
-    TACContainer.emplace_back(label2, "", 0, jump);
-    TACContainer.emplace_back(label1, "", 0, label);
+    Gen(op_Label, label0);
+    test->EmitBranch(label1, label2);
+    Gen(op_Label, label1);
     body->Emit();
-    TACContainer.emplace_back(label0, "", 0, jump);
-    TACContainer.emplace_back(label2, "", 0, label);
-    return "WhileStmt::Emit()";
+    Gen(op_Goto, label0);
+    Gen(op_Label, label2);
+    return Operand();
 }
 
-string IfStmt::Emit() {
-    string ifLabel = "L" + to_string(labelCounter++);
-    string elseLabel = "L" + to_string(labelCounter++);
-
-    TACContainer.emplace_back(test->Emit(), ifLabel, 0, branch);
+Operand IfStmt::Emit() {
+    Operand ifLabel = NewLabel();
+    Operand elseLabel = NewLabel();
 
-    TACContainer.emplace_back(elseLabel, "", 0, jump);
+    test->EmitBranch(ifLabel, elseLabel);
 
-    TACContainer.emplace_back(ifLabel, "", 0, label);
+    Gen(op_Label, ifLabel);
 
     body->Emit();
 
-    string exitLabel = (elseBody) ? "L" + to_string(labelCounter++) : elseLabel;
-    TACContainer.emplace_back(exitLabel, "", 0, jump);
+    Operand exitLabel = (elseBody) ? NewLabel() : elseLabel;
+    Gen(op_Goto, exitLabel);
 
     if (elseBody) {
-        TACContainer.emplace_back(elseLabel, "", 0, label);
+        Gen(op_Label, elseLabel);
         elseBody->Emit();
-        TACContainer.emplace_back(exitLabel, "", 0, jump);
+        Gen(op_Goto, exitLabel);
     }
 
-    TACContainer.emplace_back(exitLabel, "", 0, label);
-    return "ifStmt";
+    Gen(op_Label, exitLabel);
+    return Operand();
 }
 
-string ReturnStmt::Emit() {
-    string rhs = expr->Emit();
-    TACContainer.emplace_back("Return", rhs, 0, instr);
+Operand ReturnStmt::Emit() {
+    Operand rhs = expr->Emit();
+    Gen(op_Return, Operand(), rhs);
 
-    return "ReturnStmt Emit()";
+    return Operand();
 }
 
-string DeclStmt::Emit() {
+Operand DeclStmt::Emit() {
     varDecl->Emit();
-    return "DeclStmt Emit()";
+    return Operand();
 }
@@ -15,24 +15,58 @@
 
 #include "list.h"
 #include "ast.h"
+#include <cstdio>
+#include <deque>
+#include <utility>
 
 class Decl;
 class VarDecl;
+class FnDecl;
 class Expr;
 class IntConstant;
+class PassManager;
+struct CodeGenerator;
 
 void yyerror(const char *msg);
 
+/* The program is compiled a declaration at a time, as the parser hands
+ * them over: a function is lowered, optimized, given registers and
+ * emitted, and its tree and TAC deleted, before the next one is parsed,
+ * so memory goes with the largest function rather than the program.
+ *
+ * The top-level code before the first function comes out first, followed
+ * by the call to main. main itself is compiled last, so every function it
+ * calls can be inlined into it, and top-level code after the first
+ * function runs at its start. A function small enough to be inlined is
+ * held back until the end (or until -finline-window=N functions like it
+ * came after it, 1000 by default), and left out if every call to it was
+ * inlined.
+ *
+ * The code compiled goes to a temporary file rather than to the output.
+ * It is copied out at the end only when the whole program compiled
+ * without errors, so an error late in the file leaves the output empty,
+ * as if the program had been compiled at once.
+ */
 class Program : public Node
 {
   protected:
-     List<Decl*> *decls;
+     PassManager *passes;
+     const char *pipeline;
+     CodeGenerator *generator;          // NULL when the TAC is printed instead
+     bool functionsStarted;             // the top-level code before the first function is out
+     FnDecl *mainDecl;
+     deque<pair<int, string>> held;     // functions held back and their code, oldest first
+     FILE *compiled;                    // the code out so far, NULL if no temporary file could be made
+
+     string Compile(TACFunction &fn, bool label = true, bool callMain = false);
+     void Hold(int name, const string &code);
+     void Put(const string &code);
 
   public:
-     Program(List<Decl*> *declList);
+     Program();
      const char *GetPrintNameForNode() { return "Program"; }
-     void PrintChildren(int indentLevel);
-     virtual string Emit();
+     void Compile(Decl *decl);          // compiles and deletes a declaration just parsed
+     virtual Operand Emit();            // compiles what waits for the end of the program
 };
 
 class Stmt : public Node
@@ -49,9 +83,10 @@ class StmtBlock : public Stmt
 
   public:
     StmtBlock(List<Stmt*> *statements);
+    ~StmtBlock();
     const char *GetPrintNameForNode() { return "StmtBlock"; }
     void PrintChildren(int indentLevel);
-    string virtual Emit();
+    virtual Operand Emit();
 };
 
 
@@ -64,6 +99,7 @@ class ConditionalStmt : public Stmt
   public:
     ConditionalStmt() : Stmt(), test(NULL), body(NULL) {}
     ConditionalStmt(Expr *testExpr, Stmt *body);
+    ~ConditionalStmt();
 };
 
 class LoopStmt : public ConditionalStmt
@@ -80,9 +116,10 @@ class ForStmt : public LoopStmt
 
   public:
     ForStmt(Expr *init, Expr *test, Expr *step, Stmt *body);
+    ~ForStmt();
     const char *GetPrintNameForNode() { return "ForStmt"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class WhileStmt : public LoopStmt
@@ -91,7 +128,7 @@ class WhileStmt : public LoopStmt
     WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) {}
     const char *GetPrintNameForNode() { return "WhileStmt"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 
@@ -103,9 +140,10 @@ class IfStmt : public ConditionalStmt
   public:
     IfStmt() : ConditionalStmt(), elseBody(NULL) {}
     IfStmt(Expr *test, Stmt *thenBody, Stmt *elseBody);
+    ~IfStmt();
     const char *GetPrintNameForNode() { return "IfStmt"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class IfStmtExprError : public IfStmt
@@ -129,9 +167,10 @@ class ReturnStmt : public Stmt
 
   public:
     ReturnStmt(yyltype loc, Expr *expr);
+    ~ReturnStmt();
     const char *GetPrintNameForNode() { return "ReturnStmt"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 class DeclStmt: public Stmt
@@ -141,9 +180,10 @@ class DeclStmt: public Stmt
 
   public:
     DeclStmt(yyltype loc, Decl* decl);
+    ~DeclStmt();
     const char *GetPrintNameForNode() { return "DeclStmt"; }
     void PrintChildren(int indentLevel);
-    virtual string Emit();
+    virtual Operand Emit();
 };
 
 #endif
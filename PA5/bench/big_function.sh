@@ -0,0 +1,41 @@
+#!/bin/bash
+#
+# Prints a program whose main is one large function: N loops of ten
+# statements over twenty variables, with invariant sums, multiples of the
+# counter and running totals. Half the loops run a constant number of
+# times, the others as many as the second number read. The choices are
+# random but the same for a given seed.
+#
+# usage: bench/big_function.sh N [seed]
+
+if [ -z "$1" ]; then
+    echo "usage: $0 N [seed]"
+    exit 1
+fi
+RANDOM=${2:-1}
+
+echo "void main() {"
+echo "    int a = readIntFromSTDIN();"
+echo "    int b = readIntFromSTDIN();"
+echo "    int i;"
+for v in $(seq 0 19); do
+    echo "    int v$v = $((RANDOM % 10));"
+done
+for n in $(seq 1 $1); do
+    if [ $((RANDOM % 2)) -eq 0 ]; then bound=b; else bound=$((RANDOM % 8 + 2)); fi
+    echo "    for (i = 0; i < $bound; i++) {"
+    for s in $(seq 1 10); do
+        x=v$((RANDOM % 20)); y=v$((RANDOM % 20))
+        case $((RANDOM % 4)) in
+            0) echo "        $x = a + b;" ;;
+            1) echo "        $x = i * 4;" ;;
+            2) echo "        $x = $x + $y;" ;;
+            3) echo "        $x = $y + $((RANDOM % 10));" ;;
+        esac
+    done
+    echo "    }"
+done
+for v in $(seq 0 19); do
+    echo "    printInt(v$v);"
+done
+echo "}"
@@ -0,0 +1,46 @@
+#!/bin/bash
+#
+# Prints a program of N small functions and a main calling a few of them.
+# Most functions call one of the fifty defined before them, some add to a
+# global, some have an if. The choices are random but the same for a given
+# seed. The program grows with N while each function stays small, which is
+# what the memory the compiler needs should follow.
+#
+# usage: bench/many_functions.sh N [seed]
+
+if [ -z "$1" ]; then
+    echo "usage: $0 N [seed]"
+    exit 1
+fi
+RANDOM=${2:-1}
+
+echo "int g;"
+for f in $(seq 0 $(($1 - 1))); do
+    echo "int f$f(int a, int b) {"
+    echo "    int c = a + b;"
+    echo "    int d = c + $((RANDOM % 9 + 1));"
+    if [ $f -gt 0 ] && [ $((RANDOM % 10)) -lt 7 ]; then
+        from=$((f > 50 ? f - 50 : 0))
+        echo "    d = f$((from + RANDOM % (f - from)))(c, d);"
+    fi
+    if [ $((RANDOM % 10)) -lt 3 ]; then
+        echo "    g = g + d;"
+    fi
+    if [ $((RANDOM % 10)) -lt 3 ]; then
+        echo "    if (d > 1000) {"
+        echo "        d = d + -1000;"
+        echo "    }"
+    fi
+    echo "    return d + a;"
+    echo "}"
+done
+echo "void main() {"
+echo "    int a = readIntFromSTDIN();"
+echo "    int b = readIntFromSTDIN();"
+for k in $(seq 1 10); do
+    echo "    a = f$((RANDOM % $1))(a, b);"
+    echo "    b = b + 1;"
+done
+echo "    printInt(a);"
+echo "    printInt(g);"
+echo "}"
@@ -0,0 +1,308 @@
+/**
+ * File: cfg.cc
+ * ------------
+ * Basic blocks, dominators and natural loops of a TACFunction.
+ */
+
+#include "cfg.h"
+#include <algorithm>
+
+CFG::CFG(TACFunction &fn) : fn(fn) {
+    SplitBlocks();
+    ConnectBlocks();
+    ComputeOrder();
+    ComputeDominators();
+    ComputeFrontiers();
+    FindLoops();
+
+    for (int i = 0; i < blocks.size(); i++)
+        if (IsReachable(i))
+            layout.push_back(i);
+}
+
+int CFG::NewBlock() {
+    BasicBlock b;
+    b.label = NewLabelNumber();
+    b.code.emplace_back(op_Label, Operand::Label(b.label));
+    blocks.push_back(b);
+    labelBlock[b.label] = blocks.size() - 1;
+    return blocks.size() - 1;
+}
+
+void CFG::Linearize() {
+    fn.code.clear();
+    for (int b : layout)
+        fn.code.insert(fn.code.end(), blocks[b].code.begin(), blocks[b].code.end());
+}
+
+// Instructions after which control does not reach the next instruction
+static bool endsBlock(tacop op) {
+    return op == op_IfGoto || op == op_Goto || op == op_Return || op == op_EndFunc;
+}
+
+void CFG::SplitBlocks() {
+    blocks.push_back(BasicBlock());
+
+    for (const TACObject &taco : fn.code) {
+        if (taco.op == op_Label && !blocks.back().code.empty())
+            blocks.push_back(BasicBlock());
+
+        BasicBlock &b = blocks.back();
+        if (taco.op == op_Label && b.code.empty()) {
+            b.label = taco.dst.value;
+            labelBlock[b.label] = blocks.size() - 1;
+        }
+        b.code.push_back(taco);
+
+        if (endsBlock(taco.op))
+            blocks.push_back(BasicBlock());
+    }
+
+    if (blocks.size() > 1 && blocks.back().code.empty())
+        blocks.pop_back();
+}
+
+void CFG::ConnectBlocks() {
+    // a return leaves through the block holding EndFunc
+    int exit = -1;
+    for (int i = 0; i < blocks.size(); i++)
+        if (!blocks[i].code.empty() && blocks[i].code.back().op == op_EndFunc)
+            exit = i;
+
+    for (int i = 0; i < blocks.size(); i++) {
+        BasicBlock &b = blocks[i];
+        tacop last = b.code.empty() ? op_Label : b.code.back().op;
+
+        if (IsBranch(last))
+            b.succs.push_back(labelBlock.at(b.code.back().dst.value));
+        if (last == op_Return && exit >= 0)
+            b.succs.push_back(exit);
+
+        bool fallsThrough = last != op_Goto && last != op_Return && last != op_EndFunc;
+        if (fallsThrough && i + 1 < blocks.size() &&
+            find(b.succs.begin(), b.succs.end(), i + 1) == b.succs.end())
+            b.succs.push_back(i + 1);
+
+        for (int s : b.succs)
+            blocks[s].preds.push_back(i);
+    }
+}
+
+void CFG::ComputeOrder() {
+    // iterative depth first search, a block is finished once all of its
+    // successors have been visited
+    vector<pair<int,int>> stack;    // block, next successor to visit
+    vector<bool> visited(blocks.size(), false);
+
+    stack.emplace_back(0, 0);
+    visited[0] = true;
+    while (!stack.empty()) {
+        int b = stack.back().first;
+        int &next = stack.back().second;
+
+        if (next < blocks[b].succs.size()) {
+            int s = blocks[b].succs[next++];
+            if (!visited[s]) {
+                visited[s] = true;
+                stack.emplace_back(s, 0);
+            }
+        } else {
+            order.push_back(b);
+            stack.pop_back();
+        }
+    }
+
+    reverse(order.begin(), order.end());
+    for (int i = 0; i < order.size(); i++)
+        blocks[order[i]].rpo = i;
+}
+
+/**
+ * Cooper, Harvey and Kennedy: iterate over the reverse postorder setting
+ * each block's immediate dominator to the common ancestor of its processed
+ * predecessors until nothing changes. Blocks are compared by rpo number.
+ */
+void CFG::ComputeDominators() {
+    vector<int> idom(order.size(), -1);     // indexed by rpo number
+    idom[0] = 0;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < order.size(); i++) {
+            int newIdom = -1;
+            for (int p : blocks[order[i]].preds) {
+                int finger = blocks[p].rpo;
+                if (finger < 0 || idom[finger] < 0)
+                    continue;
+                if (newIdom < 0) {
+                    newIdom = finger;
+                    continue;
+                }
+
+                int other = newIdom;
+                while (finger != other) {
+                    while (finger > other) finger = idom[finger];
+                    while (other > finger) other = idom[other];
+                }
+                newIdom = finger;
+            }
+
+            if (idom[i] != newIdom) {
+                idom[i] = newIdom;
+                changed = true;
+            }
+        }
+    }
+
+    for (int i = 1; i < order.size(); i++) {
+        int b = order[i];
+        blocks[b].idom = order[idom[i]];
+        blocks[blocks[b].idom].domChildren.push_back(b);
+    }
+
+    // number the dominator tree so Dominates() is two comparisons
+    preorder.assign(blocks.size(), -1);
+    postorder.assign(blocks.size(), -1);
+    vector<pair<int,int>> stack;
+    int pre = 0, post = 0;
+    stack.emplace_back(0, 0);
+    preorder[0] = pre++;
+    while (!stack.empty()) {
+        int b = stack.back().first;
+        int &next = stack.back().second;
+        if (next < blocks[b].domChildren.size()) {
+            int c = blocks[b].domChildren[next++];
+            preorder[c] = pre++;
+            stack.emplace_back(c, 0);
+        } else {
+            postorder[b] = post++;
+            stack.pop_back();
+        }
+    }
+}
+
+bool CFG::Dominates(int a, int b) const {
+    if (!IsReachable(a) || !IsReachable(b))
+        return false;
+    return preorder[a] <= preorder[b] && postorder[b] <= postorder[a];
+}
+
+/**
+ * A join point is in the frontier of every block on the dominator tree path
+ * from each of its predecessors up to (not including) its immediate
+ * dominator.
+ */
+void CFG::ComputeFrontiers() {
+    for (int b : order) {
+        if (blocks[b].preds.size() < 2)
+            continue;
+
+        for (int p : blocks[b].preds) {
+            for (int runner = p; IsReachable(runner) && runner != blocks[b].idom; runner = blocks[runner].idom) {
+                vector<int> &df = blocks[runner].frontier;
+                if (find(df.begin(), df.end(), b) == df.end())
+                    df.push_back(b);
+                if (runner == 0)
+                    break;
+            }
+        }
+    }
+}
+
+/**
+ * Every edge to a block that dominates its source is a back edge; the loop
+ * it closes is the header plus every block reaching the latch without going
+ * through the header. Back edges to the same header form one loop.
+ */
+void CFG::FindLoops() {
+    unordered_map<int, int> headerLoop;     // header -> loop
+
+    for (int b : order) {
+        for (int h : blocks[b].succs) {
+            if (!Dominates(h, b))
+                continue;
+
+            if (headerLoop.find(h) == headerLoop.end()) {
+                headerLoop[h] = loops.size();
+                loops.push_back({ h, { h }, {}, -1, 1 });
+            }
+            Loop &loop = loops[headerLoop[h]];
+            loop.latches.push_back(b);
+
+            vector<bool> inLoop(blocks.size(), false);
+            for (int x : loop.blocks) inLoop[x] = true;
+
+            vector<int> work;
+            if (!inLoop[b]) {
+                inLoop[b] = true;
+                loop.blocks.push_back(b);
+                work.push_back(b);
+            }
+            while (!work.empty()) {
+                int x = work.back();
+                work.pop_back();
+                for (int p : blocks[x].preds) {
+                    if (!inLoop[p] && IsReachable(p)) {
+                        inLoop[p] = true;
+                        loop.blocks.push_back(p);
+                        work.push_back(p);
+                    }
+                }
+            }
+        }
+    }
+
+    // outer loops have more blocks than the loops they contain
+    sort(loops.begin(), loops.end(), [](const Loop &a, const Loop &b) {
+        return a.blocks.size() > b.blocks.size();
+    });
+
+    for (int i = 0; i < loops.size(); i++) {
+        Loop &loop = loops[i];
+        sort(loop.blocks.begin(), loop.blocks.end());
+
+        // the innermost loop seen so far that contains the header encloses this one
+        loop.parent = blocks[loop.header].loop;
+        loop.depth = loop.parent < 0 ? 1 : loops[loop.parent].depth + 1;
+        for (int b : loop.blocks)
+            blocks[b].loop = i;
+    }
+}
+
+static void printList(ostream &out, const char *title, const vector<int> &list) {
+    out << " " << title << ":";
+    for (int b : list)
+        out << " B" << b;
+}
+
+void CFG::Print(ostream &out) const {
+    out << "CFG " << (fn.name >= 0 ? SymbolName(fn.name) : "<top level>") << endl;
+
+    for (int i = 0; i < blocks.size(); i++) {
+        const BasicBlock &b = blocks[i];
+        out << "  B" << i;
+        if (b.label >= 0)
+            out << " (L" << b.label << ")";
+        out << " " << b.code.size() << " instr";
+
+        if (!IsReachable(i)) {
+            out << ", unreachable" << endl;
+            continue;
+        }
+
+        printList(out, "succs", b.succs);
+        printList(out, "preds", b.preds);
+        if (b.idom >= 0)
+            out << " idom: B" << b.idom;
+        printList(out, "df", b.frontier);
+        out << endl;
+    }
+
+    for (const Loop &loop : loops) {
+        out << "  loop B" << loop.header << " depth " << loop.depth;
+        printList(out, "blocks", loop.blocks);
+        printList(out, "latches", loop.latches);
+        out << endl;
+    }
+}
@@ -0,0 +1,88 @@
+/**
+ * File: cfg.h
+ * -----------
+ * Control-flow graph of one TACFunction. The function's code is split into
+ * basic blocks: a block starts at a label (or after a branch, jump or
+ * return) and ends with at most one control transfer. A return's successor
+ * is the block holding EndFunc. Each block owns its instructions, including
+ * the Label that starts it.
+ *
+ * Building the graph also computes, for the blocks reachable from the
+ * entry, the reverse postorder, the dominator tree (Cooper, Harvey and
+ * Kennedy, "A Simple, Fast Dominance Algorithm"), the dominance frontiers
+ * and the natural loops.
+ */
+
+#ifndef _H_cfg
+#define _H_cfg
+
+#include "tac.h"
+#include <iostream>
+
+// x := phi(args...) at the start of a block, while the function is in SSA form
+struct Phi {
+    int dst;                    // register defined
+    int var;                    // register it is a version of
+    vector<Operand> args;       // one per predecessor, in the order of preds
+};
+
+struct BasicBlock {
+    int label;                  // label number, -1 if the block has none
+    vector<Phi> phis;
+    vector<TACObject> code;
+    vector<int> succs;          // for a conditional branch [taken, fall through]
+    vector<int> preds;
+
+    int rpo;                    // position in reverse postorder, -1 if unreachable
+    int idom;                   // immediate dominator, -1 for the entry and unreachable blocks
+    vector<int> domChildren;
+    vector<int> frontier;       // dominance frontier
+    int loop;                   // innermost loop containing the block, -1 if none
+
+    BasicBlock() : label(-1), rpo(-1), idom(-1), loop(-1) {}
+};
+
+struct Loop {
+    int header;
+    vector<int> blocks;         // header included, in increasing order
+    vector<int> latches;        // sources of the back edges
+    int parent;                 // innermost enclosing loop, -1 if outermost
+    int depth;                  // 1 for an outermost loop
+};
+
+class CFG {
+  public:
+    TACFunction &fn;
+    vector<BasicBlock> blocks;  // [0] is the entry, the rest in source order
+    vector<int> order;          // reachable blocks in reverse postorder
+    vector<Loop> loops;         // outer loops before the loops they contain
+    vector<int> layout;         // blocks written back by Linearize, reachable ones in source order
+
+    explicit CFG(TACFunction &fn);
+
+    // Appends an empty block starting with a fresh label; it is not
+    // connected and not part of the layout
+    int NewBlock();
+
+    // Replaces the function's code by the blocks in layout order
+    void Linearize();
+
+    bool Dominates(int a, int b) const;
+    bool IsReachable(int b) const { return blocks[b].rpo >= 0; }
+
+    // Dump used by -d cfg
+    void Print(ostream &out) const;
+
+  private:
+    unordered_map<int, int> labelBlock;     // label number -> block
+    vector<int> preorder, postorder;        // dominator tree numbering
+
+    void SplitBlocks();
+    void ConnectBlocks();
+    void ComputeOrder();
+    void ComputeDominators();
+    void ComputeFrontiers();
+    void FindLoops();
+};
+
+#endif
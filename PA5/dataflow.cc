@@ -0,0 +1,427 @@
+/**
+ * File: dataflow.cc
+ * -----------------
+ * The dataflow solver, liveness, reaching definitions and dead code
+ * elimination.
+ */
+
+#include "dataflow.h"
+#include "utility.h"
+#include <queue>
+#include <functional>
+#include <unordered_set>
+
+void BitSet::SetAll() {
+    for (uint64_t &w : words) w = ~(uint64_t)0;
+    if (size & 63)
+        words.back() = ((uint64_t)1 << (size & 63)) - 1;
+}
+
+int BitSet::Next(int i) const {
+    if (i >= size)
+        return size;
+    int w = i >> 6;
+    uint64_t bits = words[w] & (~(uint64_t)0 << (i & 63));
+    while (bits == 0) {
+        if (++w == words.size())
+            return size;
+        bits = words[w];
+    }
+    return w * 64 + __builtin_ctzll(bits);
+}
+
+bool BitSet::Union(const BitSet &o) {
+    uint64_t changed = 0;
+    for (int i = 0; i < words.size(); i++) {
+        uint64_t w = words[i] | o.words[i];
+        changed |= w ^ words[i];
+        words[i] = w;
+    }
+    return changed != 0;
+}
+
+bool BitSet::Intersect(const BitSet &o) {
+    uint64_t changed = 0;
+    for (int i = 0; i < words.size(); i++) {
+        uint64_t w = words[i] & o.words[i];
+        changed |= w ^ words[i];
+        words[i] = w;
+    }
+    return changed != 0;
+}
+
+void BitSet::Subtract(const BitSet &o) {
+    for (int i = 0; i < words.size(); i++)
+        words[i] &= ~o.words[i];
+}
+
+DataflowProblem::DataflowProblem(const CFG &cfg, flowdirection direction, meetoperator meet, int size) :
+direction(direction),
+meet(meet),
+size(size),
+gen(cfg.blocks.size(), BitSet(size)),
+kill(cfg.blocks.size(), BitSet(size)),
+boundary(size) {
+}
+
+void DataflowProblem::Solve(const CFG &cfg) {
+    int numBlocks = cfg.blocks.size();
+    bool forward = direction == df_Forward;
+
+    BitSet top(size);
+    if (meet == meet_Intersection)
+        top.SetAll();
+
+    in.assign(numBlocks, forward ? BitSet(size) : top);
+    out.assign(numBlocks, forward ? top : BitSet(size));
+
+    // rank of a block in visiting order: reverse postorder going forward,
+    // postorder going backward
+    const vector<int> &order = cfg.order;
+    auto rank = [&](int b) { return forward ? cfg.blocks[b].rpo : order.size() - 1 - cfg.blocks[b].rpo; };
+    auto block = [&](int r) { return forward ? order[r] : order[order.size() - 1 - r]; };
+
+    // The worklist is visited in passes over the order. A block whose input
+    // changes is visited again in the same pass when it comes later, in the
+    // next pass when it comes earlier (through a back edge): a loop whose
+    // body changes its header waits for the next pass instead of sending
+    // the change through the code after it each time, so the number of
+    // passes follows the loop nesting rather than the number of loops.
+    priority_queue<int, vector<int>, greater<int>> work, next;
+    vector<bool> queued(numBlocks, false);
+    for (int r = 0; r < order.size(); r++) {
+        work.push(r);
+        queued[block(r)] = true;
+    }
+
+    while (!work.empty() || !next.empty()) {
+        if (work.empty())
+            swap(work, next);
+        int current = work.top();
+        int b = block(current);
+        work.pop();
+        queued[b] = false;
+
+        const vector<int> &sources = forward ? cfg.blocks[b].preds : cfg.blocks[b].succs;
+        const vector<int> &targets = forward ? cfg.blocks[b].succs : cfg.blocks[b].preds;
+        vector<BitSet> &before = forward ? in : out;    // the side the meet computes
+        vector<BitSet> &after = forward ? out : in;
+
+        BitSet joined = top;
+        bool atBoundary = forward ? b == 0 : sources.empty();
+        if (atBoundary)
+            joined = boundary;
+        for (int s : sources) {
+            if (!cfg.IsReachable(s))
+                continue;
+            if (meet == meet_Union)
+                joined.Union(after[s]);
+            else
+                joined.Intersect(after[s]);
+        }
+        if (meet == meet_Intersection && sources.empty() && !atBoundary)
+            joined = BitSet(size);
+        before[b] = joined;
+
+        BitSet result = before[b];
+        result.Subtract(kill[b]);
+        result.Union(gen[b]);
+        if (result == after[b])
+            continue;
+        after[b] = result;
+
+        for (int t : targets) {
+            if (cfg.IsReachable(t) && !queued[t]) {
+                queued[t] = true;
+                (rank(t) > current ? work : next).push(rank(t));
+            }
+        }
+    }
+}
+
+Liveness::Liveness(const CFG &cfg) : index(cfg.fn.regs.size(), -1), globals(cfg.fn.regs.size()) {
+    const TACFunction &fn = cfg.fn;
+    for (int r = 0; r < fn.regs.size(); r++)
+        if (!fn.IsLocal(r))
+            globals.Set(r);
+
+    // the registers read before they are written in some block
+    vector<int> writtenIn(fn.regs.size(), -1);
+    vector<bool> kept(fn.regs.size(), false);
+    for (int b : cfg.order) {
+        for (const TACObject &taco : cfg.blocks[b].code) {
+            for (const Operand *o : { &taco.a, &taco.b })
+                if (o->IsReg() && writtenIn[o->value] != b)
+                    kept[o->value] = true;
+            int d = DefinedReg(taco);
+            if (d >= 0)
+                writtenIn[d] = b;
+        }
+    }
+    for (int r = 0; r < fn.regs.size(); r++) {
+        if (kept[r] || globals.Test(r)) {
+            index[r] = regs.size();
+            regs.push_back(r);
+        }
+    }
+
+    DataflowProblem p(cfg, df_Backward, meet_Union, regs.size());
+    for (int r : regs)
+        if (globals.Test(r))
+            p.boundary.Set(index[r]);
+
+    for (int b : cfg.order) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        for (int i = code.size() - 1; i >= 0; i--) {
+            const TACObject &taco = code[i];
+            int d = DefinedReg(taco);
+            if (d >= 0 && index[d] >= 0) {
+                p.kill[b].Set(index[d]);
+                p.gen[b].Reset(index[d]);
+            }
+            for (const Operand *o : { &taco.a, &taco.b })
+                if (o->IsReg() && index[o->value] >= 0)
+                    p.gen[b].Set(index[o->value]);
+            if (taco.op == op_Call)
+                p.gen[b].Union(p.boundary);
+        }
+    }
+
+    p.Solve(cfg);
+    in.swap(p.in);
+    out.swap(p.out);
+}
+
+void ReachingDefinitions::Print(const CFG &cfg, ostream &out) const {
+    const TACFunction &fn = cfg.fn;
+    out << "Reaching definitions " << (fn.name >= 0 ? SymbolName(fn.name) : "<top level>") << endl;
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+        if (!cfg.IsReachable(b))
+            continue;
+        out << "  B" << b << ":";
+        for (int id = in[b].Next(0); id < in[b].Size(); id = in[b].Next(id + 1)) {
+            int block = defs[id].first, i = defs[id].second;
+            Operand reg = Operand::Reg(DefinedReg(cfg.blocks[block].code[i]));
+            out << " " << OperandString(fn, reg) << "@B" << block << ":" << i;
+        }
+        out << endl;
+    }
+}
+
+BitSet Liveness::LiveOut(int b) const {
+    BitSet live(index.size());
+    for (int k = out[b].Next(0); k < out[b].Size(); k = out[b].Next(k + 1))
+        live.Set(regs[k]);
+    return live;
+}
+
+void Liveness::Transfer(const TACObject &taco, BitSet &live) const {
+    int d = DefinedReg(taco);
+    if (d >= 0)
+        live.Reset(d);
+    if (taco.a.IsReg())
+        live.Set(taco.a.value);
+    if (taco.b.IsReg())
+        live.Set(taco.b.value);
+    if (taco.op == op_Call)
+        live.Union(globals);
+}
+
+ReachingDefinitions::ReachingDefinitions(const CFG &cfg) : defsOf(cfg.fn.regs.size()) {
+    const vector<BasicBlock> &blocks = cfg.blocks;
+    vector<int> first(cfg.fn.regs.size() + 1, 0);
+    for (const BasicBlock &block : blocks) {
+        for (const TACObject &taco : block.code) {
+            int d = DefinedReg(taco);
+            if (d >= 0)
+                first[d + 1]++;
+        }
+    }
+    for (int r = 0; r < cfg.fn.regs.size(); r++)
+        first[r + 1] += first[r];
+
+    defs.resize(first.back());
+    for (int b = 0; b < blocks.size(); b++) {
+        for (int i = 0; i < blocks[b].code.size(); i++) {
+            int d = DefinedReg(blocks[b].code[i]);
+            if (d < 0)
+                continue;
+            int id = first[d] + defsOf[d].size();
+            defsOf[d].push_back(id);
+            defs[id] = make_pair(b, i);
+        }
+    }
+
+    // A block defining a register kills every definition of it and
+    // generates its last one. The definitions of a register defined in
+    // more than one block are gathered in one set, built once and added to
+    // the kill set of each of those blocks.
+    DataflowProblem p(cfg, df_Forward, meet_Union, defs.size());
+    for (int reg = 0; reg < defsOf.size(); reg++) {
+        const vector<int> &ids = defsOf[reg];
+        if (ids.empty())
+            continue;
+        bool oneBlock = defs[ids.front()].first == defs[ids.back()].first;
+        BitSet all(oneBlock ? 0 : defs.size());
+        if (!oneBlock)
+            for (int id : ids)
+                all.Set(id);
+
+        for (int k = 0; k < ids.size(); k++) {
+            int b = defs[ids[k]].first;
+            bool last = k + 1 == ids.size() || defs[ids[k + 1]].first != b;
+            if (!last)
+                continue;
+            p.gen[b].Set(ids[k]);
+            if (oneBlock) {
+                for (int id : ids)
+                    p.kill[b].Set(id);
+            } else {
+                p.kill[b].Union(all);
+            }
+        }
+    }
+
+    p.Solve(cfg);
+    in.swap(p.in);
+    out.swap(p.out);
+}
+
+/**
+ * Mark and sweep. The instructions that are not pure computations (calls,
+ * prints, branches, returns, parameter passing, ...) are useful, so are
+ * the globals when the function exits, and so is every definition an
+ * operand of a useful instruction may read; what is left unmarked is
+ * dropped and each block is compacted once. A computation read only by
+ * dead code, a counter nothing else reads included, goes in the same pass.
+ *
+ * An operand reads the last definition of its register before it in the
+ * block when there is one; otherwise the register is wanted where the
+ * block starts and so at the end of each predecessor, which is resolved
+ * the same way. A block takes each register at its start at most once, so
+ * the work is linear in the size of the function plus the registers wanted
+ * across blocks.
+ */
+void deadCodeElimination(TACFunction &fn) {
+    CFG cfg(fn);
+    int deadCode = 0, deadStores = 0;
+    int numBlocks = cfg.blocks.size();
+
+    vector<int> globals;
+    for (int r = 0; r < fn.regs.size(); r++)
+        if (!fn.IsLocal(r))
+            globals.push_back(r);
+
+    // per instruction, the instruction of the block its operands a and b
+    // read, -1 for a register coming from the start of the block (or no
+    // register); per call, the same for each global, in the order of globals
+    vector<vector<pair<int,int>>> reads(numBlocks);
+    vector<unordered_map<int, vector<int>>> callReads(numBlocks);
+    vector<unordered_map<int, int>> lastDef(numBlocks);     // register -> last instruction defining it
+    for (int b : cfg.order) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        unordered_map<int, int> &last = lastDef[b];
+        auto defOf = [&](const Operand &o) {
+            if (!o.IsReg())
+                return -1;
+            auto it = last.find(o.value);
+            return it == last.end() ? -1 : it->second;
+        };
+        reads[b].resize(code.size());
+        for (int i = 0; i < code.size(); i++) {
+            const TACObject &taco = code[i];
+            reads[b][i] = make_pair(defOf(taco.a), defOf(taco.b));
+            if (taco.op == op_Call) {
+                vector<int> &g = callReads[b][i];
+                for (int r : globals) {
+                    auto it = last.find(r);
+                    g.push_back(it == last.end() ? -1 : it->second);
+                }
+            }
+            int d = DefinedReg(taco);
+            if (d >= 0)
+                last[d] = i;
+        }
+    }
+
+    vector<vector<bool>> useful(numBlocks);
+    vector<unordered_set<int>> wanted(numBlocks);           // registers wanted where the block starts
+    vector<pair<int,int>> work;                             // (block, instruction) marked, operands not followed
+    vector<pair<int,int>> wantedAtEnd;                      // (block, register)
+
+    auto mark = [&](int b, int i) {
+        if (!useful[b][i]) {
+            useful[b][i] = true;
+            work.emplace_back(b, i);
+        }
+    };
+    auto read = [&](int b, int def, int r) {
+        if (def >= 0) {
+            mark(b, def);
+        } else if (wanted[b].insert(r).second) {
+            for (int p : cfg.blocks[b].preds)
+                if (cfg.IsReachable(p))
+                    wantedAtEnd.emplace_back(p, r);
+        }
+    };
+    auto readAtEnd = [&](int b, int r) {
+        auto it = lastDef[b].find(r);
+        read(b, it == lastDef[b].end() ? -1 : it->second, r);
+    };
+
+    for (int b : cfg.order) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        useful[b].assign(code.size(), false);
+    }
+    for (int b : cfg.order) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        for (int i = 0; i < code.size(); i++) {
+            tacop op = code[i].op;
+            if (!(op == op_Copy || op == op_Neg || IsBinary(op)))
+                mark(b, i);
+        }
+        if (cfg.blocks[b].succs.empty())
+            for (int r : globals)
+                readAtEnd(b, r);
+    }
+
+    while (!work.empty() || !wantedAtEnd.empty()) {
+        if (!wantedAtEnd.empty()) {
+            pair<int,int> w = wantedAtEnd.back();
+            wantedAtEnd.pop_back();
+            readAtEnd(w.first, w.second);
+            continue;
+        }
+        int b = work.back().first, i = work.back().second;
+        work.pop_back();
+        const TACObject &taco = cfg.blocks[b].code[i];
+        if (taco.a.IsReg())
+            read(b, reads[b][i].first, taco.a.value);
+        if (taco.b.IsReg())
+            read(b, reads[b][i].second, taco.b.value);
+        if (taco.op == op_Call) {
+            const vector<int> &g = callReads[b][i];
+            for (int k = 0; k < globals.size(); k++)
+                read(b, g[k], globals[k]);
+        }
+    }
+
+    for (int b : cfg.layout) {
+        vector<TACObject> &code = cfg.blocks[b].code;
+        int kept = 0;
+        for (int i = 0; i < code.size(); i++) {
+            if (useful[b][i]) {
+                code[kept++] = code[i];
+            } else if (fn.regs[DefinedReg(code[i])].name < 0) {
+                deadCode++;
+            } else {
+                deadStores++;
+            }
+        }
+        code.erase(code.begin() + kept, code.end());
+    }
+
+    cfg.Linearize();
+    PrintDebug("dce", "%s: %d dead computations, %d dead stores removed",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", deadCode, deadStores);
+}
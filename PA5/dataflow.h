@@ -0,0 +1,130 @@
+/**
+ * File: dataflow.h
+ * ----------------
+ * Iterative dataflow analysis over the basic blocks of a CFG. Facts are
+ * dense bit sets (one bit per register, definition, ...); a problem is
+ * given by its direction, its meet operator and a gen and kill set per
+ * block, and is solved with a worklist visited in passes over the reverse
+ * postorder (the postorder for backward problems) so that most blocks are
+ * final after one visit.
+ *
+ * Liveness and reaching definitions are built on it. Dead code elimination
+ * lives here too, though it marks and sweeps instead of solving a problem.
+ */
+
+#ifndef _H_dataflow
+#define _H_dataflow
+
+#include "cfg.h"
+#include <stdint.h>
+
+class BitSet {
+  public:
+    BitSet(int size = 0) : size(size), words((size + 63) / 64, 0) {}
+
+    int Size() const { return size; }
+    bool Test(int i) const { return words[i >> 6] >> (i & 63) & 1; }
+    void Set(int i) { words[i >> 6] |= (uint64_t)1 << (i & 63); }
+    void Reset(int i) { words[i >> 6] &= ~((uint64_t)1 << (i & 63)); }
+    void SetAll();
+
+    // The first member from i on, Size() if there is none: the members
+    // are visited with for (r = s.Next(0); r < s.Size(); r = s.Next(r + 1))
+    int Next(int i) const;
+
+    // Each returns true when the set changed
+    bool Union(const BitSet &o);
+    bool Intersect(const BitSet &o);
+    void Subtract(const BitSet &o);
+
+    bool operator==(const BitSet &o) const { return words == o.words; }
+    bool operator!=(const BitSet &o) const { return words != o.words; }
+
+  private:
+    int size;
+    vector<uint64_t> words;
+};
+
+enum flowdirection { df_Forward, df_Backward };
+enum meetoperator { meet_Union, meet_Intersection };
+
+struct DataflowProblem {
+    flowdirection direction;
+    meetoperator meet;
+    int size;                   // bits per set
+    vector<BitSet> gen, kill;   // per block
+    BitSet boundary;            // in of the entry (forward) or out of the exits (backward)
+
+    // Solution, per block
+    vector<BitSet> in, out;
+
+    DataflowProblem(const CFG &cfg, flowdirection direction, meetoperator meet, int size);
+    void Solve(const CFG &cfg);
+};
+
+/**
+ * Registers live at the start and end of each block. Global variables are
+ * live when the function exits and at every call, the callee may read them.
+ *
+ * Only a register read in some block before it is written there (or a
+ * global) can be live where a block starts or ends; the others, most of
+ * them temporaries, are left out, and in and out are sets of the indices
+ * of the registers kept, so they don't grow with the registers of the
+ * whole function.
+ */
+class Liveness {
+  public:
+    vector<int> regs;           // index -> register
+    vector<int> index;          // register -> index, -1 if never live across blocks
+    vector<BitSet> in, out;     // of indices
+
+    Liveness(const CFG &cfg);
+
+    bool LiveIn(int b, int r) const { return index[r] >= 0 && in[b].Test(index[r]); }
+    bool LiveOut(int b, int r) const { return index[r] >= 0 && out[b].Test(index[r]); }
+
+    // The registers live at the end of the block, a set of registers to
+    // walk it backward with Transfer
+    BitSet LiveOut(int b) const;
+
+    // Steps the live set backward over one instruction
+    void Transfer(const TACObject &taco, BitSet &live) const;
+
+  private:
+    BitSet globals;
+};
+
+/**
+ * Definitions reaching the start and end of each block. Definitions are
+ * numbered register by register, in block order for each register, so the
+ * definitions of a register are a range of numbers: those reaching a block
+ * are visited with in[b].Next from the first of them to the last. defs[i]
+ * is the (block, instruction) of the i-th.
+ *
+ * No pass reads them at the moment: invariance in loops is decided by
+ * dominance, which is cheaper. They are kept for passes that need the
+ * definitions reaching a read, and printed with -d reaching.
+ */
+class ReachingDefinitions {
+  public:
+    vector<pair<int,int>> defs;
+    vector<vector<int>> defsOf;     // register -> its definitions, in increasing order
+    vector<BitSet> in, out;
+
+    ReachingDefinitions(const CFG &cfg);
+
+    // Dump used by -d reaching: the definitions reaching the start of each
+    // block, as register@Bblock:instruction
+    void Print(const CFG &cfg, ostream &out) const;
+};
+
+/**
+ * Removes computations whose result is never read and stores to variables
+ * that are overwritten (or never read) before being read, along with the
+ * computations only they read. Unreachable blocks go as well.
+ *
+ * @param fn : the function to optimize
+ */
+void deadCodeElimination(TACFunction &fn);
+
+#endif
@@ -0,0 +1,348 @@
+/**
+ * File: inline.cc
+ * ---------------
+ * The inliner and tail recursion.
+ */
+
+#include "inline.h"
+#include "ast.h"            // for Node::NewTemp
+#include "utility.h"
+#include <algorithm>
+
+static const int DefaultInlineLimit = 30;
+
+// A call and the instructions around it that only exist for it
+struct CallSite {
+    int save;                   // SaveRegisters, -1 for a call without arguments
+    vector<int> pushes;         // PushParam of each argument, in order
+    int call;
+};
+
+// Instructions of the body, leaving out the parameter loads, labels and
+// the BeginFunc and EndFunc around it
+static int bodySize(const TACFunction &fn) {
+    int size = 0;
+    for (const TACObject &taco : fn.code)
+        if (taco.op != op_LoadParam && taco.op != op_BeginFunc && taco.op != op_EndFunc && taco.op != op_Label)
+            size++;
+    return size;
+}
+
+/**
+ * Finds the call sequence of the call at the given index: the PushParams
+ * of its arguments before it (with only argument computations between
+ * them), the SaveRegisters before the first one, and the PopParam and
+ * RestoreRegisters right after it. Returns false if the code around the
+ * call doesn't have that shape.
+ */
+static bool findCallSite(const vector<TACObject> &code, int call, CallSite &site) {
+    int args = code[call].b.value;
+    site.call = call;
+    site.save = -1;
+    site.pushes.assign(args, -1);
+
+    int i = call - 1;
+    for (int k = args - 1; k >= 0; i--) {
+        if (i < 0)
+            return false;
+        tacop op = code[i].op;
+        if (op == op_PushParam)
+            site.pushes[k--] = i;
+        else if (op == op_Call || op == op_PopParam || op == op_SaveRegisters ||
+                 op == op_RestoreRegisters || op == op_Label || IsBranch(op) || op == op_Return)
+            return false;
+    }
+    if (args > 0) {
+        if (i < 0 || code[i].op != op_SaveRegisters)
+            return false;
+        site.save = i;
+    }
+
+    return call + 2 < code.size() && code[call + 1].op == op_PopParam &&
+           code[call + 2].op == op_RestoreRegisters;
+}
+
+/**
+ * Appends the callee's body to the code, for a call whose arguments were
+ * copied to the given temps.
+ */
+static void expandBody(TACFunction &caller, const TACFunction &callee, const vector<Operand> &params,
+                       Operand result, vector<TACObject> &code) {
+    vector<Operand> renamed(callee.regs.size());
+    vector<int> defs(callee.regs.size(), 0);
+    vector<bool> used(callee.regs.size(), false);
+    for (const TACObject &taco : callee.code) {
+        int d = DefinedReg(taco);
+        if (d >= 0)
+            defs[d]++;
+        for (const Operand *o : { &taco.dst, &taco.a, &taco.b })
+            if (o->IsReg())
+                used[o->value] = true;
+    }
+
+    // a parameter the body assigns can't stay a temp, it is copied to a
+    // variable of the caller first
+    for (const TACObject &taco : callee.code) {
+        if (taco.op != op_LoadParam)
+            continue;
+        int r = taco.dst.value;
+        renamed[r] = params[taco.a.value];
+        if (defs[r] > 1) {
+            renamed[r] = Operand::Reg(caller.NewVariable(callee.regs[r].name));
+            code.emplace_back(op_Copy, renamed[r], params[taco.a.value]);
+        }
+    }
+
+    for (int r = 0; r < callee.regs.size(); r++) {
+        if (renamed[r].IsReg() || !used[r])
+            continue;
+        if (!callee.IsLocal(r)) {
+            renamed[r] = Operand::Reg(caller.Variable(callee.regs[r].name));
+        } else if (callee.regs[r].name < 0) {
+            renamed[r] = Node::NewTemp(caller);
+        } else {
+            // a variable starts out as 0 on each call, like it would in a
+            // fresh frame; the copy is dead whenever it's assigned first
+            renamed[r] = Operand::Reg(caller.NewVariable(callee.regs[r].name));
+            code.emplace_back(op_Copy, renamed[r], Operand::Imm(0));
+        }
+    }
+
+    unordered_map<int, int> labels;
+    auto rename = [&](Operand o) {
+        if (o.IsReg())
+            return renamed[o.value];
+        if (o.kind == opnd_Label) {
+            if (labels.find(o.value) == labels.end())
+                labels[o.value] = NewLabelNumber();
+            return Operand::Label(labels[o.value]);
+        }
+        return o;
+    };
+
+    Operand end = Operand::Label(NewLabelNumber());
+    bool jumpsToEnd = false;
+    for (int i = 0; i < callee.code.size(); i++) {
+        const TACObject &taco = callee.code[i];
+        if (taco.op == op_LoadParam || taco.op == op_BeginFunc || taco.op == op_EndFunc)
+            continue;
+
+        if (taco.op == op_Return) {
+            if (!taco.a.IsNone() && result.IsReg())
+                code.emplace_back(op_Copy, result, rename(taco.a));
+            if (i + 1 < callee.code.size() && callee.code[i + 1].op != op_EndFunc) {
+                code.emplace_back(op_Goto, end);
+                jumpsToEnd = true;
+            }
+            continue;
+        }
+
+        code.emplace_back(taco.op, rename(taco.dst), rename(taco.a), rename(taco.b));
+    }
+    if (jumpsToEnd)
+        code.emplace_back(op_Label, end);
+}
+
+// The functions kept to be inlined, and the calls seen to each function
+// and how many of them were inlined, by symbol
+static unordered_map<int, TACFunction> candidates;
+static vector<int> callsTo, inlinedCalls;
+
+static int &countOf(vector<int> &counts, int sym) {
+    if (sym >= counts.size())
+        counts.resize(sym + 1, 0);
+    return counts[sym];
+}
+
+// Returns true if the function calls the given one
+static bool calls(const TACFunction &fn, int callee) {
+    for (const TACObject &taco : fn.code)
+        if (taco.op == op_Call && taco.a.value == callee)
+            return true;
+    return false;
+}
+
+void inlineCalls(TACFunction &caller) {
+    int limit = GetOption("inline-limit", DefaultInlineLimit);
+    const vector<TACObject> &code = caller.code;
+
+    vector<int> action(code.size(), -1);    // instruction -> call site it belongs to
+    vector<CallSite> sites;
+    for (int i = 0; i < code.size(); i++) {
+        if (code[i].op != op_Call)
+            continue;
+        countOf(callsTo, code[i].a.value)++;
+        auto found = candidates.find(code[i].a.value);
+        if (found == candidates.end())
+            continue;
+        const TACFunction &callee = found->second;
+        CallSite site;
+        if (callee.name == caller.name || calls(callee, caller.name) || !findCallSite(code, i, site))
+            continue;
+
+        // a global the callee uses must not be a local of the caller
+        bool clash = false;
+        for (int r = 0; r < callee.regs.size(); r++) {
+            if (callee.IsLocal(r))
+                continue;
+            auto it = caller.vars.find(callee.regs[r].name);
+            clash |= it != caller.vars.end() && caller.IsLocal(it->second);
+        }
+
+        int args = site.pushes.size(), constants = 0;
+        for (int p : site.pushes)
+            constants += code[p].a.IsImm();
+        int saved = 4 + 2 * args + 2 * constants;
+        if (clash || bodySize(callee) > limit + saved)
+            continue;
+
+        int s = sites.size();
+        if (site.save >= 0)
+            action[site.save] = s;
+        for (int p : site.pushes)
+            action[p] = s;
+        action[i] = action[i + 1] = action[i + 2] = s;
+        sites.push_back(site);
+    }
+
+    if (!sites.empty()) {
+        vector<TACObject> rewritten;
+        vector<vector<Operand>> params(sites.size());
+        int frame = 0;
+        for (int i = 0; i < code.size(); i++) {
+            int s = action[i];
+            if (s < 0) {
+                rewritten.push_back(code[i]);
+            } else if (code[i].op == op_PushParam) {
+                params[s].push_back(Node::NewTemp(caller));
+                rewritten.emplace_back(op_Copy, params[s].back(), code[i].a);
+            } else if (code[i].op == op_Call) {
+                const TACFunction &callee = candidates.at(code[i].a.value);
+                expandBody(caller, callee, params[s], code[i].dst, rewritten);
+                countOf(inlinedCalls, callee.name)++;
+                for (const TACObject &taco : callee.code)
+                    if (taco.op == op_BeginFunc)
+                        frame += taco.a.value;
+                PrintDebug("inline", "%s: inlined %s, %d instructions",
+                           caller.name >= 0 ? SymbolName(caller.name).c_str() : "<top level>",
+                           SymbolName(callee.name).c_str(), bodySize(callee));
+            }
+        }
+
+        // the callee's locals are the caller's now
+        for (TACObject &taco : rewritten)
+            if (taco.op == op_BeginFunc)
+                taco.a = Operand::Imm(taco.a.value + frame);
+        caller.code.swap(rewritten);
+    }
+
+    // kept for the functions after it if a call with constant arguments
+    // could take it
+    int params = 0;
+    for (const TACObject &taco : caller.code)
+        params += taco.op == op_LoadParam;
+    if (caller.name >= 0 && !calls(caller, caller.name) && bodySize(caller) <= limit + 4 + 4 * params) {
+        candidates.erase(caller.name);
+        candidates.emplace(caller.name, caller);
+    }
+}
+
+bool isInlineCandidate(int name) {
+    return candidates.find(name) != candidates.end();
+}
+
+void forgetInlineCandidate(int name) {
+    candidates.erase(name);
+}
+
+bool allCallsInlined(int name) {
+    return countOf(callsTo, name) > 0 && countOf(inlinedCalls, name) == countOf(callsTo, name);
+}
+
+bool isTailCall(const vector<TACObject> &code, int call) {
+    int i = call + 3;
+    while (i < code.size() && code[i].op == op_Label)
+        i++;
+    if (i == code.size())
+        return false;
+    if (code[i].op == op_EndFunc)
+        return true;
+    return code[i].op == op_Return && (code[i].a.IsNone() || code[i].a == code[call].dst);
+}
+
+void eliminateTailRecursion(TACFunction &fn) {
+    const vector<TACObject> &code = fn.code;
+    if (fn.name < 0)
+        return;
+
+    vector<int> params;         // parameter index -> register
+    for (const TACObject &taco : code) {
+        if (taco.op != op_LoadParam)
+            continue;
+        if (taco.a.value >= params.size())
+            params.resize(taco.a.value + 1, -1);
+        params[taco.a.value] = taco.dst.value;
+    }
+
+    vector<int> action(code.size(), -1);        // instruction -> call site it belongs to
+    vector<CallSite> sites;
+    for (int i = 0; i < code.size(); i++) {
+        CallSite site;
+        if (code[i].op != op_Call || code[i].a.value != fn.name || code[i].b.value != params.size() ||
+            !findCallSite(code, i, site) || !isTailCall(code, i))
+            continue;
+
+        int s = sites.size();
+        if (site.save >= 0)
+            action[site.save] = s;
+        for (int p : site.pushes)
+            action[p] = s;
+        action[i] = action[i + 1] = action[i + 2] = s;
+        if (code[i + 3].op == op_Return)
+            action[i + 3] = s;
+        sites.push_back(site);
+    }
+    if (sites.empty())
+        return;
+
+    vector<int> reset;          // the variables a fresh frame starts with at 0
+    vector<bool> param(fn.regs.size(), false);
+    for (int r : params)
+        if (r >= 0)
+            param[r] = true;
+    for (int r = 0; r < fn.regs.size(); r++)
+        if (fn.regs[r].name >= 0 && fn.regs[r].local && !param[r])
+            reset.push_back(r);
+
+    Operand entry = Operand::Label(NewLabelNumber());
+    vector<TACObject> rewritten;
+    vector<vector<Operand>> args(sites.size());
+    for (int i = 0; i < code.size(); i++) {
+        int s = action[i];
+        if (s < 0) {
+            rewritten.push_back(code[i]);
+            if (code[i].op == op_BeginFunc)
+                rewritten.emplace_back(op_Label, entry);
+        } else if (code[i].op == op_PushParam) {
+            // the arguments may read the parameters, so they are all
+            // evaluated before any parameter is assigned; a parameter
+            // passed on as itself is left alone
+            int k = args[s].size();
+            if (code[i].a == Operand::Reg(params[k])) {
+                args[s].push_back(code[i].a);
+                continue;
+            }
+            args[s].push_back(Node::NewTemp(fn));
+            rewritten.emplace_back(op_Copy, args[s].back(), code[i].a);
+        } else if (code[i].op == op_Call) {
+            for (int k = 0; k < params.size(); k++)
+                if (params[k] >= 0 && args[s][k] != Operand::Reg(params[k]))
+                    rewritten.emplace_back(op_Copy, Operand::Reg(params[k]), args[s][k]);
+            for (int r : reset)
+                rewritten.emplace_back(op_Copy, Operand::Reg(r), Operand::Imm(0));
+            rewritten.emplace_back(op_Goto, entry);
+            PrintDebug("tailcall", "%s: tail recursion turned into a loop", SymbolName(fn.name).c_str());
+        }
+    }
+    fn.code.swap(rewritten);
+}
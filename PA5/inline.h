@@ -0,0 +1,65 @@
+/**
+ * File: inline.h
+ * --------------
+ * Inlining of calls to small functions compiled before the caller, and
+ * elimination of tail recursion.
+ *
+ * A call costs a SaveRegisters, a PushParam per argument, the call, a
+ * PopParam and a RestoreRegisters, and the callee loads its parameters
+ * back; for a small function that's more than its body. An inlined call
+ * becomes a copy of each argument to a fresh temp, which the callee's
+ * parameters are renamed to, followed by the callee's body with its own
+ * temps renamed to fresh temps, its variables (and the parameters it
+ * assigns) to fresh variables of the caller, and each return turned into
+ * a copy to the call's result and a jump past the body. Constant arguments
+ * then propagate into the body like any other constant.
+ */
+
+#ifndef _H_inline
+#define _H_inline
+
+#include "tac.h"
+
+/**
+ * Inlines the calls whose callee is small enough. Functions are compiled
+ * one at a time, so the callees are the functions compiled before: once a
+ * function has its own calls inlined, a copy of it is kept if it may be
+ * small enough to inline anywhere, until it is forgotten. A function
+ * calling itself, or calling the caller back, is never inlined. A call is
+ * inlined when the callee's body is at most the limit (-finline-limit=N,
+ * 30 by default) plus what inlining saves: the call sequence and
+ * parameter loads, and two more instructions per constant argument.
+ *
+ * @param fn : the function to optimize
+ */
+void inlineCalls(TACFunction &fn);
+
+// Returns true if a copy of the function is kept to be inlined
+bool isInlineCandidate(int name);
+
+// Drops the copy of the function, calls after this one are left as calls
+void forgetInlineCandidate(int name);
+
+// Returns true if the function was called and every call to it was inlined
+bool allCallsInlined(int name);
+
+/**
+ * Returns true if the call at the given index is in tail position: after
+ * its PopParam and RestoreRegisters it reaches a return of its result, or
+ * the end of the function, with only labels on the way.
+ */
+bool isTailCall(const vector<TACObject> &code, int call);
+
+/**
+ * Turns the calls of a function to itself in tail position, where the
+ * result of the call is returned right away, into a jump back to the start
+ * of the body after its parameters are assigned the arguments. Its local
+ * variables are set back to 0 first, like a fresh frame would have them.
+ * The recursion becomes a loop that runs in the function's one frame, and
+ * the function may then be small enough to be inlined.
+ *
+ * @param fn : the function to optimize
+ */
+void eliminateTailRecursion(TACFunction &fn);
+
+#endif
@@ -0,0 +1,271 @@
+/**
+ * File: layout.cc
+ * ---------------
+ * Jump threading and placement of the basic blocks along the likely path.
+ */
+
+#include "layout.h"
+#include "cfg.h"
+#include "utility.h"
+#include <algorithm>
+
+// How control leaves a block once jumps to jumps are threaded
+struct Exit {
+    tacop op;           // op_Goto, op_IfGoto, op_Label (falls through), op_Return or op_EndFunc
+    Operand cond;       // condition of op_IfGoto
+    int taken;          // target of op_Goto and op_IfGoto
+    int next;           // block control falls through to, -1 if none
+};
+
+// A block doing nothing but jumping or falling through to another one
+static int forwardsTo(const CFG &cfg, int b) {
+    const BasicBlock &block = cfg.blocks[b];
+    for (int i = 0; i + 1 < block.code.size(); i++)
+        if (block.code[i].op != op_Label)
+            return -1;
+    if (block.code.empty() || block.succs.size() != 1)
+        return -1;
+    tacop last = block.code.back().op;
+    return last == op_Label || last == op_Goto ? block.succs[0] : -1;
+}
+
+// The block a jump to b ends up in, following chains of forwarding blocks
+static int resolve(const CFG &cfg, int b) {
+    for (int steps = 0; steps < cfg.blocks.size(); steps++) {
+        int target = forwardsTo(cfg, b);
+        if (target < 0 || target == b)
+            break;
+        b = target;
+    }
+    return b;
+}
+
+static bool inLoop(const CFG &cfg, int b, int loop) {
+    for (int l = cfg.blocks[b].loop; l >= 0; l = cfg.loops[l].parent)
+        if (l == loop)
+            return true;
+    return false;
+}
+
+// Whether the block is a loop header, or leads only to one from outside
+static bool entersLoop(const CFG &cfg, int b) {
+    int loop = cfg.blocks[b].loop;
+    if (loop >= 0 && cfg.loops[loop].header == b)
+        return true;
+    if (cfg.blocks[b].succs.size() != 1)
+        return false;
+    int s = cfg.blocks[b].succs[0];
+    loop = cfg.blocks[s].loop;
+    return loop >= 0 && cfg.loops[loop].header == s && !inLoop(cfg, b, loop);
+}
+
+/**
+ * The successor of a conditional branch control most likely goes to: the
+ * way back to a loop header, else the way that stays in the innermost loop
+ * of the branch, else the way into a loop rather than around it (as from
+ * the guard of a rotated loop), else the branch taken.
+ */
+static int likely(const CFG &cfg, int b, int taken, int next) {
+    if (next < 0 || cfg.Dominates(taken, b))
+        return taken;
+    if (cfg.Dominates(next, b))
+        return next;
+    int loop = cfg.blocks[b].loop;
+    if (loop >= 0 && !inLoop(cfg, taken, loop) && inLoop(cfg, next, loop))
+        return next;
+    if (entersLoop(cfg, next) && !entersLoop(cfg, taken))
+        return next;
+    return taken;
+}
+
+// The comparison taken exactly when the given one isn't
+static tacop inverse(tacop op) {
+    switch (op) {
+        case op_Less:           return op_GreaterEqual;
+        case op_GreaterEqual:   return op_Less;
+        case op_Greater:        return op_LessEqual;
+        case op_LessEqual:      return op_Greater;
+        case op_Equal:          return op_NotEqual;
+        default:                return op_Equal;
+    }
+}
+
+/**
+ * The comparison defining the condition, if it can be inverted by changing
+ * its operator: the last instruction of the block (its branch taken off),
+ * whose temp is read by the branch only. The code generator turns such a
+ * comparison and its branch into a single compare and branch, which costs
+ * the same either way.
+ */
+static TACObject *invertible(TACFunction &fn, BasicBlock &block, const Operand &cond) {
+    if (!cond.IsReg() || fn.regs[cond.value].name >= 0 || block.code.empty())
+        return NULL;
+    TACObject &compare = block.code.back();
+    if (DefinedReg(compare) != cond.value || compare.op < op_Less || compare.op > op_NotEqual)
+        return NULL;
+    int reads = 0;
+    for (const TACObject &taco : fn.code)
+        for (const Operand *o : { &taco.a, &taco.b })
+            if (*o == cond)
+                reads++;
+    return reads == 1 ? &compare : NULL;
+}
+
+static Operand labelOf(CFG &cfg, int b) {
+    BasicBlock &block = cfg.blocks[b];
+    if (block.label < 0) {
+        block.label = NewLabelNumber();
+        block.code.insert(block.code.begin(), TACObject(op_Label, Operand::Label(block.label)));
+    }
+    return Operand::Label(block.label);
+}
+
+// Whether the jump from b goes into a loop, to a header deciding whether
+// to run the body or to leave
+static bool entersAtTest(const CFG &cfg, const vector<Exit> &exits, int b, int header) {
+    int loop = cfg.blocks[header].loop;
+    if (loop < 0 || cfg.loops[loop].header != header || exits[header].op != op_IfGoto || inLoop(cfg, b, loop))
+        return false;
+    return !inLoop(cfg, exits[header].taken, loop) || !inLoop(cfg, exits[header].next, loop);
+}
+
+static int countJumps(const vector<TACObject> &code) {
+    return count_if(code.begin(), code.end(), [](const TACObject &taco) { return IsBranch(taco.op); });
+}
+
+void blockLayout(TACFunction &fn) {
+    int jumps = countJumps(fn.code);
+    CFG cfg(fn);
+    int n = cfg.blocks.size();
+
+    // thread every jump and fall through past the forwarding blocks, and
+    // turn branches on constants into jumps
+    vector<Exit> exits(n);
+    int exitBlock = -1, threaded = 0;
+    for (int b = 0; b < n; b++) {
+        const BasicBlock &block = cfg.blocks[b];
+        Exit &e = exits[b];
+        e.op = block.code.empty() ? op_Label : block.code.back().op;
+        e.taken = e.next = -1;
+        if (e.op == op_EndFunc)
+            exitBlock = b;
+        if (IsBranch(e.op)) {
+            e.taken = resolve(cfg, block.succs[0]);
+            threaded += e.taken != block.succs[0];
+            e.cond = e.op == op_IfGoto ? block.code.back().a : Operand();
+        }
+        bool fallsThrough = e.op != op_Goto && e.op != op_Return && e.op != op_EndFunc;
+        if (fallsThrough && b + 1 < n)
+            e.next = resolve(cfg, b + 1);
+
+        if (e.op == op_IfGoto) {
+            if (e.cond.IsImm() && e.cond.value == 0) {
+                e.op = op_Label;
+                e.taken = -1;
+            } else if (e.cond.IsNone() || e.cond.IsImm() || e.taken == e.next) {
+                e.op = op_Goto;
+                e.next = -1;
+            }
+        } else if (fallsThrough) {
+            e.op = op_Label;
+        }
+    }
+
+    // the blocks still reached from the entry
+    vector<bool> reached(n, false);
+    vector<int> work = { 0 };
+    reached[0] = true;
+    while (!work.empty()) {
+        int b = work.back();
+        work.pop_back();
+        vector<int> succs = { exits[b].taken, exits[b].next };
+        if (exits[b].op == op_Return && exitBlock >= 0)
+            succs.push_back(exitBlock);
+        for (int s : succs) {
+            if (s >= 0 && !reached[s]) {
+                reached[s] = true;
+                work.push_back(s);
+            }
+        }
+    }
+
+    // chain each block to its likely successor; where it is already placed
+    // the chain goes on with the first block of the source order left. A
+    // jump into a loop at its test isn't chained: the test is at the bottom
+    // of the body and would be moved to the top of it.
+    vector<bool> placed(n, false);
+    vector<int> layout;
+    if (exitBlock >= 0)
+        placed[exitBlock] = true;
+    for (int b = 0, first = 0; b >= 0; ) {
+        placed[b] = true;
+        layout.push_back(b);
+
+        const Exit &e = exits[b];
+        int preferred = e.op == op_IfGoto ? likely(cfg, b, e.taken, e.next) : e.op == op_Goto ? e.taken : e.next;
+        if (e.op == op_IfGoto && preferred >= 0 && placed[preferred])
+            preferred = preferred == e.taken ? e.next : e.taken;
+        if (e.op == op_Goto && entersAtTest(cfg, exits, b, preferred))
+            preferred = -1;
+        if (preferred >= 0 && !placed[preferred]) {
+            b = preferred;
+            continue;
+        }
+        while (first < n && (placed[first] || !reached[first]))
+            first++;
+        b = first < n ? first : -1;
+    }
+    if (exitBlock > 0 && reached[exitBlock])
+        layout.push_back(exitBlock);
+
+    // give each block the jumps it needs to reach its successors from where
+    // it is now. A branch is inverted when it would jump to the next block,
+    // and when neither successor is next but the likely one is the one it
+    // falls through to, so that way is the single branch
+    int inverted = 0;
+    for (int i = 0; i < layout.size(); i++) {
+        BasicBlock &block = cfg.blocks[layout[i]];
+        const Exit &e = exits[layout[i]];
+        int next = i + 1 < layout.size() ? layout[i + 1] : -1;
+
+        if (!block.code.empty() && IsBranch(block.code.back().op))
+            block.code.pop_back();
+        if (e.op == op_IfGoto) {
+            bool invert = e.taken == next ||
+                          (e.next >= 0 && e.next != next && likely(cfg, layout[i], e.taken, e.next) == e.next);
+            TACObject *compare = invert ? invertible(fn, block, e.cond) : NULL;
+            if (compare != NULL) {
+                compare->op = inverse(compare->op);
+                block.code.emplace_back(op_IfGoto, labelOf(cfg, e.next), e.cond);
+                if (e.taken != next)
+                    block.code.emplace_back(op_Goto, labelOf(cfg, e.taken));
+                inverted++;
+            } else {
+                block.code.emplace_back(op_IfGoto, labelOf(cfg, e.taken), e.cond);
+                if (e.next >= 0 && e.next != next)
+                    block.code.emplace_back(op_Goto, labelOf(cfg, e.next));
+            }
+        } else if ((e.op == op_Goto && e.taken != next) || (e.op == op_Label && e.next >= 0 && e.next != next)) {
+            block.code.emplace_back(op_Goto, labelOf(cfg, e.op == op_Goto ? e.taken : e.next));
+        }
+    }
+
+    // labels no branch refers to anymore
+    vector<int> referenced;
+    for (int b : layout)
+        for (const TACObject &taco : cfg.blocks[b].code)
+            if (IsBranch(taco.op))
+                referenced.push_back(taco.dst.value);
+    sort(referenced.begin(), referenced.end());
+    for (int b : layout) {
+        vector<TACObject> &code = cfg.blocks[b].code;
+        if (!code.empty() && code[0].op == op_Label &&
+            !binary_search(referenced.begin(), referenced.end(), code[0].dst.value))
+            code.erase(code.begin());
+    }
+
+    cfg.layout = layout;
+    cfg.Linearize();
+    PrintDebug("layout", "%s: %d jumps threaded, %d jumps removed, %d branches inverted",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", threaded, jumps - countJumps(fn.code), inverted);
+}
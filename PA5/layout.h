@@ -0,0 +1,38 @@
+/**
+ * File: layout.h
+ * --------------
+ * Placement of the basic blocks of a function in the order control is
+ * most likely to flow through them.
+ *
+ * The code is emitted statement by statement, so an if is a conditional
+ * branch to its then part, a jump to its else part and a jump to the end
+ * of the statement, which is often the next label anyway. Laying the
+ * blocks out again lets most of these jumps go: a block is followed by
+ * its likely successor, which it then falls through to.
+ */
+
+#ifndef _H_layout
+#define _H_layout
+
+#include "tac.h"
+
+/**
+ * Lays the blocks of the function out again:
+ *
+ *  - jumps to a block that only jumps elsewhere go there directly
+ *  - blocks are chained from the entry, each followed by its likely
+ *    successor when that one isn't placed yet: the target of a jump, and
+ *    for a conditional branch the way back to a loop header rather than
+ *    the way out of a loop, the way into a loop rather than around it,
+ *    and the branch taken otherwise. A branch whose comparison is made
+ *    right before it, for it alone, is inverted to fall through to the
+ *    block it used to take
+ *  - the block holding EndFunc stays last
+ *  - a jump to the next block and the labels no branch refers to are
+ *    dropped
+ *
+ * @param fn : the function to lay out
+ */
+void blockLayout(TACFunction &fn);
+
+#endif
@@ -80,6 +80,9 @@ template<class Element> class List {
     void PrintAll(int indentLevel, const char *label = NULL)
         { for (int i = 0; i < NumElements(); i++)
              Nth(i)->Print(indentLevel, label); }
+    void DeleteAll()
+        { for (int i = 0; i < NumElements(); i++)
+             delete Nth(i); }
              
 
 };
@@ -0,0 +1,1347 @@
+/**
+ * File: loops.cc
+ * --------------
+ * Preheaders, loop invariant code motion, induction variables, unrolling,
+ * rotation and unswitching.
+ */
+
+#include "loops.h"
+#include "ast.h"            // for Node::NewTemp
+#include "dataflow.h"
+#include "utility.h"
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <unordered_set>
+
+// The position of each block in the layout, -1 for those not in it
+static vector<int> layoutPositions(const CFG &cfg) {
+    vector<int> position(cfg.blocks.size(), -1);
+    for (int k = 0; k < cfg.layout.size(); k++)
+        position[cfg.layout[k]] = k;
+    return position;
+}
+
+// The blocks a transformation of the loop may change or rely on: its own,
+// those entering and leaving it, and those laid out right before its
+// header and right after its last block
+static vector<int> neighborhood(const CFG &cfg, const Loop &loop, const vector<int> &position) {
+    auto inLoop = [&](int b) { return binary_search(loop.blocks.begin(), loop.blocks.end(), b); };
+    vector<int> blocks = loop.blocks;
+    int last = loop.header;
+    for (int b : loop.blocks) {
+        for (int s : cfg.blocks[b].succs)
+            if (!inLoop(s))
+                blocks.push_back(s);
+        if (position[b] > position[last])
+            last = b;
+    }
+    for (int p : cfg.blocks[loop.header].preds)
+        if (!inLoop(p))
+            blocks.push_back(p);
+    if (position[loop.header] > 0)
+        blocks.push_back(cfg.layout[position[loop.header] - 1]);
+    if (position[last] + 1 < cfg.layout.size())
+        blocks.push_back(cfg.layout[position[last] + 1]);
+    return blocks;
+}
+
+/**
+ * Calls round on the loops of the function, innermost first, a nesting
+ * depth at a time, and writes the code back when it returns true. The
+ * loops of one depth are disjoint, so they can share one graph and what
+ * is computed on it: a round takes each loop of the depth whose
+ * neighborhood doesn't overlap that of a loop already taken, and the graph
+ * is rebuilt for the loops left over. That makes a round or two per depth
+ * however many loops there are, each loop being transformed against a
+ * graph that is exact around it. Only the loops the function had to start
+ * with are visited; a header keeps its label, which is how a loop is found
+ * again.
+ */
+static void forEachLoop(TACFunction &fn, const function<bool(CFG &, const vector<const Loop *> &)> &round) {
+    vector<pair<int,int>> pending;      // (depth, header label) of the loops left, deepest first
+    bool first = true;
+    while (first || !pending.empty()) {
+        CFG cfg(fn);
+        if (first) {
+            for (int i = cfg.loops.size() - 1; i >= 0; i--)
+                pending.emplace_back(cfg.loops[i].depth, cfg.blocks[cfg.loops[i].header].label);
+            stable_sort(pending.begin(), pending.end(),
+                        [](const pair<int,int> &a, const pair<int,int> &b) { return a.first > b.first; });
+            first = false;
+            if (pending.empty())
+                return;
+        }
+
+        unordered_map<int, const Loop *> byHeader;
+        for (const Loop &loop : cfg.loops)
+            byHeader[cfg.blocks[loop.header].label] = &loop;
+        vector<int> position = layoutPositions(cfg);
+
+        vector<bool> claimed(cfg.blocks.size(), false);
+        vector<const Loop *> taken;
+        vector<pair<int,int>> left;
+        int depth = pending[0].first;
+        for (const pair<int,int> &p : pending) {
+            auto found = byHeader.find(p.second);
+            if (found == byHeader.end())
+                continue;
+            if (p.first != depth) {
+                left.push_back(p);
+                continue;
+            }
+            vector<int> blocks = neighborhood(cfg, *found->second, position);
+            bool overlaps = false;
+            for (int b : blocks)
+                overlaps |= claimed[b];
+            if (overlaps) {
+                left.push_back(p);
+                continue;
+            }
+            for (int b : blocks)
+                claimed[b] = true;
+            taken.push_back(found->second);
+        }
+        pending.swap(left);
+
+        if (!taken.empty() && round(cfg, taken))
+            cfg.Linearize();
+    }
+}
+
+// Marks the blocks of the loop in a vector sized for the graph, or clears
+// them, so that moving from one loop to the next costs the size of the loops
+static void markLoop(vector<bool> &inLoop, const CFG &cfg, const Loop &loop, bool in) {
+    inLoop.resize(cfg.blocks.size(), false);
+    for (int b : loop.blocks)
+        inLoop[b] = in;
+}
+
+/**
+ * Returns the preheader of the loop, making one if needed, or -1 when the
+ * block laid out before the header is part of the loop and falls through
+ * to it (there is then no place for a new block).
+ */
+static int preheader(CFG &cfg, const Loop &loop, const vector<bool> &inLoop) {
+    int h = loop.header;
+    vector<int> entries;
+    for (int p : cfg.blocks[h].preds)
+        if (cfg.IsReachable(p) && !inLoop[p])
+            entries.push_back(p);
+
+    if (entries.size() == 1) {
+        const BasicBlock &p = cfg.blocks[entries[0]];
+        tacop last = p.code.empty() ? op_Label : p.code.back().op;
+        if (p.succs.size() == 1 && last != op_IfGoto && last != op_Return)
+            return entries[0];
+    }
+
+    int at = find(cfg.layout.begin(), cfg.layout.end(), h) - cfg.layout.begin();
+    if (at > 0) {
+        int prev = cfg.layout[at - 1];
+        tacop last = cfg.blocks[prev].code.back().op;
+        if (inLoop[prev] && last != op_Goto && last != op_Return && last != op_EndFunc)
+            return -1;
+    }
+
+    int pre = cfg.NewBlock();
+    int label = cfg.blocks[pre].label;
+    for (int p : entries) {
+        TACObject &branch = cfg.blocks[p].code.back();
+        if (IsBranch(branch.op) && branch.dst.value == cfg.blocks[h].label)
+            branch.dst = Operand::Label(label);
+    }
+    cfg.layout.insert(cfg.layout.begin() + at, pre);
+    return pre;
+}
+
+/**
+ * The definitions of each register in one loop at a time. The counts are
+ * kept in a vector sized for the registers of the function and only those
+ * of the previous loop are cleared, so counting costs the size of the
+ * loop. Registers made since are defined nowhere in it.
+ */
+class LoopDefinitions {
+  public:
+    bool hasCall;               // whether the loop makes a call
+
+    LoopDefinitions(const TACFunction &fn) : hasCall(false), counts(fn.regs.size(), 0) {}
+
+    void Count(const CFG &cfg, const Loop &loop) {
+        for (int r : defined)
+            counts[r] = 0;
+        defined.clear();
+        hasCall = false;
+        for (int b : loop.blocks) {
+            for (const TACObject &taco : cfg.blocks[b].code) {
+                hasCall |= taco.op == op_Call;
+                int d = DefinedReg(taco);
+                if (d >= 0 && d < counts.size() && counts[d]++ == 0)
+                    defined.push_back(d);
+            }
+        }
+    }
+
+    int operator[](int r) const { return r < counts.size() ? counts[r] : 0; }
+
+  private:
+    vector<int> counts;
+    vector<int> defined;        // registers with a nonzero count
+};
+
+// Adds the code at the end of the block, before the jump ending it if any
+static void appendToBlock(BasicBlock &block, const vector<TACObject> &add) {
+    vector<TACObject> &code = block.code;
+    auto at = code.end();
+    if (!code.empty() && code.back().op == op_Goto)
+        at--;
+    code.insert(at, add.begin(), add.end());
+}
+
+/**
+ * The last definition of each register in the block being walked. It is
+ * kept in vectors sized for the function and a block is started by moving
+ * to a new stamp, so the blocks of every loop of a round can share it.
+ */
+class BlockDefinitions {
+  public:
+    BlockDefinitions(const TACFunction &fn) : stamp(0), last(fn.regs.size(), -1), seen(fn.regs.size(), 0) {}
+
+    void Start() { stamp++; }
+
+    void Define(int r, int i) {
+        if (r < last.size()) {
+            last[r] = i;
+            seen[r] = stamp;
+        }
+    }
+
+    // The instruction defining r last so far in the block, -1 if none does
+    int operator[](int r) const { return r < seen.size() && seen[r] == stamp ? last[r] : -1; }
+
+  private:
+    int stamp;
+    vector<int> last, seen;
+};
+
+/**
+ * Hoists the invariant computations of the loop, returns how many were
+ * moved. invariant holds a flag per instruction, for the blocks of the
+ * loop.
+ */
+static int hoistInvariants(CFG &cfg, const Loop &loop, const vector<bool> &inLoop, LoopDefinitions &loopDefs,
+                           const Liveness &liveness, vector<vector<bool>> &invariant, BlockDefinitions &local) {
+    TACFunction &fn = cfg.fn;
+    loopDefs.Count(cfg, loop);
+    bool hasCall = loopDefs.hasCall;
+
+    // the definition of each register defined once in the loop
+    unordered_map<int, pair<int,int>> only;
+    for (int b : loop.blocks) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        invariant[b].assign(code.size(), false);
+        for (int i = 0; i < code.size(); i++) {
+            int d = DefinedReg(code[i]);
+            if (d >= 0 && loopDefs[d] == 1)
+                only[d] = make_pair(b, i);
+        }
+    }
+
+    vector<pair<int,int>> hoisted;  // (block, instruction) in the order they became invariant
+
+    // An operand is invariant when the loop doesn't define it, or when it
+    // reads an invariant definition, the loop's only one, that comes first
+    // on every way from the header: then no definition from outside the
+    // loop gets past it. A definition earlier in the block is the one read.
+    auto isInvariant = [&](const Operand &o, int b) {
+        if (!o.IsReg())
+            return true;
+        int r = o.value;
+        if (hasCall && !fn.IsLocal(r))
+            return false;
+        if (loopDefs[r] == 0)
+            return true;
+        if (local[r] >= 0)
+            return (bool)invariant[b][local[r]];
+        if (loopDefs[r] != 1)
+            return false;
+        pair<int,int> def = only[r];
+        return def.first != b && cfg.Dominates(def.first, b) && invariant[def.first][def.second];
+    };
+
+    // the value must be the one seen on every way out where it is read
+    vector<pair<int,int>> exits;    // (block in the loop, block outside)
+    for (int e : loop.blocks)
+        for (int s : cfg.blocks[e].succs)
+            if (!inLoop[s])
+                exits.emplace_back(e, s);
+    auto isSafe = [&](int b, int d) {
+        if (!fn.IsLocal(d) || loopDefs[d] != 1 || liveness.LiveIn(loop.header, d))
+            return false;
+        for (const pair<int,int> &exit : exits)
+            if (liveness.LiveIn(exit.second, d) && !cfg.Dominates(b, exit.first))
+                return false;
+        return true;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b : loop.blocks) {
+            const vector<TACObject> &code = cfg.blocks[b].code;
+            local.Start();
+            for (int i = 0; i < code.size(); i++) {
+                const TACObject &taco = code[i];
+                int d = DefinedReg(taco);
+                if (d < 0)
+                    continue;
+
+                bool pure = taco.op == op_Copy || taco.op == op_Neg || IsBinary(taco.op);
+                bool traps = taco.op == op_Div && !(taco.b.IsImm() && taco.b.value != 0);
+                if (!invariant[b][i] && pure && !traps &&
+                    isInvariant(taco.a, b) && isInvariant(taco.b, b) && isSafe(b, d)) {
+                    invariant[b][i] = true;
+                    hoisted.emplace_back(b, i);
+                    changed = true;
+                }
+                local.Define(d, i);
+            }
+        }
+    }
+
+    if (hoisted.empty())
+        return 0;
+
+    int pre = preheader(cfg, loop, inLoop);
+    if (pre < 0)
+        return 0;
+
+    vector<TACObject> moved;
+    for (const pair<int,int> &at : hoisted)
+        moved.push_back(cfg.blocks[at.first].code[at.second]);
+
+    for (int b : loop.blocks) {
+        vector<TACObject> &code = cfg.blocks[b].code;
+        int kept = 0;
+        for (int i = 0; i < code.size(); i++)
+            if (!invariant[b][i])
+                code[kept++] = code[i];
+        code.erase(code.begin() + kept, code.end());
+    }
+
+    appendToBlock(cfg.blocks[pre], moved);
+    return moved.size();
+}
+
+/**
+ * Loops are visited innermost first so that code hoisted to the preheader
+ * of an inner loop can leave the outer loop as well. The loops of a round
+ * share the liveness of its graph: hoisting out of one loop only changes
+ * the loop and its preheader, and leaves what is live elsewhere as it was.
+ */
+void loopInvariantCodeMotion(TACFunction &fn) {
+    int moved = 0, loops = 0;
+    forEachLoop(fn, [&](CFG &cfg, const vector<const Loop *> &round) {
+        Liveness liveness(cfg);
+        vector<vector<bool>> invariant(cfg.blocks.size());
+        BlockDefinitions local(fn);
+        vector<bool> inLoop;
+        LoopDefinitions loopDefs(fn);
+        bool changed = false;
+        for (const Loop *loop : round) {
+            markLoop(inLoop, cfg, *loop, true);
+            int n = hoistInvariants(cfg, *loop, inLoop, loopDefs, liveness, invariant, local);
+            markLoop(inLoop, cfg, *loop, false);
+            moved += n;
+            loops += n > 0;
+            changed |= n > 0;
+        }
+        return changed;
+    });
+
+    PrintDebug("licm", "%s: %d invariant computations hoisted out of %d loops",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", moved, loops);
+}
+
+// Reads of each register in the function
+static vector<int> countUses(const CFG &cfg) {
+    vector<int> uses(cfg.fn.regs.size(), 0);
+    for (const BasicBlock &block : cfg.blocks) {
+        for (const TACObject &taco : block.code) {
+            if (taco.a.IsReg()) uses[taco.a.value]++;
+            if (taco.b.IsReg()) uses[taco.b.value]++;
+        }
+    }
+    return uses;
+}
+
+// i = i + c is emitted as t := i + c, i := t; steps i directly when t is
+// read nowhere else
+static void mergeSteps(CFG &cfg, const Loop &loop, vector<int> &uses) {
+    for (int b : loop.blocks) {
+        vector<TACObject> &code = cfg.blocks[b].code;
+        for (int k = 0; k + 1 < code.size(); k++) {
+            TACObject &sum = code[k], &copy = code[k + 1];
+            if (copy.op != op_Copy || !copy.a.IsReg() || !(sum.dst == copy.a) ||
+                cfg.fn.regs[copy.a.value].name >= 0 || uses[copy.a.value] != 1)
+                continue;
+            if ((sum.op == op_Add && (sum.a == copy.dst || sum.b == copy.dst)) ||
+                (sum.op == op_Sub && sum.a == copy.dst)) {
+                uses[copy.a.value]--;
+                sum.dst = copy.dst;
+                code.erase(code.begin() + k + 1);
+            }
+        }
+    }
+}
+
+/**
+ * Whether the temps defined in the blocks are read nowhere else, uses
+ * counting the reads of each register in the function. The counts of a
+ * round stay good for the loops not yet changed: changing a loop only
+ * adds reads of registers it reads already, and of new ones.
+ */
+static bool tempsKeptIn(const CFG &cfg, const vector<int> &blocks, const vector<int> &uses) {
+    unordered_map<int,int> reads;       // temp defined in the blocks -> its reads in them
+    for (int b : blocks)
+        for (const TACObject &taco : cfg.blocks[b].code) {
+            int d = DefinedReg(taco);
+            if (d >= 0 && cfg.fn.regs[d].name < 0)
+                reads[d];
+        }
+    for (int b : blocks)
+        for (const TACObject &taco : cfg.blocks[b].code)
+            for (const Operand *o : { &taco.a, &taco.b })
+                if (o->IsReg() && reads.count(o->value))
+                    reads[o->value]++;
+    for (const pair<const int,int> &r : reads)
+        if (r.first < uses.size() && uses[r.first] != r.second)
+            return false;
+    return true;
+}
+
+// A basic induction variable: a local variable whose only definition in
+// the loop is reg := reg + step
+struct InductionVariable {
+    int reg;
+    int step;
+};
+
+// A derived induction variable iv * factor, kept in a variable of its own
+// that is stepped by stride right after the basic one
+struct ScaledVariable {
+    int iv;                     // index of the basic induction variable
+    Operand factor;
+    Operand reg;
+    Operand stride;
+};
+
+// op' such that a op b is b op' a
+static tacop mirrored(tacop op) {
+    switch (op) {
+        case op_Less:           return op_Greater;
+        case op_LessEqual:      return op_GreaterEqual;
+        case op_Greater:        return op_Less;
+        case op_GreaterEqual:   return op_LessEqual;
+        default:                return op;
+    }
+}
+
+static bool fitsInt(long long v) {
+    return v >= INT_MIN && v <= INT_MAX;
+}
+
+/**
+ * The local variables that enter the loop with a known constant value. The
+ * walk goes back from the one block entering the loop for as long as a
+ * block has a single predecessor, and the last definition of a register
+ * met on the way is the one that reaches the loop.
+ */
+static unordered_map<int,int> valuesOnEntry(const CFG &cfg, const Loop &loop, const vector<bool> &inLoop) {
+    unordered_map<int,int> values;
+    int b = -1;
+    for (int p : cfg.blocks[loop.header].preds) {
+        if (!cfg.IsReachable(p) || inLoop[p])
+            continue;
+        if (b >= 0)
+            return values;
+        b = p;
+    }
+
+    unordered_set<int> decided;
+    while (b >= 0) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        for (int i = code.size() - 1; i >= 0; i--) {
+            int d = DefinedReg(code[i]);
+            if (d >= 0 && cfg.fn.IsLocal(d) && decided.insert(d).second &&
+                code[i].op == op_Copy && code[i].a.IsImm())
+                values[d] = code[i].a.value;
+        }
+        b = cfg.blocks[b].preds.size() == 1 ? cfg.blocks[b].preds[0] : -1;
+    }
+    return values;
+}
+
+struct ReductionCounts {
+    int reduced, tests, removed;
+};
+
+/**
+ * Finds the induction variables of the loop, reduces their
+ * multiplications and rewrites the exit tests on them. uses counts the
+ * reads of each register in the function and liveness and entry describe
+ * the graph before any loop of the round was changed; productOf holds an
+ * entry per instruction, for the blocks of the loop.
+ */
+static void reduceInductionVariables(CFG &cfg, const Loop &loop, const vector<bool> &inLoop,
+                                     LoopDefinitions &loopDefs, vector<int> &uses, const Liveness &liveness,
+                                     const unordered_map<int,int> &entry, vector<vector<int>> &productOf,
+                                     ReductionCounts &counts) {
+    TACFunction &fn = cfg.fn;
+    mergeSteps(cfg, loop, uses);
+
+    loopDefs.Count(cfg, loop);
+    bool hasCall = loopDefs.hasCall;
+    auto isInvariant = [&](const Operand &o) {
+        return !o.IsReg() || (loopDefs[o.value] == 0 && !(hasCall && !fn.IsLocal(o.value)));
+    };
+
+    vector<InductionVariable> ivs;
+    unordered_map<int,int> ivOf;        // register -> its induction variable
+    auto ivIndex = [&](const Operand &o) {
+        auto found = o.IsReg() ? ivOf.find(o.value) : ivOf.end();
+        return found == ivOf.end() ? -1 : found->second;
+    };
+    for (int b : loop.blocks) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        for (int i = 0; i < code.size(); i++) {
+            const TACObject &taco = code[i];
+            int d = DefinedReg(taco);
+            if (d < 0 || !fn.IsLocal(d) || loopDefs[d] != 1)
+                continue;
+
+            Operand self = Operand::Reg(d);
+            int step;
+            if (taco.op == op_Add && taco.a == self && taco.b.IsImm())
+                step = taco.b.value;
+            else if (taco.op == op_Add && taco.b == self && taco.a.IsImm())
+                step = taco.a.value;
+            else if (taco.op == op_Sub && taco.a == self && taco.b.IsImm())
+                FoldBinary(op_Sub, 0, taco.b.value, step);
+            else
+                continue;
+
+            ivOf[d] = ivs.size();
+            ivs.push_back({ d, step });
+        }
+    }
+    if (ivs.empty())
+        return;
+
+    // multiplications of an induction variable by an invariant factor
+    vector<ScaledVariable> scaled;
+    unordered_map<int, Operand> renamed;    // temp -> register read instead
+    for (int b : loop.blocks) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        productOf[b].assign(code.size(), -1);
+        for (int i = 0; i < code.size(); i++) {
+            Operand x = code[i].a, y = code[i].b;
+            if (code[i].op != op_Mul)
+                continue;
+            if (ivIndex(x) < 0)
+                swap(x, y);
+            if (ivIndex(x) < 0 || !isInvariant(y))
+                continue;
+
+            int iv = ivIndex(x), k = 0;
+            while (k < scaled.size() && !(scaled[k].iv == iv && scaled[k].factor == y))
+                k++;
+            if (k == scaled.size()) {
+                Operand stride;
+                int folded;
+                if (y.IsImm() && FoldBinary(op_Mul, y.value, ivs[iv].step, folded))
+                    stride = Operand::Imm(folded);
+                else if (ivs[iv].step == 1)
+                    stride = y;
+                else
+                    stride = Node::NewTemp(fn);
+                scaled.push_back({ iv, y, Operand::Reg(fn.NewVariable(fn.regs[x.value].name)), stride });
+            }
+            productOf[b][i] = k;
+
+            // a temp read once further down the block, before the variable
+            // steps, reads the register directly
+            int t = code[i].dst.value;
+            if (fn.regs[t].name >= 0 || uses[t] != 1)
+                continue;
+            for (int j = i + 1; j < code.size() && DefinedReg(code[j]) != ivs[iv].reg; j++) {
+                if (code[j].a == code[i].dst || code[j].b == code[i].dst) {
+                    renamed[t] = scaled[k].reg;
+                    break;
+                }
+            }
+        }
+    }
+
+    auto initialValue = [&](int reg, int &value) {
+        auto found = entry.find(reg);
+        if (found == entry.end())
+            return false;
+        value = found->second;
+        return true;
+    };
+
+    int pre = scaled.empty() ? -1 : preheader(cfg, loop, inLoop);
+    if (pre < 0) {
+        scaled.clear();
+        for (int b : loop.blocks)
+            productOf[b].assign(productOf[b].size(), -1);
+        renamed.clear();
+    }
+
+    // exit tests: i op n, n invariant, where staying in the loop is the
+    // branch taken
+    for (int tb : loop.blocks) {
+        vector<TACObject> &code = cfg.blocks[tb].code;
+        if (code.empty() || code.back().op != op_IfGoto || !code.back().a.IsReg())
+            continue;
+        const vector<int> &succs = cfg.blocks[tb].succs;
+        if (succs.size() != 2 || !inLoop[succs[0]] || inLoop[succs[1]])
+            continue;
+
+        int at = code.size() - 2;
+        while (at >= 0 && DefinedReg(code[at]) != code.back().a.value)
+            at--;
+        if (at < 0)
+            continue;
+        TACObject &test = code[at];
+        if (test.op != op_Less && test.op != op_LessEqual &&
+            test.op != op_Greater && test.op != op_GreaterEqual)
+            continue;
+
+        Operand i = test.a, n = test.b;
+        tacop op = test.op;
+        if (ivIndex(i) < 0) {
+            swap(i, n);
+            op = mirrored(op);
+        }
+        if (ivIndex(i) < 0 || !isInvariant(n))
+            continue;
+        const InductionVariable &iv = ivs[ivIndex(i)];
+
+        bool everyIteration = true;
+        for (int latch : loop.latches)
+            everyIteration &= cfg.Dominates(tb, latch);
+
+        // replacement by a scaled variable i * c: the range of i is known
+        // when its start, its step and the bound are constants, and none
+        // of the products may wrap around
+        int i0, k = 0;
+        while (k < scaled.size() && !(scaled[k].iv == ivIndex(i) && scaled[k].factor.IsImm() &&
+                                      scaled[k].factor.value != 0))
+            k++;
+        if (k < scaled.size() && everyIteration && n.IsImm() && initialValue(i.value, i0)) {
+            long long c = scaled[k].factor.value, lo, hi;
+            bool upward = op == op_Less || op == op_LessEqual;
+            long long last = n.value + (op == op_Less ? -1 : op == op_Greater ? 1 : 0);
+            if (upward) {
+                lo = i0;
+                hi = max((long long)i0, last + iv.step);
+            } else {
+                lo = min((long long)i0, last + iv.step);
+                hi = i0;
+            }
+            if ((upward ? iv.step > 0 : iv.step < 0) && fitsInt(lo) && fitsInt(hi) &&
+                fitsInt(lo * c) && fitsInt(hi * c) && fitsInt(n.value * c)) {
+                test = TACObject(c > 0 ? op : mirrored(op), test.dst, scaled[k].reg,
+                                 Operand::Imm(n.value * c));
+                counts.tests++;
+                continue;
+            }
+        }
+
+        // i <= n is i < n + 1 for a constant n, and not n < i otherwise,
+        // which is tested by branching the other way
+        if (n.IsImm() && op == op_LessEqual && n.value < INT_MAX) {
+            test = TACObject(op_Less, test.dst, i, Operand::Imm(n.value + 1));
+            counts.tests++;
+            continue;
+        }
+        if (n.IsImm() && op == op_GreaterEqual && n.value > INT_MIN) {
+            test = TACObject(op_Greater, test.dst, i, Operand::Imm(n.value - 1));
+            counts.tests++;
+            continue;
+        }
+
+        int next = find(cfg.layout.begin(), cfg.layout.end(), tb) - cfg.layout.begin() + 1;
+        if ((op != op_LessEqual && op != op_GreaterEqual) || uses[test.dst.value] != 1 ||
+            next >= cfg.layout.size() || cfg.layout[next] != succs[1])
+            continue;
+        BasicBlock &fall = cfg.blocks[succs[1]];
+        if (fall.code.size() != 1 || fall.code[0].op != op_Goto || fall.preds.size() != 1)
+            continue;
+
+        if (op == op_LessEqual)
+            test = TACObject(op_Less, test.dst, n, i);
+        else
+            test = TACObject(op_Less, test.dst, i, n);
+        Operand stay = code.back().dst;
+        code.back().dst = fall.code[0].dst;
+        fall.code[0].dst = stay;
+        if (next + 1 < cfg.layout.size() && cfg.blocks[cfg.layout[next + 1]].label == stay.value)
+            fall.code.clear();
+        counts.tests++;
+    }
+
+    // a variable left with no use in the loop but its own step and not
+    // read after it is dead
+    unordered_map<int,int> loopUses;
+    for (int b : loop.blocks) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        for (int i = 0; i < code.size(); i++) {
+            if (productOf[b][i] >= 0)
+                continue;
+            if (code[i].a.IsReg()) loopUses[code[i].a.value]++;
+            if (code[i].b.IsReg()) loopUses[code[i].b.value]++;
+        }
+    }
+    vector<bool> dead(ivs.size(), false);
+    for (int v = 0; v < ivs.size(); v++) {
+        dead[v] = loopUses[ivs[v].reg] == 1;
+        for (int e : loop.blocks)
+            for (int s : cfg.blocks[e].succs)
+                if (!inLoop[s] && liveness.LiveIn(s, ivs[v].reg))
+                    dead[v] = false;
+    }
+
+    if (!scaled.empty()) {
+        vector<TACObject> init;
+        for (const ScaledVariable &sv : scaled) {
+            const InductionVariable &iv = ivs[sv.iv];
+            int i0, product;
+            bool known = initialValue(iv.reg, i0);
+            if (sv.stride.IsReg() && !(sv.stride == sv.factor))
+                init.emplace_back(op_Mul, sv.stride, sv.factor, Operand::Imm(iv.step));
+            if (known && sv.factor.IsImm() && FoldBinary(op_Mul, i0, sv.factor.value, product))
+                init.emplace_back(op_Copy, sv.reg, Operand::Imm(product));
+            else if (known && (i0 == 0 || i0 == 1))
+                init.emplace_back(op_Copy, sv.reg, i0 == 0 ? Operand::Imm(0) : sv.factor);
+            else
+                init.emplace_back(op_Mul, sv.reg, Operand::Reg(iv.reg), sv.factor);
+        }
+        appendToBlock(cfg.blocks[pre], init);
+        counts.reduced += scaled.size();
+    }
+
+    for (int b : loop.blocks) {
+        vector<TACObject> &code = cfg.blocks[b].code;
+        vector<TACObject> rewritten;
+        for (int i = 0; i < code.size(); i++) {
+            int d = DefinedReg(code[i]);
+            int v = d >= 0 ? ivIndex(code[i].dst) : -1;    // the only definition of v in the loop is its step
+
+            TACObject taco = code[i];
+            if (taco.a.IsReg() && renamed.count(taco.a.value))
+                taco.a = renamed[taco.a.value];
+            if (taco.b.IsReg() && renamed.count(taco.b.value))
+                taco.b = renamed[taco.b.value];
+
+            if (productOf[b][i] >= 0) {
+                if (!renamed.count(taco.dst.value))
+                    rewritten.emplace_back(op_Copy, taco.dst, scaled[productOf[b][i]].reg);
+            } else if (v < 0 || !dead[v]) {
+                rewritten.push_back(taco);
+            } else {
+                counts.removed++;
+            }
+
+            if (v >= 0)
+                for (const ScaledVariable &sv : scaled)
+                    if (sv.iv == v)
+                        rewritten.emplace_back(op_Add, sv.reg, sv.reg, sv.stride);
+        }
+        code.swap(rewritten);
+    }
+}
+
+/**
+ * Visits the loops innermost first like code motion, after it has moved
+ * the invariant factors and bounds out of the way. The loops of a round
+ * share the reads counted and the liveness of its graph, and what each
+ * enters with is found before any of them changes. A loop's rewriting
+ * only adds reads of registers it reads already, outside the other loops,
+ * and removes a variable only where it is dead, so what the others were
+ * told still holds.
+ */
+void strengthReduction(TACFunction &fn) {
+    ReductionCounts counts = { 0, 0, 0 };
+    forEachLoop(fn, [&](CFG &cfg, const vector<const Loop *> &round) {
+        vector<int> uses = countUses(cfg);
+        Liveness liveness(cfg);
+        vector<bool> inLoop;
+        vector<unordered_map<int,int>> entry;
+        for (const Loop *loop : round) {
+            markLoop(inLoop, cfg, *loop, true);
+            entry.push_back(valuesOnEntry(cfg, *loop, inLoop));
+            markLoop(inLoop, cfg, *loop, false);
+        }
+
+        vector<vector<int>> productOf(cfg.blocks.size());   // instruction -> scaled variable
+        LoopDefinitions loopDefs(fn);
+        for (int k = 0; k < round.size(); k++) {
+            markLoop(inLoop, cfg, *round[k], true);
+            reduceInductionVariables(cfg, *round[k], inLoop, loopDefs, uses, liveness, entry[k], productOf, counts);
+            markLoop(inLoop, cfg, *round[k], false);
+        }
+        return true;
+    });
+
+    PrintDebug("iv", "%s: %d multiplications reduced, %d exit tests replaced, %d induction variables removed",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>",
+               counts.reduced, counts.tests, counts.removed);
+}
+
+static const int DefaultUnrollLimit = 48;
+static const int DefaultUnrollFactor = 4;
+
+// A loop counted by a basic induction variable: the header only computes
+// i op bound and branches into the body, or falls through out of the loop
+struct CountedLoop {
+    int iv;
+    int step;
+    tacop op;                   // with the induction variable on the left
+    Operand bound;
+    int body;                   // block the header branches to
+    int exit;                   // block the header falls through to
+    vector<int> blocks;         // the loop but for the header, in layout order
+    int size;                   // instructions in them
+};
+
+struct UnrollCounts {
+    int full, partial;
+};
+
+/**
+ * Returns true if the loop is counted and its body can be copied: the body
+ * has a single latch jumping back to the header, leaves the loop only by
+ * returning, and its temps are not read after it. position is that of the
+ * blocks in the layout.
+ */
+static bool countedLoop(CFG &cfg, const Loop &loop, const vector<bool> &inLoop, LoopDefinitions &loopDefs,
+                        vector<int> &uses, const vector<int> &position, CountedLoop &counted) {
+    TACFunction &fn = cfg.fn;
+    const BasicBlock &header = cfg.blocks[loop.header];
+    if (loop.latches.size() != 1 || header.code.size() != 3 || header.succs.size() != 2)
+        return false;
+    const TACObject &test = header.code[1], &branch = header.code[2];
+    if (branch.op != op_IfGoto || !branch.a.IsReg() || !(branch.a == test.dst) ||
+        (test.op != op_Less && test.op != op_LessEqual && test.op != op_Greater && test.op != op_GreaterEqual))
+        return false;
+    counted.body = header.succs[0];
+    counted.exit = header.succs[1];
+    if (!inLoop[counted.body] || inLoop[counted.exit])
+        return false;
+
+    const BasicBlock &latch = cfg.blocks[loop.latches[0]];
+    if (latch.code.back().op != op_Goto || latch.code.back().dst.value != header.label)
+        return false;
+
+    mergeSteps(cfg, loop, uses);
+    if (uses[test.dst.value] != 1)
+        return false;
+
+    loopDefs.Count(cfg, loop);
+    bool hasCall = loopDefs.hasCall;
+    Operand i = test.a, n = test.b;
+    tacop op = test.op;
+    if (!i.IsReg() || loopDefs[i.value] != 1) {
+        swap(i, n);
+        op = mirrored(op);
+    }
+    if (!i.IsReg() || !fn.IsLocal(i.value) || loopDefs[i.value] != 1)
+        return false;
+    if (n.IsReg() && (loopDefs[n.value] != 0 || (hasCall && !fn.IsLocal(n.value))))
+        return false;
+
+    // the step runs once on every iteration, in the direction that ends the loop
+    int step = 0;
+    for (int b : loop.blocks) {
+        for (const TACObject &taco : cfg.blocks[b].code) {
+            if (DefinedReg(taco) != i.value)
+                continue;
+            if (taco.op == op_Add && taco.a == i && taco.b.IsImm())
+                step = taco.b.value;
+            else if (taco.op == op_Add && taco.b == i && taco.a.IsImm())
+                step = taco.a.value;
+            else if (taco.op == op_Sub && taco.a == i && taco.b.IsImm())
+                FoldBinary(op_Sub, 0, taco.b.value, step);
+            if (step != 0 && !cfg.Dominates(b, loop.latches[0]))
+                step = 0;
+        }
+    }
+    bool upward = op == op_Less || op == op_LessEqual;
+    if (upward ? step <= 0 : step >= 0)
+        return false;
+    counted.iv = i.value;
+    counted.step = step;
+    counted.op = op;
+    counted.bound = n;
+
+    // the body in layout order, falling through only within itself
+    counted.blocks.clear();
+    counted.size = 0;
+    for (int b : loop.blocks)
+        if (b != loop.header)
+            counted.blocks.push_back(b);
+    sort(counted.blocks.begin(), counted.blocks.end(), [&](int x, int y) { return position[x] < position[y]; });
+    if (counted.blocks.empty() || counted.blocks[0] != counted.body)
+        return false;
+    for (int k = 0; k < counted.blocks.size(); k++) {
+        const BasicBlock &block = cfg.blocks[counted.blocks[k]];
+        tacop last = block.code.empty() ? op_Label : block.code.back().op;
+        int at = position[counted.blocks[k]];
+        bool fallsThrough = last != op_Goto && last != op_Return && last != op_EndFunc;
+        if (fallsThrough && (k + 1 == counted.blocks.size() || cfg.layout[at + 1] != counted.blocks[k + 1]))
+            return false;
+        for (int s : block.succs)
+            if (!inLoop[s] && last != op_Return)
+                return false;
+        for (const TACObject &taco : block.code)
+            counted.size += taco.op != op_Label;
+    }
+
+    // temps computed in the body are renamed in each copy
+    return tempsKeptIn(cfg, loop.blocks, uses);
+}
+
+/**
+ * A copy of the body with fresh labels and temps. The jump back to the
+ * header ending it is dropped, so the copy falls through to what follows.
+ */
+static vector<TACObject> copyBody(CFG &cfg, const CountedLoop &counted) {
+    TACFunction &fn = cfg.fn;
+    unordered_map<int, int> labels;
+    for (int b : counted.blocks)
+        if (cfg.blocks[b].label >= 0)
+            labels[cfg.blocks[b].label] = NewLabelNumber();
+    unordered_map<int, Operand> temps;
+    for (int b : counted.blocks)
+        for (const TACObject &taco : cfg.blocks[b].code) {
+            int d = DefinedReg(taco);
+            if (d >= 0 && fn.regs[d].name < 0)
+                temps[d] = Node::NewTemp(fn);
+        }
+    auto rename = [&](Operand &o) {
+        if (o.kind == opnd_Label && labels.count(o.value))
+            o = Operand::Label(labels[o.value]);
+        else if (o.IsReg() && temps.count(o.value))
+            o = temps[o.value];
+    };
+
+    vector<TACObject> copy;
+    for (int b : counted.blocks) {
+        for (TACObject taco : cfg.blocks[b].code) {
+            rename(taco.dst);
+            rename(taco.a);
+            rename(taco.b);
+            copy.push_back(taco);
+        }
+    }
+    copy.pop_back();
+    return copy;
+}
+
+// The number of times the loop runs from a known start to a constant
+// bound, -1 if it is more than the limit or the variable would wrap around
+static int tripCount(const CountedLoop &counted, int start, int limit) {
+    long long i = start, n = counted.bound.value;
+    for (int trips = 0; trips <= limit; trips++) {
+        bool stays = counted.op == op_Less ? i < n : counted.op == op_LessEqual ? i <= n :
+                     counted.op == op_Greater ? i > n : i >= n;
+        if (!stays)
+            return trips;
+        i += counted.step;
+        if (!fitsInt(i))
+            return -1;
+    }
+    return -1;
+}
+
+// The label of the block, giving it one if it has none
+static int labelOf(BasicBlock &block) {
+    if (block.label < 0) {
+        block.label = NewLabelNumber();
+        block.code.insert(block.code.begin(), TACObject(op_Label, Operand::Label(block.label)));
+    }
+    return block.label;
+}
+
+/**
+ * Unrolls the loop: fully when it runs a known number of times and the
+ * copies stay under the limit, otherwise by the factor into a loop doing
+ * that many iterations at a time while they all fit before the bound,
+ * followed by the original loop for the rest. entry holds the values the
+ * variables known on the way in start with.
+ */
+static void unrollLoop(CFG &cfg, const Loop &loop, const vector<bool> &inLoop, LoopDefinitions &loopDefs,
+                       vector<int> &uses, const vector<int> &position, const unordered_map<int,int> &entry,
+                       int limit, int factor, UnrollCounts &counts) {
+    TACFunction &fn = cfg.fn;
+    CountedLoop counted;
+    if (!countedLoop(cfg, loop, inLoop, loopDefs, uses, position, counted))
+        return;
+
+    BasicBlock &header = cfg.blocks[loop.header];
+    int exitLabel = labelOf(cfg.blocks[counted.exit]);
+
+    auto start = entry.find(counted.iv);
+    int trips = -1;
+    if (counted.bound.IsImm() && start != entry.end())
+        trips = tripCount(counted, start->second, counted.size > 0 ? limit / counted.size : limit);
+
+    if (trips >= 0) {
+        vector<TACObject> code = { header.code[0] };
+        for (int k = 0; k < trips; k++) {
+            vector<TACObject> copy = copyBody(cfg, counted);
+            code.insert(code.end(), copy.begin(), copy.end());
+        }
+        code.emplace_back(op_Goto, Operand::Label(exitLabel));
+        header.code = code;
+        // the body is left empty, and out of the next graph
+        for (int b : counted.blocks)
+            cfg.blocks[b].code.clear();
+        counts.full++;
+        return;
+    }
+
+    if (factor < 2 || counted.size * factor > limit)
+        return;
+
+    // i op m, with m = n - (factor - 1) * step, holds when i and the next
+    // factor - 1 values all hold against n; when computing m would wrap
+    // around the unrolled loop is skipped
+    long long reach = (long long)(factor - 1) * counted.step;
+    bool upward = counted.step > 0;
+    long long edge = upward ? (long long)INT_MIN + reach : (long long)INT_MAX + reach;
+    if (!fitsInt(reach) || !fitsInt(edge))
+        return;
+
+    Operand remainder = Operand::Label(NewLabelNumber()), unrolled = Operand::Label(NewLabelNumber());
+    Operand test = Operand::Label(NewLabelNumber());
+    vector<TACObject> code = { header.code[0] };
+    Operand m;
+    if (counted.bound.IsImm()) {
+        if (upward ? counted.bound.value < edge : counted.bound.value > edge)
+            return;
+        m = Operand::Imm(counted.bound.value - reach);
+    } else {
+        Operand wraps = Node::NewTemp(fn);
+        m = Node::NewTemp(fn);
+        code.emplace_back(upward ? op_Less : op_Greater, wraps, counted.bound, Operand::Imm(edge));
+        code.emplace_back(op_IfGoto, remainder, wraps);
+        code.emplace_back(op_Add, m, counted.bound, Operand::Imm(-reach));
+    }
+    code.emplace_back(op_Goto, test);
+    code.emplace_back(op_Label, unrolled);
+    for (int k = 0; k < factor; k++) {
+        vector<TACObject> copy = copyBody(cfg, counted);
+        code.insert(code.end(), copy.begin(), copy.end());
+    }
+    Operand holds = Node::NewTemp(fn);
+    code.emplace_back(op_Label, test);
+    code.emplace_back(counted.op, holds, Operand::Reg(counted.iv), m);
+    code.emplace_back(op_IfGoto, unrolled, holds);
+
+    // the original loop, entered at its test, runs the iterations left
+    code.emplace_back(op_Label, remainder);
+    code.push_back(header.code[1]);
+    code.push_back(header.code[2]);
+    header.code = code;
+    cfg.blocks[loop.latches[0]].code.back().dst = remainder;
+    counts.partial++;
+}
+
+/**
+ * Innermost loops only: a loop containing another one is left alone, its
+ * inner loops being unrolled already when they could be. The loops of a
+ * round share the reads counted and the layout of its graph, which
+ * unrolling leaves in place, and what each enters with is found before
+ * any of them changes.
+ */
+void loopUnrolling(TACFunction &fn) {
+    int limit = GetOption("unroll-limit", DefaultUnrollLimit);
+    int factor = GetOption("unroll-factor", DefaultUnrollFactor);
+    UnrollCounts counts = { 0, 0 };
+    forEachLoop(fn, [&](CFG &cfg, const vector<const Loop *> &round) {
+        vector<bool> outer(cfg.loops.size(), false);        // whether the loop contains another
+        for (const Loop &loop : cfg.loops)
+            if (loop.parent >= 0)
+                outer[loop.parent] = true;
+        vector<const Loop *> innermost;
+        for (const Loop *loop : round)
+            if (!outer[loop - &cfg.loops[0]])
+                innermost.push_back(loop);
+        if (innermost.empty())
+            return false;
+
+        vector<int> uses = countUses(cfg);
+        vector<int> position = layoutPositions(cfg);
+        vector<bool> inLoop;
+        vector<unordered_map<int,int>> entry;
+        for (const Loop *loop : innermost) {
+            markLoop(inLoop, cfg, *loop, true);
+            entry.push_back(valuesOnEntry(cfg, *loop, inLoop));
+            markLoop(inLoop, cfg, *loop, false);
+        }
+
+        LoopDefinitions loopDefs(fn);
+        for (int k = 0; k < innermost.size(); k++) {
+            markLoop(inLoop, cfg, *innermost[k], true);
+            unrollLoop(cfg, *innermost[k], inLoop, loopDefs, uses, position, entry[k], limit, factor, counts);
+            markLoop(inLoop, cfg, *innermost[k], false);
+        }
+        return true;
+    });
+
+    PrintDebug("unroll", "%s: %d loops unrolled fully, %d partially",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", counts.full, counts.partial);
+}
+
+static const int DefaultRotateLimit = 8;
+
+/**
+ * Rotates the loop when its test, the header without its label, comes to
+ * at most the limit and every latch jumps back to it: each latch ends with
+ * a copy of the test (fresh temps) branching where the header does, and
+ * the header is left as the guard run once on the way in. Returns true if
+ * the loop was rotated.
+ */
+static bool rotateLoop(CFG &cfg, const Loop &loop, const vector<bool> &inLoop, const vector<int> &uses, int limit) {
+    TACFunction &fn = cfg.fn;
+    BasicBlock &header = cfg.blocks[loop.header];
+    const TACObject &branch = header.code.back();
+    if (branch.op != op_IfGoto || !branch.a.IsReg() || header.succs.size() != 2 ||
+        inLoop[header.succs[0]] == inLoop[header.succs[1]] || (int)header.code.size() - 2 > limit)
+        return false;
+    for (int l : loop.latches) {
+        const TACObject &last = cfg.blocks[l].code.back();
+        if (last.op != op_Goto || last.dst.value != header.label)
+            return false;
+    }
+
+    // the temps of the test are renamed in each copy, so only the test
+    // may read them
+    if (!tempsKeptIn(cfg, { loop.header }, uses))
+        return false;
+
+    int fallThrough = labelOf(cfg.blocks[header.succs[1]]);
+    for (int l : loop.latches) {
+        unordered_map<int, Operand> temps;
+        vector<TACObject> &code = cfg.blocks[l].code;
+        code.pop_back();
+        for (int k = 1; k < header.code.size(); k++) {
+            TACObject taco = header.code[k];
+            int d = DefinedReg(taco);
+            if (d >= 0 && fn.regs[d].name < 0)
+                temps[d] = Node::NewTemp(fn);
+            for (Operand *o : { &taco.dst, &taco.a, &taco.b })
+                if (o->IsReg() && temps.count(o->value))
+                    *o = temps[o->value];
+            code.push_back(taco);
+        }
+        code.emplace_back(op_Goto, Operand::Label(fallThrough));
+    }
+    return true;
+}
+
+void loopRotation(TACFunction &fn) {
+    int limit = GetOption("rotate-limit", DefaultRotateLimit);
+    int rotated = 0;
+    forEachLoop(fn, [&](CFG &cfg, const vector<const Loop *> &round) {
+        vector<int> uses = countUses(cfg);
+        vector<bool> inLoop;
+        int before = rotated;
+        for (const Loop *loop : round) {
+            markLoop(inLoop, cfg, *loop, true);
+            rotated += rotateLoop(cfg, *loop, inLoop, uses, limit);
+            markLoop(inLoop, cfg, *loop, false);
+        }
+        return rotated > before;
+    });
+
+    PrintDebug("rotate", "%s: %d loops rotated",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", rotated);
+}
+
+static const int DefaultUnswitchLimit = 32;
+
+static bool fallsThrough(const BasicBlock &block) {
+    tacop last = block.code.empty() ? op_Label : block.code.back().op;
+    return last != op_Goto && last != op_Return && last != op_EndFunc;
+}
+
+/**
+ * Returns the block of the loop ending with a branch on an invariant
+ * condition, both ways staying in the loop, or -1. The condition is
+ * invariant when the loop doesn't assign it, or when it is computed once
+ * in the loop from operands the loop doesn't assign; in that case def is
+ * set to that computation.
+ */
+static int invariantBranch(const CFG &cfg, const Loop &loop, const vector<bool> &inLoop,
+                           LoopDefinitions &loopDefs, const TACObject *&def) {
+    const TACFunction &fn = cfg.fn;
+    loopDefs.Count(cfg, loop);
+    bool hasCall = loopDefs.hasCall;
+    auto invariant = [&](const Operand &o) {
+        return !o.IsReg() || (loopDefs[o.value] == 0 && (!hasCall || fn.IsLocal(o.value)));
+    };
+
+    for (int b : loop.blocks) {
+        const BasicBlock &block = cfg.blocks[b];
+        const TACObject &branch = block.code.back();
+        if (branch.op != op_IfGoto || !branch.a.IsReg() || block.succs.size() != 2 ||
+            !inLoop[block.succs[0]] || !inLoop[block.succs[1]])
+            continue;
+        def = NULL;
+        if (invariant(branch.a))
+            return b;
+        if (fn.regs[branch.a.value].name >= 0 || loopDefs[branch.a.value] != 1)
+            continue;
+        for (int d : loop.blocks)
+            for (const TACObject &taco : cfg.blocks[d].code)
+                if (DefinedReg(taco) == branch.a.value)
+                    def = &taco;
+        if ((IsBinary(def->op) || def->op == op_Copy || def->op == op_Neg) && def->op != op_Div &&
+            invariant(def->a) && invariant(def->b))
+            return b;
+    }
+    return -1;
+}
+
+/**
+ * Unswitches the loop on the first invariant branch in it, when the loop
+ * has at most limit instructions: the loop is copied with fresh labels and
+ * temps, the branch always goes its taken way in the original and its
+ * other way in the copy, and the preheader tests the condition to pick one
+ * of them. Returns true if it did. layout and position are those the round
+ * started with: blocks are only ever added to the layout, elsewhere than
+ * between the blocks of this loop and those laid out after them.
+ */
+static bool unswitchLoop(CFG &cfg, const Loop &loop, vector<bool> &inLoop, LoopDefinitions &loopDefs,
+                         const vector<int> &uses, const vector<int> &layout, const vector<int> &position, int limit) {
+    TACFunction &fn = cfg.fn;
+    int size = 0;
+    for (int b : loop.blocks)
+        for (const TACObject &taco : cfg.blocks[b].code)
+            size += taco.op != op_Label;
+    const TACObject *def;
+    int switched = size <= limit ? invariantBranch(cfg, loop, inLoop, loopDefs, def) : -1;
+    if (switched < 0)
+        return false;
+
+    // the temps of the loop are renamed in the copy, so the code after it
+    // may not read them
+    if (!tempsKeptIn(cfg, loop.blocks, uses))
+        return false;
+    unordered_map<int, Operand> temps;
+    for (int b : loop.blocks)
+        for (const TACObject &taco : cfg.blocks[b].code) {
+            int d = DefinedReg(taco);
+            if (d >= 0 && fn.regs[d].name < 0)
+                temps[d] = Operand();
+        }
+
+    // the preheader tests the condition, computing it first if the loop does
+    TACObject test(op_IfGoto, Operand(), cfg.blocks[switched].code.back().a);
+    vector<TACObject> guard;
+    if (def != NULL)
+        guard.push_back(*def);
+    int pre = preheader(cfg, loop, inLoop);
+    if (pre < 0)
+        return false;
+    inLoop.resize(cfg.blocks.size(), false);
+    if (!guard.empty())
+        guard.back().dst = test.a = Node::NewTemp(fn);
+    for (auto &temp : temps)
+        temp.second = Node::NewTemp(fn);
+
+    // the loop blocks in layout order, and their copies
+    vector<int> blocks = loop.blocks;
+    sort(blocks.begin(), blocks.end(), [&](int x, int y) { return position[x] < position[y]; });
+    unordered_map<int, int> copyOf;
+    unordered_map<int, int> labels;
+    for (int b : blocks) {
+        copyOf[b] = cfg.NewBlock();
+        if (cfg.blocks[b].label >= 0)
+            labels[cfg.blocks[b].label] = cfg.blocks[copyOf[b]].label;
+    }
+
+    // where each block falls through to, before the layout changes
+    unordered_map<int, int> next;
+    for (int b : blocks)
+        if (fallsThrough(cfg.blocks[b]) && position[b] + 1 < layout.size())
+            next[b] = layout[position[b] + 1];
+
+    for (int k = 0; k < blocks.size(); k++) {
+        const BasicBlock &block = cfg.blocks[blocks[k]];
+        vector<TACObject> &code = cfg.blocks[copyOf[blocks[k]]].code;
+        for (TACObject taco : block.code) {
+            if (taco.op == op_Label)
+                continue;
+            if (taco.dst.kind == opnd_Label && labels.count(taco.dst.value))
+                taco.dst = Operand::Label(labels[taco.dst.value]);
+            for (Operand *o : { &taco.dst, &taco.a, &taco.b })
+                if (o->IsReg() && temps.count(o->value))
+                    *o = temps[o->value];
+            code.push_back(taco);
+        }
+        if (blocks[k] == switched)
+            code.pop_back();
+        if ((blocks[k] == switched || fallsThrough(block)) && next.count(blocks[k])) {
+            int to = next[blocks[k]];
+            if (k + 1 == blocks.size() || blocks[k + 1] != to)
+                code.emplace_back(op_Goto, Operand::Label(inLoop[to] ? cfg.blocks[copyOf[to]].label
+                                                                     : labelOf(cfg.blocks[to])));
+        }
+    }
+    TACObject &branch = cfg.blocks[switched].code.back();
+    branch = TACObject(op_Goto, branch.dst);
+
+    // the copy goes after the loop, the block that was there is jumped to
+    int at = find(cfg.layout.begin(), cfg.layout.end(), blocks.back()) - cfg.layout.begin() + 1;
+    if (fallsThrough(cfg.blocks[blocks.back()]) && at < cfg.layout.size())
+        cfg.blocks[blocks.back()].code.emplace_back(op_Goto, Operand::Label(labelOf(cfg.blocks[cfg.layout[at]])));
+    for (int b : blocks)
+        cfg.layout.insert(cfg.layout.begin() + at++, copyOf[b]);
+
+    test.dst = Operand::Label(labelOf(cfg.blocks[loop.header]));
+    guard.push_back(test);
+    guard.emplace_back(op_Goto, Operand::Label(cfg.blocks[copyOf[loop.header]].label));
+    vector<TACObject> &code = cfg.blocks[pre].code;
+    if (!code.empty() && code.back().op == op_Goto)
+        code.pop_back();
+    code.insert(code.end(), guard.begin(), guard.end());
+    return true;
+}
+
+void loopUnswitching(TACFunction &fn) {
+    int limit = GetOption("unswitch-limit", DefaultUnswitchLimit);
+    int unswitched = 0;
+    forEachLoop(fn, [&](CFG &cfg, const vector<const Loop *> &round) {
+        vector<int> uses = countUses(cfg);
+        vector<int> layout = cfg.layout;
+        vector<int> position = layoutPositions(cfg);
+        vector<bool> inLoop;
+        LoopDefinitions loopDefs(fn);
+        int before = unswitched;
+        for (const Loop *loop : round) {
+            markLoop(inLoop, cfg, *loop, true);
+            unswitched += unswitchLoop(cfg, *loop, inLoop, loopDefs, uses, layout, position, limit);
+            markLoop(inLoop, cfg, *loop, false);
+        }
+        return unswitched > before;
+    });
+
+    PrintDebug("unswitch", "%s: %d loops unswitched",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", unswitched);
+}
@@ -0,0 +1,98 @@
+/**
+ * File: loops.h
+ * -------------
+ * Optimizations of the natural loops found by the CFG.
+ *
+ * A loop is given a preheader before it is transformed: a block that is
+ * the only way into the header from outside the loop and that falls
+ * through to it. The block before the loop is reused when it only leads to
+ * the header, otherwise a new block is laid out right before the header
+ * and the branches entering the loop are sent to it.
+ */
+
+#ifndef _H_loops
+#define _H_loops
+
+#include "cfg.h"
+
+/**
+ * Loop invariant code motion. A computation is invariant when each of its
+ * operands is a constant or only reached by definitions outside the loop,
+ * or by a single definition inside it that is itself invariant. Global
+ * variables are never invariant in a loop that calls a function. Invariant
+ * computations are moved to the preheader, innermost loops first, when
+ * their register is local, defined once in the loop, not live on entry and
+ * not read after the loop unless the computation runs on every way out.
+ * Calls, prints and reads stay where they are, and so does a division
+ * unless it is by a nonzero constant.
+ *
+ * @param fn : the function to optimize
+ */
+void loopInvariantCodeMotion(TACFunction &fn);
+
+/**
+ * Induction variables. A basic induction variable is a local variable
+ * whose only definition in the loop adds a constant to it; a derived one is
+ * a basic one times an invariant factor. Each derived variable gets a
+ * register initialized in the preheader and stepped right after its basic
+ * variable, so the multiplication becomes an addition.
+ *
+ * Exit tests comparing a basic variable with an invariant bound are
+ * rewritten: to compare a derived variable with the bound scaled ahead of
+ * time when the constant start, step and bound show that nothing wraps
+ * around, and otherwise from <= and >= to the strict comparison (with the
+ * constant bound moved by one, or the branch inverted). A basic variable
+ * left with no use in the loop but its own step, and not read after it,
+ * is removed.
+ *
+ * @param fn : the function to optimize
+ */
+void strengthReduction(TACFunction &fn);
+
+/**
+ * Loop unrolling of counted loops: innermost loops whose header only tests
+ * a basic induction variable against an invariant bound, and whose body
+ * leaves them only by returning.
+ *
+ * A loop that runs a known number of times (a constant start and bound)
+ * is replaced by that many copies of its body when they come to at most
+ * -funroll-limit=N instructions (48 by default), for constant propagation
+ * to fold. Otherwise -funroll-factor=N copies (4 by default) run in a loop
+ * of their own, with its test at the bottom, for as long as all of them
+ * stay within the bound; the original loop follows for the iterations
+ * left. Each copy gets fresh temps and labels.
+ *
+ * @param fn : the function to optimize
+ */
+void loopUnrolling(TACFunction &fn);
+
+/**
+ * Loop rotation. A loop tested at the top runs the test, a branch into the
+ * body and a jump back to the test on every iteration. Rotated, the header
+ * is only the guard run on the way in, and each jump back to it is
+ * replaced by a copy of the test (with fresh temps) branching back into the
+ * body, so an iteration runs a single branch. Loops whose test, the header
+ * but its label, has more than -frotate-limit=N instructions (8 by
+ * default) are left alone, as are loops whose test computes temps read
+ * elsewhere.
+ *
+ * @param fn : the function to optimize
+ */
+void loopRotation(TACFunction &fn);
+
+/**
+ * Loop unswitching. A branch in a loop on a condition the loop doesn't
+ * change, both ways staying in the loop, is taken out of it: the loop is
+ * copied (fresh labels and temps), the branch always goes one way in the
+ * original and the other way in the copy, and the preheader tests the
+ * condition once to run one of them. A condition computed in the loop from
+ * operands it doesn't assign is computed again in the preheader. Loops of
+ * more than -funswitch-limit=N instructions (32 by default) are left
+ * alone, as are loops whose temps are read after them; each loop is
+ * unswitched on one condition at most per run.
+ *
+ * @param fn : the function to optimize
+ */
+void loopUnswitching(TACFunction &fn);
+
+#endif
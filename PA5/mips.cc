@@ -0,0 +1,411 @@
+/**
+ * File: mips.cc
+ * -------------
+ * The MIPS instruction list and its peephole rules.
+ */
+
+#include "mips.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+static string trim(const string &s) {
+    size_t begin = s.find_first_not_of(" \t");
+    if (begin == string::npos)
+        return "";
+    return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+}
+
+void MIPSCode::Add(const string &text) {
+    istringstream lines(text);
+    string line;
+    while (getline(lines, line)) {
+        string body = trim(line);
+        if (body.empty())
+            continue;
+
+        MIPSInstruction instr;
+        if (line[0] != ' ' && line[0] != '\t') {
+            bool label = body.back() == ':' && body.find_first_of(" \t") == string::npos;
+            instr.kind = label ? mips_Label : mips_Verbatim;
+            instr.op = label ? body.substr(0, body.size() - 1) : line;
+        } else if (body[0] == '#') {
+            instr.kind = mips_Comment;
+            instr.op = trim(body.substr(1));
+        } else {
+            instr.kind = mips_Instruction;
+            size_t space = body.find_first_of(" \t");
+            instr.op = body.substr(0, space);
+            string args = space == string::npos ? "" : body.substr(space);
+            istringstream list(args);
+            string arg;
+            while (getline(list, arg, ','))
+                instr.args.push_back(trim(arg));
+        }
+        code.push_back(instr);
+    }
+}
+
+void MIPSCode::Print(ostream &out) const {
+    for (const MIPSInstruction &instr : code) {
+        switch (instr.kind) {
+            case mips_Label:        out << instr.op << ":" << endl; break;
+            case mips_Comment:      out << "  # " << instr.op << endl; break;
+            case mips_Verbatim:     out << instr.op << endl; break;
+            case mips_Removed:      break;
+            case mips_Instruction:
+                out << "  " << instr.op;
+                for (int i = 0; i < instr.args.size(); i++)
+                    out << (i == 0 ? " " : ", ") << instr.args[i];
+                out << endl;
+                break;
+        }
+    }
+}
+
+void MIPSCode::Clear() {
+    code.clear();
+}
+
+int MIPSCode::Size() const {
+    int size = 0;
+    for (const MIPSInstruction &instr : code)
+        size += instr.kind == mips_Instruction;
+    return size;
+}
+
+/*
+ * What an instruction reads and writes. The first operand is the one
+ * written, except for stores and branches; a memory operand k($r) reads r.
+ */
+
+static bool isInteger(const string &s, int &value) {
+    if (s.empty())
+        return false;
+    char *end;
+    value = strtol(s.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+static bool fitsImmediate(int value) {
+    return value >= -32768 && value <= 32767;
+}
+
+// k($r), the address of a load or store
+static bool memoryOperand(const string &arg, int &offset, string &base) {
+    size_t open = arg.find('(');
+    if (open == string::npos || arg.back() != ')' || !isInteger(arg.substr(0, open), offset))
+        return false;
+    base = arg.substr(open + 1, arg.size() - open - 2);
+    return true;
+}
+
+// The branch taken exactly when the given one isn't, NULL if op is no conditional branch
+static const char *invertedBranch(const string &op) {
+    static const char *pairs[][2] = {
+        { "beq", "bne" }, { "blez", "bgtz" }, { "bltz", "bgez" }
+    };
+    for (const auto &pair : pairs) {
+        if (op == pair[0])
+            return pair[1];
+        if (op == pair[1])
+            return pair[0];
+    }
+    return NULL;
+}
+
+static bool isControl(const MIPSInstruction &instr) {
+    const string &op = instr.op;
+    return op == "j" || op == "jal" || op == "jr" || op == "syscall" || invertedBranch(op) != NULL;
+}
+
+static bool isStore(const MIPSInstruction &instr) {
+    return instr.op == "sw" || instr.op == "sb";
+}
+
+static bool writes(const MIPSInstruction &instr, const string &reg) {
+    if (instr.kind != mips_Instruction || isControl(instr) || isStore(instr))
+        return false;
+    return !instr.args.empty() && instr.args[0] == reg;
+}
+
+static bool reads(const MIPSInstruction &instr, const string &reg) {
+    if (instr.kind != mips_Instruction)
+        return false;
+    bool sources = isControl(instr) || isStore(instr);
+    for (int i = sources ? 0 : 1; i < instr.args.size(); i++) {
+        int offset;
+        string base;
+        if (instr.args[i] == reg || (memoryOperand(instr.args[i], offset, base) && base == reg))
+            return true;
+    }
+    return false;
+}
+
+// The next instruction or label after i, skipping comments, or -1
+static int next(const vector<MIPSInstruction> &code, int i) {
+    for (i++; i < code.size(); i++)
+        if (code[i].kind != mips_Comment && code[i].kind != mips_Removed)
+            return i;
+    return -1;
+}
+
+// The line before i that is still there, or -1
+static int previous(const vector<MIPSInstruction> &code, int i) {
+    for (i--; i >= 0; i--)
+        if (code[i].kind != mips_Removed)
+            return i;
+    return -1;
+}
+
+// Takes instruction i out; Peephole drops it at the end of the sweep
+static void remove(vector<MIPSInstruction> &code, int i) {
+    code[i].kind = mips_Removed;
+    code[i].args.clear();
+}
+
+static bool isInstruction(const vector<MIPSInstruction> &code, int i, const char *op) {
+    return i >= 0 && i < code.size() && code[i].kind == mips_Instruction && code[i].op == op;
+}
+
+/**
+ * Returns true if the register is written before it is read in the
+ * straight-line code after instruction i. Anything that leaves that code
+ * (or a syscall, which reads registers of its own) counts as a read.
+ */
+static bool deadAfter(const vector<MIPSInstruction> &code, int i, const string &reg) {
+    for (int k = next(code, i); k >= 0; k = next(code, k)) {
+        const MIPSInstruction &instr = code[k];
+        if (instr.kind != mips_Instruction || isControl(instr) || reads(instr, reg))
+            return false;
+        if (writes(instr, reg))
+            return true;
+    }
+    return false;
+}
+
+static void replaceReads(MIPSInstruction &instr, const string &from, const string &to) {
+    bool sources = isControl(instr) || isStore(instr);
+    for (int i = sources ? 0 : 1; i < instr.args.size(); i++) {
+        int offset;
+        string base;
+        if (instr.args[i] == from)
+            instr.args[i] = to;
+        else if (memoryOperand(instr.args[i], offset, base) && base == from)
+            instr.args[i] = to_string(offset) + "(" + to + ")";
+    }
+}
+
+/*
+ * The rules. Each looks at the instruction at i and the ones after it and
+ * returns true when it rewrote them.
+ */
+
+// move $a, $a
+static bool selfMove(vector<MIPSInstruction> &code, int i) {
+    if (!isInstruction(code, i, "move") || code[i].args[0] != code[i].args[1])
+        return false;
+    remove(code, i);
+    return true;
+}
+
+// move $a, $b; move $b, $a: the second one copies back what's there
+static bool moveBack(vector<MIPSInstruction> &code, int i) {
+    int j = next(code, i);
+    if (!isInstruction(code, i, "move") || !isInstruction(code, j, "move") ||
+        code[i].args[0] != code[j].args[1] || code[i].args[1] != code[j].args[0])
+        return false;
+    remove(code, j);
+    return true;
+}
+
+// addi $a, $a, 0
+static bool addZero(vector<MIPSInstruction> &code, int i) {
+    if (!isInstruction(code, i, "addi") || code[i].args[0] != code[i].args[1] || code[i].args[2] != "0")
+        return false;
+    remove(code, i);
+    return true;
+}
+
+/**
+ * addi $sp, $sp, c moved down to the next addi $sp, $sp, d and merged with
+ * it, over straight-line code that only uses $sp to address memory; the
+ * offsets of that code are moved by c. One PushParam after another
+ * becomes the stores of all the arguments and a single addi.
+ */
+static bool mergeStackAdjust(vector<MIPSInstruction> &code, int i) {
+    int c;
+    if (!isInstruction(code, i, "addi") || code[i].args[0] != "$sp" || code[i].args[1] != "$sp" ||
+        !isInteger(code[i].args[2], c))
+        return false;
+
+    int j = next(code, i);
+    for (; j >= 0; j = next(code, j)) {
+        const MIPSInstruction &instr = code[j];
+        if (instr.kind != mips_Instruction || isControl(instr))
+            return false;
+        if (instr.op == "addi" && instr.args[0] == "$sp" && instr.args[1] == "$sp")
+            break;
+        if (writes(instr, "$sp"))
+            return false;
+        for (const string &arg : instr.args) {
+            int offset;
+            string base;
+            if (arg == "$sp" || (memoryOperand(arg, offset, base) && base == "$sp" && !fitsImmediate(offset + c)))
+                return false;
+        }
+    }
+    int d;
+    if (j < 0 || !isInteger(code[j].args[2], d) || !fitsImmediate(c + d))
+        return false;
+
+    for (int k = i + 1; k < j; k++) {
+        for (string &arg : code[k].args) {
+            int offset;
+            string base;
+            if (memoryOperand(arg, offset, base) && base == "$sp")
+                arg = to_string(offset + c) + "($sp)";
+        }
+    }
+    code[j].args[2] = to_string(c + d);
+    remove(code, i);
+    return true;
+}
+
+/**
+ * li $r, c followed by the one instruction reading $r: an add becomes an
+ * addi, a move becomes the li itself and a store of 0 stores $zero.
+ */
+static bool foldImmediate(vector<MIPSInstruction> &code, int i) {
+    int c;
+    if (!isInstruction(code, i, "li") || !isInteger(code[i].args[1], c))
+        return false;
+    string r = code[i].args[0];
+    int j = next(code, i);
+    if (j < 0 || code[j].kind != mips_Instruction || !reads(code[j], r))
+        return false;
+    MIPSInstruction &use = code[j];
+    if (!writes(use, r) && !deadAfter(code, j, r))
+        return false;
+
+    if (use.op == "add" && fitsImmediate(c) && (use.args[1] == r) != (use.args[2] == r)) {
+        string other = use.args[1] == r ? use.args[2] : use.args[1];
+        use.op = "addi";
+        use.args = { use.args[0], other, to_string(c) };
+    } else if (use.op == "move" && use.args[1] == r) {
+        use.op = "li";
+        use.args[1] = to_string(c);
+    } else if (isStore(use) && c == 0 && use.args[0] == r) {
+        use.args[0] = "$zero";
+    } else {
+        return false;
+    }
+    remove(code, i);
+    return true;
+}
+
+/**
+ * move $d, $s followed by an instruction reading $d, after which $d is
+ * dead: the instruction reads $s instead and the move goes.
+ */
+static bool forwardMove(vector<MIPSInstruction> &code, int i) {
+    if (!isInstruction(code, i, "move"))
+        return false;
+    string d = code[i].args[0], s = code[i].args[1];
+    int j = next(code, i);
+    if (d == s || j < 0 || code[j].kind != mips_Instruction || isControl(code[j]) || !reads(code[j], d))
+        return false;
+    if (!writes(code[j], d) && !deadAfter(code, j, d))
+        return false;
+    replaceReads(code[j], d, s);
+    remove(code, i);
+    return true;
+}
+
+// Whether one of the labels starting at i (before any instruction) is the given one
+static bool labelFollows(const vector<MIPSInstruction> &code, int i, const string &label) {
+    for (; i >= 0 && code[i].kind == mips_Label; i = next(code, i))
+        if (code[i].op == label)
+            return true;
+    return false;
+}
+
+// j L right before L:
+static bool jumpToNext(vector<MIPSInstruction> &code, int i) {
+    if (!isInstruction(code, i, "j") || !labelFollows(code, next(code, i), code[i].args[0]))
+        return false;
+    remove(code, i);
+    return true;
+}
+
+// bne $a, $b, L1; j L2; L1: becomes beq $a, $b, L2; L1: (and likewise for
+// the other conditional branches)
+static bool branchOverJump(vector<MIPSInstruction> &code, int i) {
+    int j = next(code, i);
+    if (i >= code.size() || code[i].kind != mips_Instruction || invertedBranch(code[i].op) == NULL ||
+        !isInstruction(code, j, "j") || !labelFollows(code, next(code, j), code[i].args.back()))
+        return false;
+    code[i].op = invertedBranch(code[i].op);
+    code[i].args.back() = code[j].args[0];
+    remove(code, j);
+    return true;
+}
+
+// Instructions after j or jr that no label leads to
+static bool unreachable(vector<MIPSInstruction> &code, int i) {
+    if (!isInstruction(code, i, "j") && !isInstruction(code, i, "jr"))
+        return false;
+    int j = next(code, i);
+    if (j < 0 || code[j].kind != mips_Instruction)
+        return false;
+    remove(code, j);
+    return true;
+}
+
+struct PeepholeRule {
+    const char *name;
+    bool (*apply)(vector<MIPSInstruction> &code, int i);
+};
+
+static const PeepholeRule rules[] = {
+    { "self-move",          selfMove },
+    { "move-back",          moveBack },
+    { "add-zero",           addZero },
+    { "merge-sp-adjust",    mergeStackAdjust },
+    { "fold-immediate",     foldImmediate },
+    { "forward-move",       forwardMove },
+    { "jump-to-next",       jumpToNext },
+    { "branch-over-jump",   branchOverJump },
+    { "unreachable",        unreachable },
+};
+static const int NumRules = sizeof(rules) / sizeof(rules[0]);
+
+void MIPSCode::Peephole() {
+    applied.resize(NumRules, 0);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < code.size(); i++) {
+            for (int r = 0; r < NumRules; r++) {
+                if (rules[r].apply(code, i)) {
+                    applied[r]++;
+                    changed = true;
+                    // the rewrite may let a rule match a little earlier
+                    for (int back = 0; back < 3 && i >= 0; back++)
+                        i = previous(code, i);
+                    break;
+                }
+            }
+        }
+        code.erase(remove_if(code.begin(), code.end(),
+                             [](const MIPSInstruction &instr) { return instr.kind == mips_Removed; }),
+                   code.end());
+    }
+}
+
+void MIPSCode::PrintReport(ostream &out) const {
+    for (int r = 0; r < applied.size(); r++)
+        if (applied[r] > 0)
+            out << "  " << setw(20) << left << rules[r].name << right << setw(6) << applied[r] << endl;
+}
@@ -0,0 +1,63 @@
+/**
+ * File: mips.h
+ * ------------
+ * The MIPS code of a function as a list of instructions, built by the
+ * code generator and printed once it is done, and the peephole optimizer
+ * that runs over it in between.
+ *
+ * The peephole optimizer slides over the list trying a table of rules,
+ * each of which looks at a few instructions from the current one and
+ * rewrites them in place. After a rewrite it steps back so the rules see
+ * the new neighbours, and it stops when no rule matches anywhere. The
+ * instructions a rule takes out are only marked removed and dropped once
+ * the sweep is over, so a rewrite costs the same however long the code
+ * is. Labels, branches, jumps and calls end the straight-line code a rule
+ * may look through; lines the generator passes through as they are
+ * (debugging output, errors) end it too.
+ */
+
+#ifndef _H_mips
+#define _H_mips
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+enum mipskind { mips_Instruction, mips_Label, mips_Comment, mips_Verbatim, mips_Removed };
+
+struct MIPSInstruction {
+    mipskind kind;
+    string op;                  // mnemonic, the label's name, the comment or the verbatim line
+    vector<string> args;        // operands as written: $t0, 4($sp), 12, L3
+};
+
+class MIPSCode {
+  public:
+    /**
+     * Appends assembly text, one or more lines of it: an indented line is
+     * an instruction (or a comment if it starts with #), a name followed
+     * by a colon is a label, and anything else is kept as it is.
+     */
+    void Add(const string &text);
+
+    // Runs the peephole rules until none of them matches
+    void Peephole();
+
+    void Print(ostream &out) const;
+
+    // Drops the code, the counts of the rules applied add up over what follows
+    void Clear();
+
+    // The number of instructions, leaving out labels, comments and verbatim lines
+    int Size() const;
+
+    // How many times each rule was applied, in all
+    void PrintReport(ostream &out) const;
+
+  private:
+    vector<MIPSInstruction> code;
+    vector<int> applied;        // per rule
+};
+
+#endif
@@ -49,7 +49,7 @@ void yyerror(const char *msg); // standard error-handling routine
     List<VarDecl*> *varDeclList;
     FnDecl *fnDecl;
     Decl *decl;
-    List<Decl*> *declList;
+    Program *program;
 
     Operator *oper;
     Expr *expr;
@@ -122,7 +122,7 @@ void yyerror(const char *msg); // standard error-handling routine
  * of the union named "declList" which is of type List<Decl*>.
  * pp2: You'll need to add many of these of your own.
  */
-%type <declList>     DeclList
+%type <program>      DeclList
 %type <decl>         Decl
 %type <varDecl>      SingleDecl 
 %type <varType>      TypeSpecifier
@@ -174,17 +174,16 @@ Program   :    DeclList   {
                             /* pp2: The @1 is needed to convince
                             * yacc to set up yylloc. You can remove
                             * it once you have other uses of @n*/
-                            Program *program = new Program($1);
                             if (ReportError::NumErrors() == 0) {
-                                // program->Print(0);
                                 // program->Check();
-                                program->Emit();
+                                $1->Emit();
                             }
                           }
           ;
 
-DeclList  :    DeclList Decl       { ($$=$1)->Append($2); } 
-          |    Decl                { ($$ = new List<Decl*>)->Append($1); } 
+/* Each declaration is compiled as soon as it is parsed */
+DeclList  :    DeclList Decl       { ($$=$1)->Compile($2); } 
+          |    Decl                { ($$ = new Program)->Compile($1); } 
           ;
 
 Decl      :    SingleDecl          { $$ = $1; } 
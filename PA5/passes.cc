@@ -0,0 +1,185 @@
+/**
+ * File: passes.cc
+ * ---------------
+ * Running pipelines of passes, and the report of what each one did.
+ */
+
+#include "passes.h"
+#include "utility.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <tuple>
+#include <unordered_map>
+
+static const int DefaultPassIterations = 4;
+
+void PassManager::Register(const char *name, FunctionPass pass) {
+    Pass p;
+    p.name = name;
+    p.function = pass;
+    passes.push_back(p);
+}
+
+static void pipelineError(const string &pipeline, const string &message) {
+    fprintf(stderr, "Incorrect pipeline \"%s\": %s\n", pipeline.c_str(), message.c_str());
+    exit(2);
+}
+
+vector<PassManager::Stage> PassManager::Parse(const string &pipeline, size_t &pos, bool nested) const {
+    vector<Stage> stages;
+    while (pos < pipeline.size()) {
+        Stage stage;
+        if (pipeline[pos] == '(') {
+            stage.pass = -1;
+            stage.group = Parse(pipeline, ++pos, true);
+            if (pos >= pipeline.size() || pipeline[pos] != ')')
+                pipelineError(pipeline, "missing )");
+            pos++;
+        } else {
+            size_t end = pipeline.find_first_of(",()", pos);
+            if (end == string::npos)
+                end = pipeline.size();
+            string name = pipeline.substr(pos, end - pos);
+            stage.pass = -1;
+            for (int p = 0; p < passes.size(); p++)
+                if (passes[p].name == name)
+                    stage.pass = p;
+            if (stage.pass < 0) {
+                string known;
+                for (const Pass &p : passes)
+                    known += " " + p.name;
+                pipelineError(pipeline, "unknown pass \"" + name + "\", the passes are" + known);
+            }
+            pos = end;
+        }
+        stages.push_back(stage);
+
+        if (pos < pipeline.size() && pipeline[pos] == ')') {
+            if (!nested)
+                pipelineError(pipeline, "unbalanced )");
+            return stages;
+        }
+        if (pos < pipeline.size() && pipeline[pos++] != ',')
+            pipelineError(pipeline, "expected , between passes");
+    }
+    return stages;
+}
+
+void PassManager::Run(TACFunction &fn, const string &pipeline) {
+    size_t pos = 0;
+    for (const Stage &stage : Parse(pipeline, pos, false))
+        RunStage(fn, stage);
+}
+
+typedef tuple<int, int, int, int, int, int, int> InstructionKey;
+
+/**
+ * The instructions of the code as keys to compare them by. With canonical
+ * set, temps are numbered in the order they are first used instead:
+ * leaving SSA makes new temps to order copies on every run, so code that
+ * has settled can still come out with other temps.
+ */
+static vector<InstructionKey> keysOf(const TACFunction &fn, const vector<TACObject> &code, bool canonical) {
+    unordered_map<int, int> temps;      // temp -> order of first use
+    auto number = [&](Operand o) {
+        if (!canonical || !o.IsReg() || fn.regs[o.value].name >= 0)
+            return o;
+        if (temps.find(o.value) == temps.end()) {
+            int n = temps.size();
+            temps[o.value] = n;
+        }
+        return Operand::Reg(-1 - temps[o.value]);
+    };
+
+    vector<InstructionKey> keys;
+    keys.reserve(code.size());
+    for (const TACObject &taco : code) {
+        Operand dst = number(taco.dst), a = number(taco.a), b = number(taco.b);
+        keys.emplace_back(taco.op, dst.kind, dst.value, a.kind, a.value, b.kind, b.value);
+    }
+    return keys;
+}
+
+// Instructions of the code before that are still there after
+static int kept(vector<InstructionKey> x, vector<InstructionKey> y) {
+    sort(x.begin(), x.end());
+    sort(y.begin(), y.end());
+
+    int common = 0;
+    for (int i = 0, j = 0; i < x.size() && j < y.size(); ) {
+        if (x[i] < y[j])
+            i++;
+        else if (y[j] < x[i])
+            j++;
+        else
+            common++, i++, j++;
+    }
+    return common;
+}
+
+// Returns true if the code is the same, but for the numbers of its temps
+static bool sameCode(const TACFunction &fn, const vector<TACObject> &x, const vector<TACObject> &y) {
+    return x.size() == y.size() && keysOf(fn, x, true) == keysOf(fn, y, true);
+}
+
+void PassManager::RunStage(TACFunction &fn, const Stage &stage) {
+    if (stage.pass >= 0) {
+        RunPass(fn, passes[stage.pass]);
+        return;
+    }
+
+    // a round counts as a change only when the code it ends with differs
+    // from the code it started with: leaving SSA adds copies that dead
+    // code elimination takes out again
+    int limit = GetOption("pass-iterations", DefaultPassIterations);
+    for (int round = 0; round < limit; round++) {
+        vector<TACObject> before = fn.code;
+        for (const Stage &s : stage.group)
+            RunStage(fn, s);
+        if (sameCode(fn, before, fn.code))
+            break;
+    }
+}
+
+void PassManager::RunPass(TACFunction &fn, Pass &pass) {
+    vector<TACObject> before = fn.code;
+
+    auto start = chrono::steady_clock::now();
+    pass.function(fn);
+    pass.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    pass.runs++;
+
+    if (sameCode(fn, before, fn.code))
+        return;
+
+    // a pass that renumbers temps leaves instructions the same but for
+    // them, one that moves code keeps their numbers but not the order they
+    // are first used in: what is kept is the most either way finds
+    int common = max(kept(keysOf(fn, before, false), keysOf(fn, fn.code, false)),
+                     kept(keysOf(fn, before, true), keysOf(fn, fn.code, true)));
+    pass.removed += before.size() - common;
+    pass.added += fn.code.size() - common;
+}
+
+void PassManager::PrintReport(ostream &out) const {
+    double total = 0;
+    for (const Pass &p : passes)
+        total += p.seconds;
+
+    out << "===--- Pass execution report ---===" << endl;
+    out << setw(12) << left << "Pass" << right << setw(6) << "Runs" << setw(12) << "Time (ms)"
+        << setw(8) << "%" << setw(10) << "Removed" << setw(10) << "Added" << endl;
+    for (const Pass &p : passes) {
+        if (p.runs == 0)
+            continue;
+        out << setw(12) << left << p.name << right << setw(6) << p.runs
+            << setw(12) << fixed << setprecision(3) << p.seconds * 1000
+            << setw(8) << setprecision(1) << (total > 0 ? 100 * p.seconds / total : 0)
+            << setw(10) << p.removed << setw(10) << p.added << endl;
+    }
+    out << setw(12) << left << "Total" << right << setw(6) << "" << setw(12) << setprecision(3)
+        << total * 1000 << endl;
+}
@@ -0,0 +1,66 @@
+/**
+ * File: passes.h
+ * --------------
+ * The pass manager. Optimization passes are registered under a name and
+ * run on each function in the order a pipeline gives them:
+ *
+ *     tre,inline,fold,(constprop,gvn,dce),licm
+ *
+ * A parenthesized list of passes is run again until a round of it ends
+ * with the code it started with (or for -fpass-iterations=N rounds, 4 by
+ * default), for passes that clean up after each other.
+ *
+ * Each pass is timed, and the instructions it removed and added are
+ * counted by comparing the code before and after it, temps matched by
+ * number or by the order they are first used in, so a report can show
+ * what a pass costs and what it buys.
+ */
+
+#ifndef _H_passes
+#define _H_passes
+
+#include "tac.h"
+#include <iostream>
+
+typedef void (*FunctionPass)(TACFunction &fn);
+
+class PassManager {
+  public:
+    void Register(const char *name, FunctionPass pass);
+
+    /**
+     * Runs the passes of the pipeline on a function. An unknown pass name
+     * or an unbalanced parenthesis is reported and ends the compilation.
+     * The time and changes of each pass add up over the functions it ran on.
+     *
+     * @param fn       : the function, or the top-level code
+     * @param pipeline : pass names separated by commas
+     */
+    void Run(TACFunction &fn, const string &pipeline);
+
+    // The time, runs and changes of each pass that ran
+    void PrintReport(ostream &out) const;
+
+  private:
+    struct Pass {
+        string name;
+        FunctionPass function;
+        int runs = 0;
+        double seconds = 0;
+        int removed = 0, added = 0;     // instructions
+    };
+
+    // A pass, or a group of stages repeated until nothing changes
+    struct Stage {
+        int pass;                       // -1 for a group
+        vector<Stage> group;
+    };
+
+    vector<Pass> passes;
+
+    vector<Stage> Parse(const string &pipeline, size_t &pos, bool nested) const;
+    void RunStage(TACFunction &fn, const Stage &stage);
+    void RunPass(TACFunction &fn, Pass &pass);
+};
+
+#endif
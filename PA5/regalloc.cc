@@ -0,0 +1,727 @@
+/**
+ * File: regalloc.cc
+ * -----------------
+ * Live intervals and the linear scan register allocator.
+ */
+
+#include "regalloc.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "utility.h"
+#include <algorithm>
+#include <climits>
+
+const char *const MachineRegisters[NumMachineRegisters] = {
+    "t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7", "t8", "t9",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7"
+};
+
+/*
+ * Positions: instruction i reads its operands at 2i and writes its result
+ * at 2i + 1, so an interval read for the last time by an instruction ends
+ * before the one it writes starts, while one live past it doesn't.
+ */
+static int readAt(int i)  { return 2 * i; }
+static int writeAt(int i) { return 2 * i + 1; }
+
+// The part of the code a virtual register is live in
+struct Interval {
+    int reg;            // virtual register
+    int start, end;     // positions, both included
+    double weight;      // the reads and writes, each weighed by the loop depth it is at
+    int hint;           // register copied to or from it, -1 if none
+};
+
+// How often the block is expected to run: 10 times per loop it is in
+static double frequencyOf(const CFG &cfg, const BasicBlock &block) {
+    double frequency = 1;
+    for (int depth = block.loop >= 0 ? cfg.loops[block.loop].depth : 0; depth > 0; depth--)
+        frequency *= 10;
+    return frequency;
+}
+
+// For each call, the local registers live once it returns but the one it sets
+static vector<vector<int>> liveAcrossCalls(const CFG &cfg, const Liveness &liveness) {
+    const TACFunction &fn = cfg.fn;
+    vector<vector<int>> across(fn.code.size());
+    int first = 0;
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+        const vector<TACObject> &code = cfg.blocks[b].code;
+        if (cfg.IsReachable(b)) {
+            BitSet live = liveness.LiveOut(b);
+            for (int i = code.size() - 1; i >= 0; i--) {
+                if (code[i].op == op_Call)
+                    for (int r = live.Next(0); r < live.Size(); r = live.Next(r + 1))
+                        if (r != code[i].dst.value && fn.IsLocal(r))
+                            across[first + i].push_back(r);
+                liveness.Transfer(code[i], live);
+            }
+        }
+        first += code.size();
+    }
+    return across;
+}
+
+/**
+ * The free register a value goes in: an $s one if it is live across a
+ * call, as the callee keeps it, else a $t one, as saving it costs
+ * nothing; the other kind if none is free. NumMachineRegisters if all are
+ * taken.
+ */
+static int freeRegister(const vector<bool> &taken, bool acrossCall) {
+    for (int pass = 0; pass < 2; pass++)
+        for (int machine = 0; machine < NumMachineRegisters; machine++)
+            if (!taken[machine] && (machine >= FirstCalleeSaved) == (acrossCall != (pass == 1)))
+                return machine;
+    return NumMachineRegisters;
+}
+
+// Spill weight per position covered: a long interval read now and then
+// frees its register for more of the code than a short one read as often
+static double spillCost(const Interval &interval) {
+    return interval.weight / (interval.end - interval.start + 1);
+}
+
+// The intervals of the local registers the code refers to, ordered by start
+static vector<Interval> liveIntervals(const CFG &cfg, const Liveness &liveness) {
+    const TACFunction &fn = cfg.fn;
+    int n = fn.regs.size();
+    vector<Interval> intervals(n);
+    for (int r = 0; r < n; r++)
+        intervals[r] = { r, INT_MAX, -1, 0, -1 };
+    auto extend = [&](int r, int position) {
+        intervals[r].start = min(intervals[r].start, position);
+        intervals[r].end = max(intervals[r].end, position);
+    };
+
+    int i = 0;
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+        const BasicBlock &block = cfg.blocks[b];
+        int first = i, last = i + block.code.size() - 1;
+        if (cfg.IsReachable(b)) {
+            const BitSet &in = liveness.in[b], &out = liveness.out[b];
+            for (int k = in.Next(0); k < in.Size(); k = in.Next(k + 1))
+                extend(liveness.regs[k], readAt(first));
+            for (int k = out.Next(0); k < out.Size(); k = out.Next(k + 1))
+                extend(liveness.regs[k], writeAt(last));
+        }
+
+        double frequency = frequencyOf(cfg, block);
+        for (const TACObject &taco : block.code) {
+            for (const Operand *o : { &taco.a, &taco.b }) {
+                if (o->IsReg()) {
+                    extend(o->value, readAt(i));
+                    intervals[o->value].weight += frequency;
+                }
+            }
+            int d = DefinedReg(taco);
+            if (d >= 0) {
+                extend(d, writeAt(i));
+                intervals[d].weight += frequency;
+                if (taco.op == op_Copy && taco.a.IsReg()) {
+                    intervals[d].hint = taco.a.value;
+                    if (intervals[taco.a.value].hint < 0)
+                        intervals[taco.a.value].hint = d;
+                }
+            }
+            i++;
+        }
+    }
+
+    int kept = 0;
+    for (int r = 0; r < n; r++)
+        if (intervals[r].end >= 0 && fn.IsLocal(r))
+            intervals[kept++] = intervals[r];
+    intervals.resize(kept);
+    stable_sort(intervals.begin(), intervals.end(),
+                [](const Interval &x, const Interval &y) { return x.start < y.start; });
+    return intervals;
+}
+
+RegisterAllocation linearScanAllocation(TACFunction &fn) {
+    RegisterAllocation alloc;
+    alloc.reg.assign(fn.regs.size(), -1);
+    alloc.slot.assign(fn.regs.size(), -1);
+    alloc.slots = alloc.spilled = 0;
+    if (fn.code.empty())
+        return alloc;
+
+    vector<bool> param(fn.regs.size(), false);
+    for (const TACObject &taco : fn.code)
+        if (taco.op == op_LoadParam)
+            param[taco.dst.value] = true;
+    CFG cfg(fn);
+    Liveness liveness(cfg);
+    alloc.liveAcross = liveAcrossCalls(cfg, liveness);
+    vector<bool> acrossCall(fn.regs.size(), false);
+    for (const vector<int> &live : alloc.liveAcross)
+        for (int r : live)
+            acrossCall[r] = true;
+
+    vector<Interval> intervals = liveIntervals(cfg, liveness);
+    vector<int> active;                                 // intervals holding a register, by end
+    vector<int> owner(NumMachineRegisters, -1);         // interval holding each register
+    vector<bool> taken(NumMachineRegisters, false);
+    vector<int> spilled;
+    auto activate = [&](int i, int machine) {
+        owner[machine] = i;
+        taken[machine] = true;
+        alloc.reg[intervals[i].reg] = machine;
+        auto at = upper_bound(active.begin(), active.end(), i,
+                              [&](int x, int y) { return intervals[x].end < intervals[y].end; });
+        active.insert(at, i);
+    };
+
+    for (int i = 0; i < intervals.size(); i++) {
+        const Interval &current = intervals[i];
+        int expired = 0;
+        while (expired < active.size() && intervals[active[expired]].end < current.start) {
+            int machine = alloc.reg[intervals[active[expired]].reg];
+            owner[machine] = -1;
+            taken[machine] = false;
+            expired++;
+        }
+        active.erase(active.begin(), active.begin() + expired);
+
+        bool across = acrossCall[current.reg];
+        int machine = current.hint >= 0 ? alloc.reg[current.hint] : -1;
+        if (machine < 0 || taken[machine] || (across && machine < FirstCalleeSaved))
+            machine = freeRegister(taken, across);
+        if (machine < NumMachineRegisters) {
+            activate(i, machine);
+            continue;
+        }
+
+        // the cheapest of the current and the active intervals goes to
+        // memory, the one reaching furthest among equally cheap ones
+        int victim = i;
+        for (int a : active) {
+            double cost = spillCost(intervals[a]), least = spillCost(intervals[victim]);
+            if (cost < least || (cost == least && intervals[a].end > intervals[victim].end))
+                victim = a;
+        }
+        spilled.push_back(victim);
+        if (victim != i) {
+            machine = alloc.reg[intervals[victim].reg];
+            alloc.reg[intervals[victim].reg] = -1;
+            active.erase(find(active.begin(), active.end(), victim));
+            activate(i, machine);
+        }
+    }
+
+    // spilled intervals share the slots of the ones that ended before them
+    sort(spilled.begin(), spilled.end());
+    vector<int> slotEnd;
+    for (int i : spilled) {
+        const Interval &interval = intervals[i];
+        alloc.spilled++;
+        if (param[interval.reg])
+            continue;
+        int slot = 0;
+        while (slot < slotEnd.size() && slotEnd[slot] >= interval.start)
+            slot++;
+        if (slot == slotEnd.size())
+            slotEnd.push_back(0);
+        slotEnd[slot] = interval.end;
+        alloc.slot[interval.reg] = slot;
+    }
+    alloc.slots = slotEnd.size();
+
+    PrintDebug("regalloc", "%s: %d intervals, %d spilled to %d stack slots",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>",
+               (int)intervals.size(), alloc.spilled, alloc.slots);
+    return alloc;
+}
+
+/*
+ * Iterated register coalescing (George and Appel, "Iterated Register
+ * Coalescing"), the way Appel's "Modern Compiler Implementation" lays it
+ * out. The nodes are the local virtual registers the code refers to,
+ * numbered densely, and the moves are the copies between two of them.
+ * Nothing is precolored, so any two nodes may be coalesced; with coalesce
+ * false none are.
+ */
+class Coloring {
+  public:
+    Coloring(TACFunction &fn, bool coalesce);
+
+    // Above this many nodes the bit matrix gets too big, linear scan is used
+    static const int MaxNodes = 8192;
+
+    int Nodes() const { return regOf.size(); }
+    RegisterAllocation Allocate();
+
+    // The weight of the nodes Allocate spilled, what their loads and stores cost
+    double SpilledWeight() const { return spilledWeight; }
+
+  private:
+    enum nodestate { node_Simplify, node_Freeze, node_Spill, node_Coalesced, node_Stack, node_Colored, node_Spilled };
+    enum movestate { move_Worklist, move_Active, move_Coalesced, move_Constrained, move_Frozen };
+
+    TACFunction &fn;
+    bool coalesce;
+    vector<int> nodeOf, regOf;          // virtual register -> node (-1 if none) and back
+    vector<double> weight;              // reads and writes, 10 times more per loop they're in,
+                                        // of the nodes coalesced into it as well
+    double spilledWeight;
+    vector<vector<int>> liveAcross;     // per call, the virtual registers live across it
+    vector<bool> acrossCall;            // per node, of any node coalesced into it
+
+    BitSet adjSet;                      // lower triangle of the interference bit matrix
+    vector<vector<int>> adjList;
+    vector<int> degree;
+
+    vector<pair<int,int>> moves;        // (dst, src) nodes
+    vector<movestate> moveState;
+    vector<vector<int>> moveList;       // moves of each node
+
+    vector<nodestate> state;
+    vector<int> alias, color;
+    // worklists, entries whose node (or move) has changed state since are skipped
+    vector<int> simplifyWorklist, freezeWorklist, spillWorklist, worklistMoves;
+    vector<int> selectStack;
+
+    void Build();
+    bool Interfere(int u, int v) const;
+    void AddEdge(int u, int v);
+    template <class F> void ForAdjacent(int n, F f) const;
+    template <class F> void ForNodeMoves(int n, F f) const;
+    bool MoveRelated(int n) const;
+    void Push(int n, nodestate to);
+
+    void MakeWorklist();
+    void Simplify();
+    void DecrementDegree(int m);
+    void EnableMoves(int n);
+    void Coalesce();
+    void AddWorkList(int u);
+    bool Conservative(int u, int v) const;
+    bool George(int u, int v) const;
+    int GetAlias(int n) const;
+    void Combine(int u, int v);
+    void Freeze();
+    void FreezeMoves(int u);
+    void SelectSpill();
+    void AssignColors();
+};
+
+Coloring::Coloring(TACFunction &fn, bool coalesce)
+    : fn(fn), coalesce(coalesce), nodeOf(fn.regs.size(), -1), spilledWeight(0) {
+    for (const TACObject &taco : fn.code) {
+        for (const Operand *o : { &taco.a, &taco.b })
+            if (o->IsReg() && fn.IsLocal(o->value) && nodeOf[o->value] < 0) {
+                nodeOf[o->value] = regOf.size();
+                regOf.push_back(o->value);
+            }
+        int d = DefinedReg(taco);
+        if (d >= 0 && fn.IsLocal(d) && nodeOf[d] < 0) {
+            nodeOf[d] = regOf.size();
+            regOf.push_back(d);
+        }
+    }
+}
+
+bool Coloring::Interfere(int u, int v) const {
+    if (u < v)
+        swap(u, v);
+    return adjSet.Test(u * (u - 1) / 2 + v);
+}
+
+void Coloring::AddEdge(int u, int v) {
+    if (u == v || Interfere(u, v))
+        return;
+    adjSet.Set(max(u, v) * (max(u, v) - 1) / 2 + min(u, v));
+    adjList[u].push_back(v);
+    adjList[v].push_back(u);
+    degree[u]++;
+    degree[v]++;
+}
+
+/**
+ * Every definition interferes with the registers live right after it, but
+ * a copy's with its source: that pair is a move, the candidates for
+ * coalescing.
+ */
+void Coloring::Build() {
+    int n = Nodes();
+    adjSet = BitSet(n * (n - 1) / 2 + 1);
+    adjList.assign(n, vector<int>());
+    degree.assign(n, 0);
+    moveList.assign(n, vector<int>());
+    weight.assign(n, 0);
+
+    CFG cfg(fn);
+    Liveness liveness(cfg);
+    vector<int> live, position(n, -1);      // live nodes, and where each is in the list
+    auto add = [&](int node) {
+        if (node >= 0 && position[node] < 0) {
+            position[node] = live.size();
+            live.push_back(node);
+        }
+    };
+    auto remove = [&](int node) {
+        if (node < 0 || position[node] < 0)
+            return;
+        position[live.back()] = position[node];
+        live[position[node]] = live.back();
+        live.pop_back();
+        position[node] = -1;
+    };
+
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+        const BasicBlock &block = cfg.blocks[b];
+        double frequency = frequencyOf(cfg, block);
+        for (int node : live)
+            position[node] = -1;
+        live.clear();
+        if (cfg.IsReachable(b)) {
+            const BitSet &out = liveness.out[b];
+            for (int k = out.Next(0); k < out.Size(); k = out.Next(k + 1))
+                add(nodeOf[liveness.regs[k]]);
+        }
+
+        for (int i = block.code.size() - 1; i >= 0; i--) {
+            const TACObject &taco = block.code[i];
+            int d = DefinedReg(taco);
+            int def = d >= 0 ? nodeOf[d] : -1;
+            int a = taco.a.IsReg() ? nodeOf[taco.a.value] : -1;
+            int b = taco.b.IsReg() ? nodeOf[taco.b.value] : -1;
+
+            if (taco.op == op_Copy && def >= 0 && a >= 0 && def != a) {
+                remove(a);
+                moveList[def].push_back(moves.size());
+                moveList[a].push_back(moves.size());
+                worklistMoves.push_back(moves.size());
+                moves.emplace_back(def, a);
+            }
+            if (def >= 0) {
+                for (int node : live)
+                    AddEdge(node, def);
+                remove(def);
+                weight[def] += frequency;
+            }
+            for (int use : { a, b }) {
+                if (use >= 0) {
+                    add(use);
+                    weight[use] += frequency;
+                }
+            }
+        }
+    }
+    moveState.assign(moves.size(), move_Worklist);
+
+    liveAcross = liveAcrossCalls(cfg, liveness);
+    acrossCall.assign(n, false);
+    for (const vector<int> &live : liveAcross)
+        for (int r : live)
+            acrossCall[nodeOf[r]] = true;
+}
+
+// Calls f on the neighbours of n still in the graph
+template <class F> void Coloring::ForAdjacent(int n, F f) const {
+    for (int m : adjList[n])
+        if (state[m] != node_Stack && state[m] != node_Coalesced)
+            f(m);
+}
+
+// Calls f on the moves of n that may still be coalesced
+template <class F> void Coloring::ForNodeMoves(int n, F f) const {
+    for (int m : moveList[n])
+        if (moveState[m] == move_Active || moveState[m] == move_Worklist)
+            f(m);
+}
+
+bool Coloring::MoveRelated(int n) const {
+    bool related = false;
+    ForNodeMoves(n, [&](int) { related = true; });
+    return related;
+}
+
+void Coloring::Push(int n, nodestate to) {
+    state[n] = to;
+    if (to == node_Simplify)
+        simplifyWorklist.push_back(n);
+    else if (to == node_Freeze)
+        freezeWorklist.push_back(n);
+    else if (to == node_Spill)
+        spillWorklist.push_back(n);
+}
+
+void Coloring::MakeWorklist() {
+    for (int n = 0; n < Nodes(); n++) {
+        if (degree[n] >= NumMachineRegisters)
+            Push(n, node_Spill);
+        else if (MoveRelated(n))
+            Push(n, node_Freeze);
+        else
+            Push(n, node_Simplify);
+    }
+}
+
+void Coloring::Simplify() {
+    int n = simplifyWorklist.back();
+    simplifyWorklist.pop_back();
+    if (state[n] != node_Simplify)
+        return;
+    state[n] = node_Stack;
+    selectStack.push_back(n);
+    ForAdjacent(n, [&](int m) { DecrementDegree(m); });
+}
+
+void Coloring::DecrementDegree(int m) {
+    if (degree[m]-- != NumMachineRegisters || state[m] != node_Spill)
+        return;
+    EnableMoves(m);
+    ForAdjacent(m, [&](int a) { EnableMoves(a); });
+    Push(m, MoveRelated(m) ? node_Freeze : node_Simplify);
+}
+
+void Coloring::EnableMoves(int n) {
+    ForNodeMoves(n, [&](int m) {
+        if (moveState[m] == move_Active) {
+            moveState[m] = move_Worklist;
+            worklistMoves.push_back(m);
+        }
+    });
+}
+
+int Coloring::GetAlias(int n) const {
+    while (state[n] == node_Coalesced)
+        n = alias[n];
+    return n;
+}
+
+void Coloring::AddWorkList(int u) {
+    if (state[u] == node_Freeze && !MoveRelated(u) && degree[u] < NumMachineRegisters)
+        Push(u, node_Simplify);
+}
+
+// Briggs: the combined node has fewer than K neighbours of significant degree
+bool Coloring::Conservative(int u, int v) const {
+    vector<int> significant;
+    auto add = [&](int t) {
+        if (degree[t] >= NumMachineRegisters)
+            significant.push_back(t);
+    };
+    ForAdjacent(u, add);
+    ForAdjacent(v, add);
+    sort(significant.begin(), significant.end());
+    return unique(significant.begin(), significant.end()) - significant.begin() < NumMachineRegisters;
+}
+
+// George: every neighbour of v of significant degree already interferes with u
+bool Coloring::George(int u, int v) const {
+    bool ok = true;
+    ForAdjacent(v, [&](int t) { ok &= degree[t] < NumMachineRegisters || Interfere(t, u); });
+    return ok;
+}
+
+void Coloring::Coalesce() {
+    int m = worklistMoves.back();
+    worklistMoves.pop_back();
+    if (moveState[m] != move_Worklist)
+        return;
+    int u = GetAlias(moves[m].first), v = GetAlias(moves[m].second);
+
+    if (u == v) {
+        moveState[m] = move_Coalesced;
+        AddWorkList(u);
+    } else if (Interfere(u, v)) {
+        moveState[m] = move_Constrained;
+        AddWorkList(u);
+        AddWorkList(v);
+    } else if (coalesce && (George(u, v) || Conservative(u, v))) {
+        moveState[m] = move_Coalesced;
+        Combine(u, v);
+        AddWorkList(u);
+    } else {
+        moveState[m] = move_Active;
+    }
+}
+
+void Coloring::Combine(int u, int v) {
+    state[v] = node_Coalesced;
+    alias[v] = u;
+    weight[u] += weight[v];
+    acrossCall[u] = acrossCall[u] || acrossCall[v];
+    moveList[u].insert(moveList[u].end(), moveList[v].begin(), moveList[v].end());
+    EnableMoves(v);
+    ForAdjacent(v, [&](int t) {
+        AddEdge(t, u);
+        DecrementDegree(t);
+    });
+    if (degree[u] >= NumMachineRegisters && state[u] == node_Freeze)
+        Push(u, node_Spill);
+}
+
+void Coloring::Freeze() {
+    int u = freezeWorklist.back();
+    freezeWorklist.pop_back();
+    if (state[u] != node_Freeze)
+        return;
+    Push(u, node_Simplify);
+    FreezeMoves(u);
+}
+
+void Coloring::FreezeMoves(int u) {
+    ForNodeMoves(u, [&](int m) {
+        int x = moves[m].first, y = moves[m].second;
+        int v = GetAlias(y) == GetAlias(u) ? GetAlias(x) : GetAlias(y);
+        moveState[m] = move_Frozen;
+        if (state[v] == node_Freeze && !MoveRelated(v))
+            Push(v, node_Simplify);
+    });
+}
+
+// The node least costly to spill per neighbour it takes out of the graph
+void Coloring::SelectSpill() {
+    int best = -1, kept = 0;
+    for (int n : spillWorklist) {
+        if (state[n] != node_Spill)
+            continue;
+        spillWorklist[kept++] = n;
+        if (best < 0 || weight[n] * degree[best] < weight[best] * degree[n])
+            best = n;
+    }
+    spillWorklist.resize(kept);
+    if (best < 0)
+        return;
+    Push(best, node_Simplify);
+    FreezeMoves(best);
+}
+
+/**
+ * Pops the nodes off the stack, each getting a register none of its
+ * neighbours has; among those, the one of a node it is a move away from
+ * (biased coloring), so that move goes too. A node left without one is
+ * spilled.
+ */
+void Coloring::AssignColors() {
+    while (!selectStack.empty()) {
+        int n = selectStack.back();
+        selectStack.pop_back();
+        vector<bool> taken(NumMachineRegisters, false);
+        for (int w : adjList[n]) {
+            int a = GetAlias(w);
+            if (state[a] == node_Colored)
+                taken[color[a]] = true;
+        }
+        int chosen = -1;
+        for (int m : moveList[n]) {
+            int partner = GetAlias(moves[m].first) == n ? GetAlias(moves[m].second) : GetAlias(moves[m].first);
+            if (state[partner] == node_Colored && !taken[color[partner]] &&
+                (!acrossCall[n] || color[partner] >= FirstCalleeSaved)) {
+                chosen = color[partner];
+                break;
+            }
+        }
+        if (chosen < 0)
+            chosen = freeRegister(taken, acrossCall[n]);
+        if (chosen < NumMachineRegisters) {
+            state[n] = node_Colored;
+            color[n] = chosen;
+        } else {
+            state[n] = node_Spilled;
+        }
+    }
+}
+
+RegisterAllocation Coloring::Allocate() {
+    int n = Nodes();
+    state.assign(n, node_Simplify);
+    alias.assign(n, -1);
+    color.assign(n, -1);
+    Build();
+    MakeWorklist();
+    while (true) {
+        if (!simplifyWorklist.empty())
+            Simplify();
+        else if (!worklistMoves.empty())
+            Coalesce();
+        else if (!freezeWorklist.empty())
+            Freeze();
+        else if (!spillWorklist.empty())
+            SelectSpill();
+        else
+            break;
+    }
+    AssignColors();
+
+    RegisterAllocation alloc;
+    alloc.reg.assign(fn.regs.size(), -1);
+    alloc.slot.assign(fn.regs.size(), -1);
+    alloc.spilled = 0;
+    alloc.liveAcross = liveAcross;
+    spilledWeight = 0;
+
+    vector<bool> param(fn.regs.size(), false);
+    for (const TACObject &taco : fn.code)
+        if (taco.op == op_LoadParam)
+            param[taco.dst.value] = true;
+
+    // the nodes coalesced into a spilled one share its slot, the lowest one
+    // none of the nodes they interfere with has
+    vector<vector<int>> members(n);
+    for (int node = 0; node < n; node++) {
+        int r = regOf[node], root = GetAlias(node);
+        if (state[root] == node_Colored) {
+            alloc.reg[r] = color[root];
+        } else {
+            alloc.spilled++;
+            if (root == node)
+                spilledWeight += weight[node];
+            if (!param[r])
+                members[root].push_back(node);
+        }
+    }
+    vector<int> slotOf(n, -1);
+    int slots = 0;
+    for (int root = 0; root < n; root++) {
+        if (members[root].empty())
+            continue;
+        vector<bool> taken(slots + 1, false);
+        for (int node : members[root])
+            for (int w : adjList[node])
+                if (slotOf[GetAlias(w)] >= 0)
+                    taken[slotOf[GetAlias(w)]] = true;
+        slotOf[root] = find(taken.begin(), taken.end(), false) - taken.begin();
+        slots = max(slots, slotOf[root] + 1);
+        for (int node : members[root])
+            alloc.slot[regOf[node]] = slotOf[root];
+    }
+    alloc.slots = slots;
+    return alloc;
+}
+
+/**
+ * A spilled node lives in memory for all of its range, and one coalesced
+ * from several copies is spilled all at once: coalescing that leaves the
+ * graph short of colors can cost more loads and stores than the copies it
+ * saves. So when some node is spilled, the graph is colored again with no
+ * copy coalesced, and the coloring whose spilled nodes weigh less is kept.
+ */
+RegisterAllocation graphColoringAllocation(TACFunction &fn) {
+    if (fn.code.empty())
+        return linearScanAllocation(fn);
+    Coloring coloring(fn, true);
+    if (coloring.Nodes() > Coloring::MaxNodes) {
+        PrintDebug("regalloc", "%s: %d virtual registers, too many to color, using linear scan",
+                   fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", coloring.Nodes());
+        return linearScanAllocation(fn);
+    }
+    RegisterAllocation alloc = coloring.Allocate();
+    bool coalesced = true;
+    if (alloc.spilled > 0) {
+        Coloring plain(fn, false);
+        RegisterAllocation other = plain.Allocate();
+        if (plain.SpilledWeight() < coloring.SpilledWeight()) {
+            alloc = other;
+            coalesced = false;
+        }
+    }
+    PrintDebug("regalloc", "%s: %d nodes colored, %d spilled to %d stack slots%s",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>",
+               coloring.Nodes() - alloc.spilled, alloc.spilled, alloc.slots,
+               coalesced ? "" : ", no copy coalesced");
+    return alloc;
+}
@@ -0,0 +1,85 @@
+/**
+ * File: regalloc.h
+ * ----------------
+ * Assignment of the virtual registers of a function to the registers of
+ * the machine, done once the passes are through and right before the MIPS
+ * code is generated.
+ *
+ * Values are kept in $t0-$t9 and $s0-$s7. $v0 and $a0 belong to calls and
+ * system calls, $v1 and $a1-$a3 are left to the code generator as scratch
+ * registers: the ones it loads spilled values into and computes values to
+ * be spilled in. Global variables aren't allocated, they stay in memory.
+ *
+ * A call may change any $t register, so the caller saves the ones holding
+ * values live across it; a function changing an $s register saves it once
+ * on entry and restores it on the way out. Values live across a call are
+ * given an $s register when one is free, the others a $t register.
+ */
+
+#ifndef _H_regalloc
+#define _H_regalloc
+
+#include "tac.h"
+
+const int NumMachineRegisters = 18;
+const int FirstCalleeSaved = 10;        // $s0, the ones before it are $t0-$t9
+
+// The registers handed out, without the $
+extern const char *const MachineRegisters[NumMachineRegisters];
+
+struct RegisterAllocation {
+    vector<int> reg;        // machine register of each virtual register, -1 if none
+    vector<int> slot;       // stack slot of each spilled virtual register, -1 if none
+    int slots;              // stack slots the function needs
+    int spilled;            // virtual registers spilled
+    vector<vector<int>> liveAcross;     // for each call, the local virtual registers read after it returns
+};
+
+/**
+ * Linear scan allocation (Poletto and Sarkar, "Linear Scan Register
+ * Allocation"), over the live intervals of the code in the order it is
+ * emitted:
+ *
+ *  - a virtual register's interval runs from the first to the last
+ *    instruction it is live at, found with liveness; an interval ending
+ *    where another starts gives it its register, the read comes first
+ *  - intervals are visited by start, expiring the ones that ended; a
+ *    register copied to or from one that just expired gets the same
+ *    machine register if it is free (Wimmer's register hints), so the
+ *    copy goes away, unless that is a $t register and the interval spans
+ *    a call
+ *  - when no register is free, the current or active interval with the
+ *    lowest spill weight per position it covers is spilled: each read and
+ *    write weighs 10 to the loop depth of its block, and a long interval
+ *    read now and then is the one that frees its register for the most
+ *  - a spilled interval lives on the stack for all of its length, in a
+ *    slot shared with intervals that don't overlap it. A spilled
+ *    parameter stays in the slot it was passed in and gets none.
+ *
+ * @param fn : the function, as it is about to be emitted
+ * @return where each of its local virtual registers is kept
+ */
+RegisterAllocation linearScanAllocation(TACFunction &fn);
+
+/**
+ * Graph coloring by iterated register coalescing (George and Appel): the
+ * interference graph, kept as a bit matrix for the tests and adjacency
+ * lists for the walks, is simplified, copies between registers that
+ * don't interfere are coalesced while that can't make the graph
+ * uncolorable (the Briggs and George tests), and move related registers
+ * are frozen when nothing else goes. When only nodes of significant degree
+ * are left, the one with the least spill weight per neighbour is pushed
+ * on, the weight counting 10 to the loop depth for each read and write,
+ * those of the nodes coalesced into it included. A node takes the color
+ * of a move partner when it can, else an $s or a $t register as linear
+ * scan would give it; one left without a color is spilled. When any is,
+ * the graph is colored again without coalescing and the coloring that
+ * spills less weight is kept. Functions with more virtual registers than
+ * the bit matrix is sized for fall back to linear scan.
+ *
+ * @param fn : the function, as it is about to be emitted
+ * @return where each of its local virtual registers is kept
+ */
+RegisterAllocation graphColoringAllocation(TACFunction &fn);
+
+#endif
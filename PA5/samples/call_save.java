@@ -0,0 +1,41 @@
+// flags: -passes= -regalloc=linear
+int twice(int x) {
+    return x + x;
+}
+
+int keep(int x) {
+    int y = x + 1;
+    int z = twice(y);
+    return z + y;
+}
+
+void main() {
+    int n = readIntFromSTDIN();
+    int d = n + 100;
+    int r;
+    int v0 = n + 1;
+    int v1 = n + 2;
+    int v2 = n + 3;
+    int v3 = n + 4;
+    int v4 = n + 5;
+    int v5 = n + 6;
+    int v6 = n + 7;
+    int v7 = n + 8;
+    int v8 = n + 9;
+    int v9 = n + 10;
+    r = twice(n);
+    r = r + d;
+    r = r + v0;
+    r = r + v1;
+    r = r + v2;
+    r = r + v3;
+    r = r + v4;
+    r = r + v5;
+    r = r + v6;
+    r = r + v7;
+    r = r + v8;
+    r = r + v9;
+    d = keep(r);
+    printInt(r);
+    printInt(d);
+}
@@ -0,0 +1,30 @@
+// flags: -passes=fold -d tac
+void main() {
+    int x = readIntFromSTDIN();
+    int a = 2147483647 + 1;
+    int b = (-2147483647 + -1) / -1;
+    int c = 65536 * 65536;
+    int d = x * 1 + 0;
+    int e = x * 0;
+    int f = x / 1;
+    int g = x * -1;
+    int h = x + 1 + 2;
+    int k = x - 5;
+    boolean t = x < x;
+    boolean u = x == x;
+    printInt(a);
+    printInt(b);
+    printInt(c);
+    printInt(d);
+    printInt(e);
+    printInt(f);
+    printInt(g);
+    printInt(h);
+    printInt(k);
+    if (t) {
+        printInt(x);
+    }
+    if (u) {
+        printInt(x);
+    }
+}
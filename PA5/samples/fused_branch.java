@@ -0,0 +1,31 @@
+// flags: -passes=fold -regalloc=linear
+void main() {
+    int a = readIntFromSTDIN();
+    int b = readIntFromSTDIN();
+    int r = 0;
+    if (a == b) {
+        r = r + 1;
+    }
+    if (a != 0) {
+        r = r + 2;
+    }
+    if (a > 0) {
+        r = r + 4;
+    }
+    if (b <= 0) {
+        r = r + 8;
+    }
+    if (a < 40000) {
+        r = r + 16;
+    }
+    if (a <= 2147483647) {
+        r = r + 32;
+    }
+    if (b > -2147483647 + -1) {
+        r = r + 64;
+    }
+    if (b >= 32767) {
+        r = r + 128;
+    }
+    printInt(r);
+}
@@ -0,0 +1,22 @@
+// flags: -passes= -regalloc=graph
+int fib(int n) {
+    int a = 0;
+    int b = 1;
+    int c;
+    int i;
+    for (i = 0; i < n; i++) {
+        c = a + b;
+        a = b;
+        b = c;
+    }
+    return a;
+}
+
+void main() {
+    int n = readIntFromSTDIN();
+    int x = n;
+    int y = x;
+    int r = fib(y);
+    printInt(r);
+    printInt(x);
+}
@@ -0,0 +1,24 @@
+// flags: -passes=gvn -d tac
+int g;
+
+void main() {
+    int a = readIntFromSTDIN();
+    int b = readIntFromSTDIN();
+    int c = a + b;
+    int d = b + a;
+    int e;
+    int f;
+    if (a < b) {
+        e = a + b;
+        g = c + d;
+    } else {
+        e = a * 4;
+        g = a + b;
+    }
+    f = a + b;
+    e = e + f;
+    printInt(c);
+    printInt(d);
+    printInt(e);
+    printInt(g);
+}
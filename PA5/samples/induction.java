@@ -0,0 +1,16 @@
+// flags: -passes=iv,dce -d tac
+void main() {
+    int n = readIntFromSTDIN();
+    int c = readIntFromSTDIN();
+    int i;
+    int s = 0;
+    int t = 0;
+    for (i = 0; i < 10; i++) {
+        s = s + i * 4;
+    }
+    for (i = 1; i <= n; i = i + 2) {
+        t = t + i * c;
+    }
+    printInt(s);
+    printInt(t);
+}
@@ -0,0 +1,31 @@
+// flags: -passes=inline -d tac
+int g;
+
+int add3(int a, int b, int c) {
+    return a + b + c;
+}
+
+int scaled(int x) {
+    g = g + 1;
+    return x * 4;
+}
+
+int fact(int n) {
+    if (n <= 1) {
+        return 1;
+    }
+    int m = n + -1;
+    m = fact(m);
+    return n + m;
+}
+
+void main() {
+    int x = readIntFromSTDIN();
+    int y;
+    y = add3(x, 2, 3);
+    y = scaled(y);
+    x = fact(x);
+    y = y + x;
+    printInt(y);
+    printInt(g);
+}
@@ -0,0 +1,22 @@
+int twice(int a) {
+    return a + a;
+}
+
+int square(int a) {
+    int s = 0;
+    int i;
+    for (i = 0; i < a; i++) {
+        s = s + a;
+    }
+    return s;
+}
+
+void main() {
+    int x = readIntFromSTDIN();
+    x = square(x);
+    printInt(x);
+}
+
+int broken(int a) {
+    return a +;
+}
@@ -0,0 +1,30 @@
+// flags: -passes=layout -d tac
+void main() {
+    int a = readIntFromSTDIN();
+    int b = readIntFromSTDIN();
+    int n;
+    int i;
+    if (a > b) {
+        if (a > 10) {
+            n = 1;
+        } else {
+            if (a > 5) {
+                n = 2;
+            } else {
+                n = 3;
+            }
+        }
+    } else {
+        n = 4;
+    }
+    i = 0;
+    while (i < b) {
+        if (i == a) {
+            n = n + 100;
+        } else {
+            n = n + 1;
+        }
+        i++;
+    }
+    printInt(n);
+}
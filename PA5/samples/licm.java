@@ -0,0 +1,33 @@
+// flags: -passes=licm -d tac
+int g;
+
+int bump(int x) {
+    g = g + x;
+    return g;
+}
+
+void main() {
+    int a = readIntFromSTDIN();
+    int b = readIntFromSTDIN();
+    int n = readIntFromSTDIN();
+    int i;
+    int s = 0;
+    int k = 0;
+    int q = 0;
+    for (i = 0; i < n; i++) {
+        k = a + b;
+        s = s + k;
+        q = s / b;
+        if (i > 3) {
+            s = s + a * 4;
+        }
+    }
+    i = 0;
+    while (i < n) {
+        s = s + g + 1;
+        i = bump(i);
+    }
+    printInt(s);
+    printInt(k);
+    printInt(q);
+}
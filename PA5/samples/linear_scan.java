@@ -0,0 +1,53 @@
+// flags: -passes= -regalloc=linear
+void main() {
+    int n = readIntFromSTDIN();
+    int i;
+    int s = 0;
+    int v0 = n + 1;
+    int v1 = n + 2;
+    int v2 = n + 3;
+    int v3 = n + 4;
+    int v4 = n + 5;
+    int v5 = n + 6;
+    int v6 = n + 7;
+    int v7 = n + 8;
+    int v8 = n + 9;
+    int v9 = n + 10;
+    int v10 = n + 11;
+    int v11 = n + 12;
+    int v12 = n + 13;
+    int v13 = n + 14;
+    int v14 = n + 15;
+    int v15 = n + 16;
+    int v16 = n + 17;
+    int v17 = n + 18;
+    int v18 = n + 19;
+    int v19 = n + 20;
+    for (i = 0; i < n; i++) {
+        s = s + i;
+    }
+    s = s + v0;
+    s = s + v1;
+    s = s + v2;
+    s = s + v3;
+    s = s + v4;
+    s = s + v5;
+    s = s + v6;
+    s = s + v7;
+    s = s + v8;
+    s = s + v9;
+    s = s + v10;
+    s = s + v11;
+    s = s + v12;
+    s = s + v13;
+    s = s + v14;
+    s = s + v15;
+    s = s + v16;
+    s = s + v17;
+    s = s + v18;
+    s = s + v19;
+    printInt(s);
+    printInt(v0);
+    printInt(v10);
+    printInt(v19);
+}
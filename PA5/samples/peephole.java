@@ -0,0 +1,20 @@
+// flags: -passes= -regalloc=linear
+int add(int a, int b) {
+    return a + b;
+}
+
+void main() {
+    int x = readIntFromSTDIN();
+    int y = 0;
+    int z;
+    if (x < 10) {
+        y = x + 0;
+    }
+    z = add(x, y);
+    z = add(z, z);
+    while (y < 3) {
+        y = y + 1;
+    }
+    printInt(z);
+    printInt(y);
+}
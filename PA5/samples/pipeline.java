@@ -0,0 +1,16 @@
+// flags: -passes=(fold,constprop,gvn,dce) -d tac
+void main() {
+    int b = readIntFromSTDIN();
+    int x = 3;
+    int y = 6;
+    int z = 8;
+    int w = 5;
+    int r;
+    x = x + y;
+    r = x + b;
+    r = r + z;
+    r = w + r;
+    w = z + x;
+    printInt(r);
+    printInt(w);
+}
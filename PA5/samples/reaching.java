@@ -0,0 +1,13 @@
+// flags: -passes= -d cfg reaching tac
+void main() {
+    int a = readIntFromSTDIN();
+    int b = 1;
+    int i;
+    if (a > 0) {
+        b = 2;
+    }
+    for (i = 0; i < a; i++) {
+        b = b + i;
+    }
+    printInt(b);
+}
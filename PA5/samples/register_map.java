@@ -0,0 +1,34 @@
+// flags: -passes= -regalloc=linear
+int total;
+
+int count(int a, int b) {
+    int i;
+    int s = 0;
+    for (i = a; i < b; i++) {
+        s = s + i;
+        total = total + 1;
+    }
+    return s;
+}
+
+int mix(int a, int b) {
+    int i = a + b;
+    int s = i + a;
+    if (s > 10) {
+        i = s + b;
+    } else {
+        s = i + 1;
+    }
+    total = total + s;
+    return i + s;
+}
+
+void main() {
+    int a = readIntFromSTDIN();
+    int b = readIntFromSTDIN();
+    int s = count(a, b);
+    int i = mix(a, b);
+    printInt(s);
+    printInt(i);
+    printInt(total);
+}
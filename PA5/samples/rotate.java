@@ -0,0 +1,22 @@
+// flags: -passes=rotate -d tac
+void main() {
+    int n = readIntFromSTDIN();
+    int i = 0;
+    int s = 0;
+    int k = 5;
+    while (i < n) {
+        s = s + i;
+        i++;
+    }
+    printInt(i);
+    printInt(s);
+    for (k = 5; k < 5; k++) {
+        s = s + 100;
+    }
+    printInt(k);
+    for (i = n; i > 0; i = i + -2) {
+        s = s + 1;
+    }
+    printInt(i);
+    printInt(s);
+}
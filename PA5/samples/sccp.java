@@ -0,0 +1,42 @@
+// flags: -passes=constprop -d tac
+int limit(int x) {
+    int max = 2147483647;
+    int min = -2147483647 + -1;
+    int r = 0;
+    if (max + 1 < max) {
+        r = r + 1;
+    }
+    if (min + -1 > min) {
+        r = r + 2;
+    }
+    if (min < max) {
+        r = r + 4;
+    }
+    if (min <= -2147483647) {
+        r = r + 8;
+    }
+    if (max >= 2147483647) {
+        r = r + 16;
+    }
+    return r + x;
+}
+
+void main() {
+    int a = readIntFromSTDIN();
+    int b = 4;
+    int c;
+    int d;
+    if (b > 3) {
+        c = b + 1;
+    } else {
+        c = a;
+    }
+    d = c + 2;
+    while (b < 4) {
+        d = d + a;
+        b = b + 1;
+    }
+    printInt(d);
+    a = limit(a);
+    printInt(a);
+}
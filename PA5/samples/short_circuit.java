@@ -0,0 +1,34 @@
+// flags: -passes= -d tac
+int calls;
+
+int bump(int x) {
+    calls = calls + 1;
+    return x + 1;
+}
+
+void main() {
+    int a = readIntFromSTDIN();
+    int b = readIntFromSTDIN();
+    int r = 0;
+    boolean t;
+    if (a > 0 && bump(a) > 2) {
+        r = r + 1;
+    }
+    if (b > 0 || bump(b) > 2) {
+        r = r + 2;
+    }
+    t = a < b && bump(b) > 0;
+    if (t) {
+        r = r + 4;
+    }
+    t = a == b || a < 0 && b < 0;
+    if (t) {
+        r = r + 8;
+    }
+    t = a && b > 0;
+    if (t) {
+        r = r + 16;
+    }
+    printInt(r);
+    printInt(calls);
+}
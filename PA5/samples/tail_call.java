@@ -0,0 +1,29 @@
+// flags: -passes=tre -d tac
+int sum(int n, int acc) {
+    int m;
+    if (n <= 0) {
+        return acc;
+    }
+    m = n + -1;
+    acc = acc + n;
+    return sum(m, acc);
+}
+
+int depth(int n) {
+    int m;
+    if (n <= 0) {
+        return 0;
+    }
+    m = n + -1;
+    m = depth(m);
+    return m + 1;
+}
+
+void main() {
+    int n = readIntFromSTDIN();
+    int z = 0;
+    int s = sum(n, z);
+    int d = depth(n);
+    printInt(s);
+    printInt(d);
+}
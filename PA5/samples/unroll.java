@@ -0,0 +1,16 @@
+// flags: -passes=unroll -d tac
+void main() {
+    int n = readIntFromSTDIN();
+    int i;
+    int s = 0;
+    int t = 0;
+    for (i = 0; i < 3; i++) {
+        s = s + i;
+    }
+    for (i = 0; i < n; i++) {
+        t = t + i;
+    }
+    printInt(s);
+    printInt(t);
+    printInt(i);
+}
@@ -0,0 +1,20 @@
+// flags: -passes=unswitch -d tac
+int g;
+
+void main() {
+    int n = readIntFromSTDIN();
+    int mode = readIntFromSTDIN();
+    int step = readIntFromSTDIN();
+    int i;
+    int s = 0;
+    for (i = 0; i < n; i = i + step) {
+        if (mode > 0) {
+            s = s + i;
+        } else {
+            s = s + 2;
+            g = g + 1;
+        }
+    }
+    printInt(s);
+    printInt(g);
+}
@@ -0,0 +1,251 @@
+/**
+ * File: simplify.cc
+ * -----------------
+ * Constant folding, algebraic identities and reassociation of constants.
+ */
+
+#include "simplify.h"
+#include "utility.h"
+#include <algorithm>
+#include <functional>
+
+static bool isCommutative(tacop op) {
+    return op == op_Add || op == op_Mul || op == op_Equal || op == op_NotEqual
+        || op == op_And || op == op_Or;
+}
+
+// Comparisons and logical operators give booleans
+static Operand constantOf(tacop op, int value) {
+    return op >= op_Less ? Operand::Bool(value != 0) : Operand::Imm(value);
+}
+
+static int negated(int value) {
+    return (int)(0u - (unsigned)value);
+}
+
+/**
+ * Applies the rules that only look at the instruction itself.
+ *
+ * @param taco : the instruction, rewritten in place
+ * @return true if it changed
+ */
+static bool simplify(TACObject &taco) {
+    if (taco.op == op_Neg && taco.a.IsImm()) {
+        taco = TACObject(op_Copy, taco.dst, Operand::Imm(negated(taco.a.value)));
+        return true;
+    }
+    if (!IsBinary(taco.op))
+        return false;
+
+    Operand x = taco.a, y = taco.b;
+    int result;
+    if (x.IsImm() && y.IsImm()) {
+        if (!FoldBinary(taco.op, x.value, y.value, result))
+            return false;
+        taco = TACObject(op_Copy, taco.dst, constantOf(taco.op, result));
+        return true;
+    }
+
+    bool changed = false;
+    if (x.IsImm() && isCommutative(taco.op)) {
+        swap(taco.a, taco.b);
+        swap(x, y);
+        changed = true;
+    }
+    if (taco.op == op_Sub && x.IsImm() && x.value == 0) {
+        taco = TACObject(op_Neg, taco.dst, y);
+        return true;
+    }
+
+    if (x == y) {
+        switch (taco.op) {
+            case op_Sub:
+                taco = TACObject(op_Copy, taco.dst, Operand::Imm(0));
+                return true;
+            case op_Equal: case op_LessEqual: case op_GreaterEqual:
+                taco = TACObject(op_Copy, taco.dst, Operand::Bool(true));
+                return true;
+            case op_NotEqual: case op_Less: case op_Greater:
+                taco = TACObject(op_Copy, taco.dst, Operand::Bool(false));
+                return true;
+            case op_And: case op_Or:
+                taco = TACObject(op_Copy, taco.dst, x);
+                return true;
+            default:
+                return changed;
+        }
+    }
+    if (!y.IsImm())
+        return changed;
+
+    int c = y.value;
+    Operand same = x, neg;
+    switch (taco.op) {
+        case op_Add:
+            if (c != 0)
+                return changed;
+            break;
+        case op_Sub:
+            if (c != 0) {
+                taco = TACObject(op_Add, taco.dst, x, Operand::Imm(negated(c)));
+                return true;
+            }
+            break;
+        case op_Mul:
+            if (c == 0)
+                same = Operand::Imm(0);
+            else if (c == -1)
+                neg = x;
+            else if (c != 1)
+                return changed;
+            break;
+        case op_Div:
+            if (c == -1)
+                neg = x;
+            else if (c != 1)
+                return changed;
+            break;
+        case op_And:
+            if (c == 0)
+                same = Operand::Bool(false);
+            break;
+        case op_Or:
+            if (c != 0)
+                same = Operand::Bool(true);
+            break;
+        default:
+            return changed;
+    }
+    if (!neg.IsNone())
+        taco = TACObject(op_Neg, taco.dst, neg);
+    else
+        taco = TACObject(op_Copy, taco.dst, same);
+    return true;
+}
+
+// A temp computed from a register and a constant: x + c, x * c or - x
+struct Affine {
+    tacop op;
+    Operand x;
+    int c;
+};
+
+/**
+ * One sweep over the code: reads of constant temps become the constant,
+ * each instruction is simplified, and constants are reassociated with the
+ * sum or product of an earlier instruction of the block.
+ *
+ * @return true if the code changed
+ */
+static bool sweep(TACFunction &fn, int &simplified) {
+    // temps defined once, by a copy of a constant
+    vector<int> defs(fn.regs.size(), 0);
+    vector<Operand> constant(fn.regs.size());
+    for (const TACObject &taco : fn.code) {
+        int d = DefinedReg(taco);
+        if (d < 0)
+            continue;
+        defs[d]++;
+        if (taco.op == op_Copy && taco.a.IsImm())
+            constant[d] = taco.a;
+    }
+    auto isTemp = [&](const Operand &o) {
+        return o.IsReg() && fn.regs[o.value].name < 0 && defs[o.value] == 1;
+    };
+
+    bool changed = false;
+    vector<Affine> known(fn.regs.size(), { op_Copy, Operand(), 0 });
+    vector<int> tracked;
+    auto forget = [&](const function<bool(const Affine &)> &stale) {
+        int kept = 0;
+        for (int t : tracked) {
+            if (stale(known[t]))
+                known[t].x = Operand();
+            else
+                tracked[kept++] = t;
+        }
+        tracked.resize(kept);
+    };
+
+    for (TACObject &taco : fn.code) {
+        bool rewritten = false;
+        for (Operand *o : { &taco.a, &taco.b }) {
+            if (isTemp(*o) && !constant[o->value].IsNone()) {
+                *o = constant[o->value];
+                rewritten = true;
+            }
+        }
+        if (taco.op == op_Label || IsBranch(taco.op)) {
+            forget([](const Affine &) { return true; });
+            changed |= rewritten;
+            continue;
+        }
+        while (true) {
+            if (simplify(taco)) {
+                rewritten = true;
+                continue;
+            }
+
+            // t := x + c1, u := t + c2  ->  u := x + (c1 + c2), and likewise
+            // for products; - - x is x
+            if (!isTemp(taco.a) || known[taco.a.value].x.IsNone())
+                break;
+            const Affine &def = known[taco.a.value];
+            int folded;
+            if (taco.op == op_Neg && def.op == op_Neg)
+                taco = TACObject(op_Copy, taco.dst, def.x);
+            else if ((taco.op == op_Add || taco.op == op_Mul) && def.op == taco.op && taco.b.IsImm() &&
+                     FoldBinary(taco.op, def.c, taco.b.value, folded))
+                taco = TACObject(taco.op, taco.dst, def.x, Operand::Imm(folded));
+            else
+                break;
+            rewritten = true;
+        }
+        if (rewritten) {
+            changed = true;
+            simplified++;
+        }
+
+        int d = DefinedReg(taco);
+        // a sum or product is forgotten once its register is assigned again,
+        // or for a global, once a function is called
+        if (d >= 0)
+            forget([&](const Affine &a) { return a.x == Operand::Reg(d); });
+        if (taco.op == op_Call)
+            forget([&](const Affine &a) { return !fn.IsLocal(a.x.value); });
+
+        if (d >= 0 && isTemp(taco.dst) && taco.a.IsReg() && !(taco.a == taco.dst) &&
+            (taco.op == op_Neg || ((taco.op == op_Add || taco.op == op_Mul) && taco.b.IsImm()))) {
+            known[d] = { taco.op, taco.a, taco.op == op_Neg ? 0 : taco.b.value };
+            tracked.push_back(d);
+        }
+    }
+
+    // copies of a register to itself, and constant temps no longer read
+    vector<bool> read(fn.regs.size(), false);
+    for (const TACObject &taco : fn.code)
+        for (const Operand *o : { &taco.a, &taco.b })
+            if (o->IsReg())
+                read[o->value] = true;
+    int kept = 0;
+    for (int i = 0; i < fn.code.size(); i++) {
+        const TACObject &taco = fn.code[i];
+        bool selfCopy = taco.op == op_Copy && taco.a == taco.dst;
+        bool unread = taco.op == op_Copy && taco.a.IsImm() && isTemp(taco.dst) && !read[taco.dst.value];
+        if (selfCopy || unread) {
+            changed = true;
+            continue;
+        }
+        fn.code[kept++] = taco;
+    }
+    fn.code.erase(fn.code.begin() + kept, fn.code.end());
+    return changed;
+}
+
+void algebraicSimplification(TACFunction &fn) {
+    int simplified = 0, sweeps = 0;
+    while (sweep(fn, simplified))
+        sweeps++;
+    PrintDebug("fold", "%s: %d instructions simplified in %d sweeps",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", simplified, sweeps);
+}
@@ -0,0 +1,39 @@
+/**
+ * File: simplify.h
+ * ----------------
+ * Constant folding and algebraic simplification of the TAC of a function.
+ *
+ * Folding follows the 32-bit two's complement arithmetic of the machine
+ * (see FoldBinary): sums and products wrap around, and a division by zero
+ * is left for run time. Comparisons and logical operators fold to
+ * booleans.
+ */
+
+#ifndef _H_simplify
+#define _H_simplify
+
+#include "tac.h"
+
+/**
+ * Simplifies the function until no rule applies anymore:
+ *
+ *  - operators on constants are folded, and temps holding a constant are
+ *    replaced by it where they are read
+ *  - constants go to the right of commutative operators
+ *  - identities: x + 0, x - 0, x * 1, x / 1 and x || false are x, x * 0 is
+ *    0, x * -1, x / -1 and 0 - x are - x, x - x is 0, x && true is x,
+ *    comparing x with itself is a constant
+ *  - x - c becomes x + -c, so that chained constants are reassociated
+ *    within a block: t := x + 1, u := t + 2 gives u := x + 3 (products of
+ *    constants likewise, and - - x gives x)
+ *  - copies of a register to itself are dropped
+ *
+ * Multiplications by a power of two are left for the code generator,
+ * which emits them as shifts, so the induction variable passes still see
+ * them as products.
+ *
+ * @param fn : the function to simplify
+ */
+void algebraicSimplification(TACFunction &fn);
+
+#endif
@@ -0,0 +1,655 @@
+/**
+ * File: ssa.cc
+ * ------------
+ * SSA construction, sparse conditional constant propagation and the way
+ * back out of SSA.
+ */
+
+#include "ssa.h"
+#include "ast.h"        // for Node::NewTemp
+#include "utility.h"
+#include <algorithm>
+
+// Position of pred in the predecessor list of block b
+static int predIndex(const BasicBlock &b, int pred) {
+    return find(b.preds.begin(), b.preds.end(), pred) - b.preds.begin();
+}
+
+SSA::SSA(CFG &cfg) : cfg(cfg), fn(cfg.fn), originals(cfg.fn.regs.size()) {
+    for (int r = 0; r < fn.regs.size(); r++) {
+        base.push_back(r);
+        versions.push_back(0);
+        if (!fn.IsLocal(r))
+            globals.push_back(r);
+    }
+
+    PlacePhis();
+    Rename();
+}
+
+int SSA::NewVersion(int reg) {
+    VirtualReg v = fn.regs[reg];
+    fn.regs.push_back(v);
+    base.push_back(reg);
+    versions.push_back(0);
+    versions[reg]++;
+    return fn.regs.size() - 1;
+}
+
+void SSA::PlacePhis() {
+    int numRegs = fn.regs.size();
+    vector<vector<int>> defBlocks(numRegs);
+    vector<bool> exposed(numRegs, false);
+    vector<int> definedIn(numRegs, -1);
+
+    auto define = [&](int reg, int b) {
+        definedIn[reg] = b;
+        if (defBlocks[reg].empty() || defBlocks[reg].back() != b)
+            defBlocks[reg].push_back(b);
+    };
+
+    for (int b : cfg.order) {
+        for (const TACObject &taco : cfg.blocks[b].code) {
+            if (taco.a.IsReg() && definedIn[taco.a.value] != b) exposed[taco.a.value] = true;
+            if (taco.b.IsReg() && definedIn[taco.b.value] != b) exposed[taco.b.value] = true;
+
+            int d = DefinedReg(taco);
+            if (d >= 0)
+                define(d, b);
+            if (taco.op == op_Call)
+                for (int g : globals)
+                    define(g, b);
+        }
+    }
+
+    // iterated dominance frontier of each register's definitions
+    vector<int> hasPhi(cfg.blocks.size(), -1);
+    vector<int> queued(cfg.blocks.size(), -1);
+    for (int r = 0; r < numRegs; r++) {
+        if (!exposed[r] || defBlocks[r].empty())
+            continue;
+
+        vector<int> work = defBlocks[r];
+        for (int b : work) queued[b] = r;
+
+        while (!work.empty()) {
+            int x = work.back();
+            work.pop_back();
+            for (int y : cfg.blocks[x].frontier) {
+                if (hasPhi[y] == r)
+                    continue;
+                hasPhi[y] = r;
+                cfg.blocks[y].phis.push_back({ r, r, vector<Operand>(cfg.blocks[y].preds.size()) });
+                if (queued[y] != r) {
+                    queued[y] = r;
+                    work.push_back(y);
+                }
+            }
+        }
+    }
+}
+
+void SSA::Rename() {
+    vector<vector<int>> current(fn.regs.size());   // stack of versions per register
+    auto top = [&](int reg) { return current[reg].empty() ? reg : current[reg].back(); };
+
+    struct Frame { int block; int child; vector<int> pushed; };
+    vector<Frame> frames;
+
+    auto enter = [&](int b, vector<int> &pushed) {
+        auto define = [&](int reg) {
+            int v = NewVersion(reg);
+            current[reg].push_back(v);
+            pushed.push_back(reg);
+            return v;
+        };
+
+        BasicBlock &block = cfg.blocks[b];
+        for (Phi &phi : block.phis)
+            phi.dst = define(phi.var);
+
+        for (TACObject &taco : block.code) {
+            if (taco.a.IsReg()) taco.a.value = top(taco.a.value);
+            if (taco.b.IsReg()) taco.b.value = top(taco.b.value);
+
+            int d = DefinedReg(taco);
+            if (d >= 0)
+                taco.dst.value = define(d);
+            if (taco.op == op_Call)
+                for (int g : globals)
+                    define(g);
+        }
+
+        for (int s : block.succs) {
+            int k = predIndex(cfg.blocks[s], b);
+            for (Phi &phi : cfg.blocks[s].phis)
+                phi.args[k] = Operand::Reg(top(phi.var));
+        }
+    };
+
+    // walk the dominator tree, a block's definitions are visible to the
+    // blocks it dominates
+    frames.push_back({ 0, 0, {} });
+    enter(0, frames.back().pushed);
+    while (!frames.empty()) {
+        Frame &f = frames.back();
+        const vector<int> &children = cfg.blocks[f.block].domChildren;
+        if (f.child < children.size()) {
+            int c = children[f.child++];
+            frames.push_back({ c, 0, {} });
+            enter(c, frames.back().pushed);
+        } else {
+            for (int reg : f.pushed)
+                current[reg].pop_back();
+            frames.pop_back();
+        }
+    }
+}
+
+namespace {
+    enum latticestate { lat_Top, lat_Const, lat_Bottom };
+
+    struct LatticeValue {
+        latticestate state;
+        int value;
+
+        bool operator==(const LatticeValue &o) const {
+            return state == o.state && (state != lat_Const || value == o.value);
+        }
+    };
+
+    const LatticeValue Top = { lat_Top, 0 };
+    const LatticeValue Bottom = { lat_Bottom, 0 };
+
+    LatticeValue Const(int c) { return { lat_Const, c }; }
+
+    LatticeValue Meet(const LatticeValue &x, const LatticeValue &y) {
+        if (x.state == lat_Top) return y;
+        if (y.state == lat_Top) return x;
+        return x == y ? x : Bottom;
+    }
+}
+
+/**
+ * Registers start at top (no value seen yet) and only move down to a
+ * constant and then to bottom. Instructions are evaluated only in blocks
+ * found executable, and a conditional branch on a constant only makes one
+ * of its edges executable, so code that can't run doesn't spoil the
+ * values flowing into the phis below it.
+ */
+void SSA::PropagateConstants() {
+    vector<BasicBlock> &blocks = cfg.blocks;
+    int numRegs = fn.regs.size();
+
+    vector<LatticeValue> value(numRegs, Bottom);
+    vector<vector<pair<int,int>>> uses(numRegs);   // (block, instruction), phi i is -1 - i
+    for (int b : cfg.order) {
+        for (int i = 0; i < blocks[b].phis.size(); i++) {
+            value[blocks[b].phis[i].dst] = Top;
+            for (const Operand &arg : blocks[b].phis[i].args)
+                if (arg.IsReg()) uses[arg.value].emplace_back(b, -1 - i);
+        }
+        for (int i = 0; i < blocks[b].code.size(); i++) {
+            const TACObject &taco = blocks[b].code[i];
+            if (taco.a.IsReg()) uses[taco.a.value].emplace_back(b, i);
+            if (taco.b.IsReg()) uses[taco.b.value].emplace_back(b, i);
+            int d = DefinedReg(taco);
+            if (d >= 0) value[d] = Top;
+        }
+    }
+
+    vector<vector<bool>> executable(blocks.size());    // per predecessor edge
+    for (int b = 0; b < blocks.size(); b++)
+        executable[b].assign(blocks[b].preds.size(), false);
+    vector<bool> visited(blocks.size(), false);
+
+    vector<pair<int,int>> flowWork;
+    vector<int> ssaWork;
+
+    auto valueOf = [&](const Operand &o) {
+        if (o.IsImm()) return Const(o.value);
+        if (o.IsReg()) return value[o.value];
+        return Bottom;
+    };
+
+    auto lower = [&](int reg, LatticeValue v) {
+        LatticeValue old = value[reg];
+        if (old == v || old.state == lat_Bottom || v.state == lat_Top)
+            return;
+        value[reg] = (old.state == lat_Const) ? Bottom : v;
+        ssaWork.push_back(reg);
+    };
+
+    auto evalPhi = [&](int b, int i) {
+        const Phi &phi = blocks[b].phis[i];
+        LatticeValue v = Top;
+        for (int k = 0; k < phi.args.size(); k++)
+            if (executable[b][k])
+                v = Meet(v, valueOf(phi.args[k]));
+        lower(phi.dst, v);
+    };
+
+    auto evalInstr = [&](int b, int i) {
+        const TACObject &taco = blocks[b].code[i];
+        const vector<int> &succs = blocks[b].succs;
+
+        if (taco.op == op_IfGoto) {
+            // an empty condition (for (;;)) is always taken
+            LatticeValue cond = taco.a.IsNone() ? Const(1) : valueOf(taco.a);
+            int fall = succs.size() > 1 ? succs[1] : succs[0];
+            if (cond.state == lat_Top)
+                return;
+            if (cond.state == lat_Bottom || cond.value != 0)
+                flowWork.emplace_back(b, succs[0]);
+            if (cond.state == lat_Bottom || cond.value == 0)
+                flowWork.emplace_back(b, fall);
+            return;
+        }
+
+        int d = DefinedReg(taco);
+        if (d < 0)
+            return;
+
+        LatticeValue v = Bottom;
+        if (taco.op == op_Copy) {
+            v = valueOf(taco.a);
+        } else if (taco.op == op_Neg) {
+            v = valueOf(taco.a);
+            if (v.state == lat_Const)
+                v = Const((int)(0u - (unsigned)v.value));
+        } else if (IsBinary(taco.op)) {
+            LatticeValue x = valueOf(taco.a), y = valueOf(taco.b);
+            int result;
+            if (x.state == lat_Bottom || y.state == lat_Bottom)
+                v = Bottom;
+            else if (x.state == lat_Top || y.state == lat_Top)
+                v = Top;
+            else
+                v = FoldBinary(taco.op, x.value, y.value, result) ? Const(result) : Bottom;
+        }
+        lower(d, v);
+    };
+
+    auto visitBlock = [&](int b) {
+        for (int i = 0; i < blocks[b].phis.size(); i++)
+            evalPhi(b, i);
+        for (int i = 0; i < blocks[b].code.size(); i++)
+            evalInstr(b, i);
+        if (blocks[b].code.empty() || blocks[b].code.back().op != op_IfGoto)
+            for (int s : blocks[b].succs)
+                flowWork.emplace_back(b, s);
+    };
+
+    visited[0] = true;
+    visitBlock(0);
+    while (!flowWork.empty() || !ssaWork.empty()) {
+        while (!flowWork.empty()) {
+            int from = flowWork.back().first, to = flowWork.back().second;
+            flowWork.pop_back();
+
+            int k = predIndex(blocks[to], from);
+            if (executable[to][k])
+                continue;
+            executable[to][k] = true;
+
+            if (visited[to]) {
+                for (int i = 0; i < blocks[to].phis.size(); i++)
+                    evalPhi(to, i);
+            } else {
+                visited[to] = true;
+                visitBlock(to);
+            }
+        }
+
+        while (!ssaWork.empty()) {
+            int reg = ssaWork.back();
+            ssaWork.pop_back();
+            for (const pair<int,int> &use : uses[reg]) {
+                if (!visited[use.first])
+                    continue;
+                if (use.second < 0)
+                    evalPhi(use.first, -1 - use.second);
+                else
+                    evalInstr(use.first, use.second);
+            }
+        }
+    }
+
+    // Rewrite: constants replace the registers holding them, definitions of
+    // local constants go away (nothing reads them anymore), branches on
+    // constants become jumps and blocks never reached are dropped
+    auto fold = [&](Operand &o) {
+        if (o.IsReg() && value[o.value].state == lat_Const)
+            o = Operand::Imm(value[o.value].value);
+    };
+
+    vector<int> layout;
+    for (int b : cfg.layout) {
+        if (!visited[b])
+            continue;
+        layout.push_back(b);
+        BasicBlock &block = blocks[b];
+
+        vector<Phi> phis;
+        for (Phi &phi : block.phis) {
+            if (value[phi.dst].state == lat_Const)
+                continue;
+            for (Operand &arg : phi.args)
+                fold(arg);
+            phis.push_back(phi);
+        }
+        block.phis = phis;
+
+        vector<TACObject> code;
+        for (TACObject &taco : block.code) {
+            fold(taco.a);
+            fold(taco.b);
+
+            int d = DefinedReg(taco);
+            if (d >= 0 && value[d].state == lat_Const && (taco.op == op_Copy || taco.op == op_Neg || IsBinary(taco.op))) {
+                if (fn.IsLocal(base[d]))
+                    continue;
+                taco = TACObject(op_Copy, taco.dst, Operand::Imm(value[d].value));
+            }
+
+            if (taco.op == op_IfGoto && !taco.a.IsReg()) {
+                if (taco.a.IsNone() || taco.a.value != 0)
+                    code.emplace_back(op_Goto, taco.dst);
+                continue;
+            }
+            code.push_back(taco);
+        }
+        block.code = code;
+    }
+    cfg.layout = layout;
+
+    // keep only the edges found executable
+    for (int b = 0; b < blocks.size(); b++) {
+        vector<int> preds;
+        for (int k = 0; k < blocks[b].preds.size(); k++) {
+            if (!executable[b][k])
+                continue;
+            preds.push_back(blocks[b].preds[k]);
+            for (Phi &phi : blocks[b].phis)
+                phi.args[preds.size() - 1] = phi.args[k];
+        }
+        for (Phi &phi : blocks[b].phis)
+            phi.args.resize(preds.size());
+        blocks[b].preds = preds;
+    }
+    for (int b = 0; b < blocks.size(); b++) {
+        vector<int> succs;
+        for (int s : blocks[b].succs)
+            if (find(blocks[s].preds.begin(), blocks[s].preds.end(), b) != blocks[s].preds.end())
+                succs.push_back(s);
+        blocks[b].succs = succs;
+    }
+}
+
+namespace {
+    // An expression as seen by value numbering: operator and the leaders
+    // (or immediates) of its operands
+    struct Expression {
+        tacop op;
+        Operand a, b;
+
+        bool operator==(const Expression &o) const { return op == o.op && a == o.a && b == o.b; }
+    };
+
+    struct ExpressionHash {
+        size_t operator()(const Expression &e) const {
+            size_t h = e.op;
+            h = h * 31 + e.a.kind;
+            h = h * 1000003 + e.a.value;
+            h = h * 31 + e.b.kind;
+            h = h * 1000003 + e.b.value;
+            return h;
+        }
+    };
+
+    bool IsCommutative(tacop op) {
+        return op == op_Add || op == op_Mul || op == op_Equal || op == op_NotEqual
+            || op == op_And || op == op_Or;
+    }
+
+    bool operandLess(const Operand &x, const Operand &y) {
+        return x.kind != y.kind ? x.kind < y.kind : x.value < y.value;
+    }
+}
+
+/**
+ * Walks the dominator tree keeping a table of the expressions computed on
+ * the way down. Every register has a leader: the register that first held
+ * its value. Operands are replaced by their leaders and an expression found
+ * in the table becomes a copy of the register that computed it.
+ *
+ * Only a register with a single definition can lead (a temp, in practice):
+ * after leaving SSA the other versions of a variable share its register,
+ * so the value could be overwritten before the later use.
+ */
+int SSA::NumberValues() {
+    vector<BasicBlock> &blocks = cfg.blocks;
+    vector<int> leader(fn.regs.size());
+    for (int r = 0; r < leader.size(); r++)
+        leader[r] = r;
+
+    auto canLead = [&](int reg) { return versions[base[reg]] == 1 && fn.IsLocal(base[reg]); };
+    auto lead = [&](Operand o) {
+        if (o.IsReg()) o.value = leader[o.value];
+        return o;
+    };
+
+    unordered_map<Expression, int, ExpressionHash> available;
+    vector<Expression> added;                       // undo log of the table
+    struct Frame { int block; int child; int mark; };
+    vector<Frame> frames;
+    int replaced = 0;
+
+    auto enter = [&](int b) {
+        for (Phi &phi : blocks[b].phis) {
+            // a phi choosing between copies of one value is that value
+            bool same = true;
+            for (const Operand &arg : phi.args)
+                if (!arg.IsReg() || leader[arg.value] != leader[phi.args[0].value])
+                    same = false;
+            if (same && !phi.args.empty() && canLead(leader[phi.args[0].value]))
+                leader[phi.dst] = leader[phi.args[0].value];
+        }
+
+        for (TACObject &taco : blocks[b].code) {
+            taco.a = lead(taco.a);
+            taco.b = lead(taco.b);
+
+            int d = DefinedReg(taco);
+            if (d < 0)
+                continue;
+
+            if (taco.op == op_Copy) {
+                if (taco.a.IsReg() && canLead(taco.a.value))
+                    leader[d] = taco.a.value;
+                continue;
+            }
+            if (taco.op != op_Neg && !IsBinary(taco.op))
+                continue;
+
+            Expression e = { taco.op, taco.a, taco.b };
+            if (e.op == op_Greater || e.op == op_GreaterEqual) {
+                e.op = (e.op == op_Greater) ? op_Less : op_LessEqual;
+                swap(e.a, e.b);
+            }
+            if (IsCommutative(e.op) && operandLess(e.b, e.a))
+                swap(e.a, e.b);
+
+            auto found = available.find(e);
+            if (found != available.end()) {
+                taco = TACObject(op_Copy, taco.dst, Operand::Reg(found->second));
+                leader[d] = found->second;
+                replaced++;
+            } else if (canLead(d)) {
+                available[e] = d;
+                added.push_back(e);
+            }
+        }
+    };
+
+    frames.push_back({ 0, 0, 0 });
+    enter(0);
+    while (!frames.empty()) {
+        Frame &f = frames.back();
+        const vector<int> &children = blocks[f.block].domChildren;
+        if (f.child < children.size()) {
+            int c = children[f.child++];
+            frames.push_back({ c, 0, (int)added.size() });
+            enter(c);
+        } else {
+            while (added.size() > f.mark) {
+                available.erase(added.back());
+                added.pop_back();
+            }
+            frames.pop_back();
+        }
+    }
+
+    return replaced;
+}
+
+/**
+ * Orders the copies of one edge, which all take effect at once, so that no
+ * register is overwritten before every copy reading it has been done. A
+ * cycle is broken by saving one register in a new temp.
+ */
+vector<TACObject> SSA::SequenceCopies(vector<pair<Operand,Operand>> copies) {
+    vector<TACObject> seq;
+
+    while (!copies.empty()) {
+        bool done = false;
+        for (int i = 0; i < copies.size() && !done; i++) {
+            Operand dst = copies[i].first;
+            bool read = false;
+            for (int j = 0; j < copies.size(); j++)
+                if (j != i && copies[j].second == dst)
+                    read = true;
+            if (read)
+                continue;
+
+            seq.emplace_back(op_Copy, dst, copies[i].second);
+            copies.erase(copies.begin() + i);
+            done = true;
+        }
+
+        if (!done) {
+            Operand saved = copies[0].first;
+            Operand tmp = Node::NewTemp(fn);
+            base.push_back(tmp.value);
+            versions.push_back(1);
+            seq.emplace_back(op_Copy, tmp, saved);
+            for (auto &copy : copies)
+                if (copy.second == saved)
+                    copy.second = tmp;
+        }
+    }
+    return seq;
+}
+
+/**
+ * Puts the copies on the edge pred -> succ: at the end of pred when it has
+ * no other successor, otherwise in a new block on the edge.
+ */
+void SSA::PlaceCopies(int pred, int succ, const vector<TACObject> &copies) {
+    vector<BasicBlock> &blocks = cfg.blocks;
+
+    if (blocks[pred].succs.size() == 1) {
+        vector<TACObject> &code = blocks[pred].code;
+        bool jumps = !code.empty() && (IsBranch(code.back().op) || code.back().op == op_Return);
+        code.insert(jumps ? code.end() - 1 : code.end(), copies.begin(), copies.end());
+        return;
+    }
+
+    int n = cfg.NewBlock();
+    BasicBlock &edge = blocks[n];
+    edge.code.insert(edge.code.end(), copies.begin(), copies.end());
+
+    vector<int>::iterator at = find(cfg.layout.begin(), cfg.layout.end(), pred);
+    TACObject &branch = blocks[pred].code.back();
+
+    if (blocks[pred].succs[0] == succ && branch.op == op_IfGoto) {
+        // the taken edge: branch to the new block, which jumps on to succ.
+        // It goes after the first block that doesn't fall through.
+        branch.dst = Operand::Label(edge.label);
+        edge.code.emplace_back(op_Goto, Operand::Label(blocks[succ].label));
+        while (at != cfg.layout.end() && (blocks[*at].code.empty() || blocks[*at].code.back().op != op_Goto))
+            ++at;
+        cfg.layout.insert(at == cfg.layout.end() ? at : at + 1, n);
+    } else {
+        // the fall through edge: the new block goes between pred and succ
+        cfg.layout.insert(at + 1, n);
+    }
+}
+
+void SSA::Leave() {
+    vector<BasicBlock> &blocks = cfg.blocks;
+    auto original = [&](const Operand &o) {
+        return o.IsReg() ? Operand::Reg(base[o.value]) : o;
+    };
+
+    vector<int> layout = cfg.layout;
+    for (int s : layout) {
+        if (blocks[s].phis.empty())
+            continue;
+
+        for (int k = 0; k < blocks[s].preds.size(); k++) {
+            vector<pair<Operand,Operand>> copies;
+            for (const Phi &phi : blocks[s].phis) {
+                Operand dst = Operand::Reg(base[phi.dst]);
+                Operand src = original(phi.args[k]);
+                if (src != dst)
+                    copies.emplace_back(dst, src);
+            }
+            if (!copies.empty())
+                PlaceCopies(blocks[s].preds[k], s, SequenceCopies(copies));
+        }
+        blocks[s].phis.clear();
+    }
+
+    // the versions are gone from the code, so their registers are dropped
+    // and the temps made to sequence copies move down after the originals
+    vector<int> moved(fn.regs.size(), -1);
+    int next = originals;
+    for (int r = originals; r < fn.regs.size(); r++)
+        if (base[r] == r) {
+            fn.regs[next] = fn.regs[r];
+            moved[r] = next++;
+        }
+    fn.regs.resize(next);
+    auto renumbered = [&](const Operand &o) {
+        Operand r = original(o);
+        return r.IsReg() && r.value >= originals ? Operand::Reg(moved[r.value]) : r;
+    };
+
+    for (int b : cfg.layout) {
+        for (TACObject &taco : blocks[b].code) {
+            taco.dst = renumbered(taco.dst);
+            taco.a = renumbered(taco.a);
+            taco.b = renumbered(taco.b);
+        }
+    }
+
+    cfg.Linearize();
+}
+
+void constantPropagation(TACFunction &fn) {
+    CFG cfg(fn);
+    SSA ssa(cfg);
+    ssa.PropagateConstants();
+    ssa.Leave();
+}
+
+void globalValueNumbering(TACFunction &fn) {
+    CFG cfg(fn);
+    SSA ssa(cfg);
+    int replaced = ssa.NumberValues();
+    ssa.Leave();
+
+    PrintDebug("gvn", "%s: %d redundant computations removed",
+               fn.name >= 0 ? SymbolName(fn.name).c_str() : "<top level>", replaced);
+}
@@ -0,0 +1,69 @@
+/**
+ * File: ssa.h
+ * -----------
+ * Static single assignment form of a function and the passes that run on
+ * it.
+ *
+ * Building SSA gives every definition its own register (a version of the
+ * original one), places phis at the iterated dominance frontier of each
+ * register's definitions (only for registers read before being written in
+ * some block) and renames uses along the dominator tree. A call counts as
+ * a definition of every global variable, since the callee may assign it.
+ *
+ * The versions of one register are never live at the same time (no pass
+ * moves a use past another definition), so leaving SSA maps every version
+ * back to its original register and only phis whose arguments became
+ * constants need copies, sequenced as parallel copies on each edge.
+ */
+
+#ifndef _H_ssa
+#define _H_ssa
+
+#include "cfg.h"
+
+class SSA {
+  public:
+    explicit SSA(CFG &cfg);
+
+    // Sparse conditional constant propagation (Wegman and Zadeck)
+    void PropagateConstants();
+
+    // Dominator based value numbering, returns the number of computations
+    // replaced by a copy of an earlier result
+    int NumberValues();
+
+    // Back to plain TAC, written to the function's code
+    void Leave();
+
+  private:
+    CFG &cfg;
+    TACFunction &fn;
+    vector<int> base;           // register -> the register it is a version of
+    vector<int> globals;        // registers of global variables
+    vector<int> versions;       // register -> number of versions made of it
+    int originals;              // registers the function had before SSA
+
+    int NewVersion(int reg);
+    void PlacePhis();
+    void Rename();
+    vector<TACObject> SequenceCopies(vector<pair<Operand,Operand>> copies);
+    void PlaceCopies(int pred, int succ, const vector<TACObject> &copies);
+};
+
+/**
+ * Folds constants across branches and loops and removes the branches that
+ * can never be taken.
+ *
+ * @param fn : the function to optimize
+ */
+void constantPropagation(TACFunction &fn);
+
+/**
+ * Replaces computations already done on the same values in a dominating
+ * block by a copy of the first result.
+ *
+ * @param fn : the function to optimize
+ */
+void globalValueNumbering(TACFunction &fn);
+
+#endif
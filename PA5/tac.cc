@@ -0,0 +1,202 @@
+/* File: tac.cc
+ * ------------
+ * Symbol table, register bookkeeping and printing of the three-address code.
+ */
+
+#include "tac.h"
+#include <iostream>
+
+static vector<string> symbols;
+static unordered_map<string, int> symbolIds;
+static int labelCounter = 0;
+
+int Intern(const string &name) {
+    auto it = symbolIds.find(name);
+    if (it != symbolIds.end())
+        return it->second;
+
+    symbols.push_back(name);
+    symbolIds[name] = symbols.size() - 1;
+    return symbols.size() - 1;
+}
+
+const string &SymbolName(int sym) {
+    return symbols[sym];
+}
+
+int NewLabelNumber() {
+    return labelCounter++;
+}
+
+int TACFunction::NewTemp(int n) {
+    regs.push_back({ -1, n, true });
+    return regs.size() - 1;
+}
+
+int TACFunction::Variable(int sym) {
+    auto it = vars.find(sym);
+    if (it != vars.end())
+        return it->second;
+
+    regs.push_back({ sym, 0, false });
+    vars[sym] = regs.size() - 1;
+    return regs.size() - 1;
+}
+
+int TACFunction::LocalVariable(int sym) {
+    int reg = Variable(sym);
+    regs[reg].local = true;
+    return reg;
+}
+
+/**
+ * Passes that need a register assigned more than once use a variable, temps
+ * are only ever assigned once.
+ */
+int TACFunction::NewVariable(int sym) {
+    for (int n = 1; ; n++) {
+        int copy = Intern(SymbolName(sym) + "." + to_string(n));
+        if (vars.find(copy) == vars.end())
+            return LocalVariable(copy);
+    }
+}
+
+bool IsBinary(tacop op) {
+    return op >= op_Add && op <= op_Or;
+}
+
+bool IsBranch(tacop op) {
+    return op == op_IfGoto || op == op_Goto;
+}
+
+/**
+ * Arithmetic wraps around at 32 bits like the MIPS instructions it stands
+ * for; division by zero is left for run time.
+ */
+bool FoldBinary(tacop op, int a, int b, int &result) {
+    unsigned ua = a, ub = b;
+    switch (op) {
+        case op_Add:            result = (int)(ua + ub); return true;
+        case op_Sub:            result = (int)(ua - ub); return true;
+        case op_Mul:            result = (int)(ua * ub); return true;
+        case op_Div:
+            if (b == 0) return false;
+            result = (b == -1) ? (int)(0u - ua) : a / b;
+            return true;
+        case op_Less:           result = a < b;  return true;
+        case op_LessEqual:      result = a <= b; return true;
+        case op_Greater:        result = a > b;  return true;
+        case op_GreaterEqual:   result = a >= b; return true;
+        case op_Equal:          result = a == b; return true;
+        case op_NotEqual:       result = a != b; return true;
+        case op_And:            result = a && b; return true;
+        case op_Or:             result = a || b; return true;
+        default:                return false;
+    }
+}
+
+const char *OperatorString(tacop op) {
+    switch (op) {
+        case op_Neg:
+        case op_Sub:            return "-";
+        case op_Add:            return "+";
+        case op_Mul:            return "*";
+        case op_Div:            return "/";
+        case op_Less:           return "<";
+        case op_LessEqual:      return "<=";
+        case op_Greater:        return ">";
+        case op_GreaterEqual:   return ">=";
+        case op_Equal:          return "==";
+        case op_NotEqual:       return "!=";
+        case op_And:            return "&&";
+        case op_Or:             return "||";
+        default:                return "?";
+    }
+}
+
+int DefinedReg(const TACObject &taco) {
+    switch (taco.op) {
+        case op_Copy:
+        case op_Neg:
+        case op_LoadParam:
+        case op_Call:
+        case op_ReadInt:
+            return taco.dst.IsReg() ? taco.dst.value : -1;
+        default:
+            return IsBinary(taco.op) && taco.dst.IsReg() ? taco.dst.value : -1;
+    }
+}
+
+string OperandString(const TACFunction &fn, const Operand &o) {
+    switch (o.kind) {
+        case opnd_Reg: {
+            const VirtualReg &r = fn.regs[o.value];
+            return r.name < 0 ? "t" + to_string(r.temp) : SymbolName(r.name);
+        }
+        case opnd_Imm:   return to_string(o.value);
+        case opnd_Bool:  return o.value ? "true" : "false";
+        case opnd_Label: return "L" + to_string(o.value);
+        case opnd_Sym:   return SymbolName(o.value);
+        default:         return "";
+    }
+}
+
+/**
+ * Prints a function in the textual TAC format. Top-level code (global
+ * initializers) has no label.
+ *
+ * @param fn    : the function to print
+ * @param out   : where to print it
+ * @param label : false to leave out the function's label
+ */
+void generateIR(const TACFunction &fn, ostream &out, bool label) {
+    if (label && fn.name >= 0)
+        out << SymbolName(fn.name) << ":" << endl;
+
+    for (const TACObject &taco : fn.code) {
+        string dst = OperandString(fn, taco.dst);
+        string a = OperandString(fn, taco.a);
+        string b = OperandString(fn, taco.b);
+
+        switch (taco.op) {
+            case op_Label:  out << dst << ":" << endl;
+                break;
+            case op_Copy:   out << "    " << dst << " := " << a << endl;
+                break;
+            case op_Neg:    out << "    " << dst << " := - " << a << endl;
+                break;
+            case op_IfGoto: out << "    if " << a << " goto " << dst << endl;
+                break;
+            case op_Goto:   out << "    goto " << dst << endl;
+                break;
+            case op_BeginFunc:
+            case op_PopParam:
+                            out << "    " << (taco.op == op_BeginFunc ? "BeginFunc " : "PopParam ") << a << endl;
+                break;
+            case op_EndFunc:          out << "    EndFunc " << endl;
+                break;
+            case op_Return:           out << "    Return " << a << endl;
+                break;
+            case op_LoadParam:        out << "    LoadParam " << dst << endl;
+                break;
+            case op_PushParam:        out << "    PushParam " << a << endl;
+                break;
+            case op_SaveRegisters:    out << "    SaveRegisters " << endl;
+                break;
+            case op_RestoreRegisters: out << "    RestoreRegisters " << endl;
+                break;
+            case op_Call:   out << "    " << dst << " call " << a << " " << b << endl;
+                break;
+            case op_ReadInt:
+                            out << "    " << dst << " call readIntFromSTDIN 0" << endl;
+                break;
+            case op_Print:  out << "    Print call " << a << endl;
+                break;
+            default:
+                if (IsBinary(taco.op))
+                    out << "    " << dst << " := " << a << " " << OperatorString(taco.op) << " " << b << endl;
+                else
+                    out << " ERRRORRR !!!! " << endl;
+        }
+    }
+}
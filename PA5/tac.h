@@ -0,0 +1,132 @@
+/**
+ * File: tac.h
+ * -----------
+ * Three-address code produced by the Emit() methods and consumed by the
+ * optimization passes and the MIPS generator.
+ *
+ * Every instruction is a TACObject: an opcode plus up to three typed
+ * operands (destination and two sources). An operand is a virtual register,
+ * an integer immediate, a label number or a symbol (function name), so no
+ * pass ever has to split or re-parse instruction text. The instructions of
+ * a function are stored contiguously in its TACFunction together with the
+ * table describing its virtual registers.
+ *
+ * Names (functions, variables) are interned once into a program wide
+ * symbol table and referred to by index from then on.
+ */
+
+#ifndef _H_tac
+#define _H_tac
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+enum tacop {
+    op_Label,           // L:
+    op_Copy,            // dst := a
+    op_Neg,             // dst := - a
+    op_Add, op_Sub, op_Mul, op_Div,                         // dst := a op b
+    op_Less, op_LessEqual, op_Greater, op_GreaterEqual,
+    op_Equal, op_NotEqual,
+    op_And, op_Or,
+    op_IfGoto,          // if a goto L
+    op_Goto,            // goto L
+    op_BeginFunc,       // BeginFunc <frame bytes>
+    op_EndFunc,
+    op_Return,          // Return a
+    op_LoadParam,       // LoadParam dst        (a = parameter index)
+    op_PushParam,       // PushParam a
+    op_PopParam,        // PopParam <bytes>
+    op_SaveRegisters,
+    op_RestoreRegisters,
+    op_Call,            // dst call f n
+    op_ReadInt,         // dst call readIntFromSTDIN 0
+    op_Print            // Print call a
+};
+
+// A boolean constant is an immediate (0 or 1) that prints as true/false
+enum operandkind { opnd_None, opnd_Reg, opnd_Imm, opnd_Bool, opnd_Label, opnd_Sym };
+
+struct Operand {
+    operandkind kind;
+    int value;          // register id, immediate, label number or symbol
+
+    Operand() : kind(opnd_None), value(0) {}
+    Operand(operandkind k, int v) : kind(k), value(v) {}
+
+    static Operand Reg(int id)   { return Operand(opnd_Reg, id); }
+    static Operand Imm(int val)  { return Operand(opnd_Imm, val); }
+    static Operand Bool(bool b)  { return Operand(opnd_Bool, b ? 1 : 0); }
+    static Operand Label(int n)  { return Operand(opnd_Label, n); }
+    static Operand Sym(int sym)  { return Operand(opnd_Sym, sym); }
+
+    bool IsNone() const  { return kind == opnd_None; }
+    bool IsReg() const   { return kind == opnd_Reg; }
+    bool IsImm() const   { return kind == opnd_Imm || kind == opnd_Bool; }
+
+    bool operator==(const Operand &o) const { return kind == o.kind && value == o.value; }
+    bool operator!=(const Operand &o) const { return !(*this == o); }
+};
+
+struct TACObject {
+    tacop op;
+    Operand dst;        // register written, or the label of Label/Goto/IfGoto
+    Operand a, b;       // sources, for Call the callee symbol and arg count
+
+    TACObject(tacop op, Operand dst = Operand(), Operand a = Operand(), Operand b = Operand()) :
+    op(op),
+    dst(dst),
+    a(a),
+    b(b) {
+    }
+};
+
+// A virtual register is either a named source variable or a compiler temp
+struct VirtualReg {
+    int name;           // symbol of the variable, -1 for a temp
+    int temp;           // N of the temp's name "tN"
+    bool local;         // declared in the function (temps are always local)
+};
+
+struct TACFunction {
+    int name;                       // symbol, -1 for top-level code
+    vector<TACObject> code;
+    vector<VirtualReg> regs;        // indexed by register id
+    unordered_map<int, int> vars;   // variable symbol -> register id
+
+    explicit TACFunction(int name) : name(name) {}
+
+    int NewTemp(int n);
+    int Variable(int sym);
+    int LocalVariable(int sym);
+    int NewVariable(int sym);       // fresh local named after a variable: x.1, x.2, ...
+    bool IsLocal(int reg) const { return regs[reg].name < 0 || regs[reg].local; }
+};
+
+// Program wide symbol table
+int Intern(const string &name);
+const string &SymbolName(int sym);
+
+// Label numbers are unique across the program
+int NewLabelNumber();
+
+// Result of a binary operator on constants, false when it would trap
+bool FoldBinary(tacop op, int a, int b, int &result);
+
+// Instruction classification used by the passes
+bool IsBinary(tacop op);
+bool IsBranch(tacop op);        // transfers control to dst
+const char *OperatorString(tacop op);
+
+// Register id written by the instruction, -1 if none
+int DefinedReg(const TACObject &taco);
+
+// Text rendering of operands and whole functions in the IR dump format
+string OperandString(const TACFunction &fn, const Operand &o);
+void generateIR(const TACFunction &fn, ostream &out, bool label = true);
+
+#endif
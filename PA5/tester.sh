@@ -14,16 +14,24 @@ function usage() {
     echo -e "$0 [OPTIONS]...\n"
     echo -e "OPTIONS"
     echo -e "  --all Compares all solution files"
+    echo -e "  --scale [N] Compares the time of each pass, and of the whole compile,"
+    echo -e "              on a function of N loops (200 by default) and on one of 2N"
     exit 1
 }
 
+# The options a sample is compiled with, from a first line like
+# "// flags: -passes=licm -d tac"; none for the others
+function flags_of() {
+    sed -n '1s|^// flags:||p' $1
+}
+
 function compare_all() {
     mkdir -p ${OUTFILES}
 
     for file in $(ls samples/*.java); do
 
         filename=$(echo $file | cut -f1 -d '.' | cut -f2 -d '/')
-        ./parser < $file > ${OUTFILES}/$filename.out
+        ./parser $(flags_of $file) < $file > ${OUTFILES}/$filename.out
 
         if diff -s ${OUTFILES}/$filename.out samples/$filename.out > /dev/null; then
             echo "${TXT_GREEN}[PASSED]${TXT_RESET} $file"
@@ -49,14 +57,53 @@ function compare_pattern() {
 
 function compare_diff() {
     if [[ $(which colordiff) =~ "not found" ]]; then
-        diff -yW"`tput cols`" <(./parser < samples/$1.java) <(cat samples/$1.out)
+        diff -yW"`tput cols`" <(./parser $(flags_of samples/$1.java) < samples/$1.java) <(cat samples/$1.out)
         echo "Note: install colordiff for nicer output"
     else
         if [ -z "$2" ]; then col="`tput cols`"; else col="$2"; fi
-        colordiff -yW "$col" <(./parser < samples/$1.java) <(cat samples/$1.out)
+        colordiff -yW "$col" <(./parser $(flags_of samples/$1.java) < samples/$1.java) <(cat samples/$1.out)
     fi
 }
 
+# The pass report of -time-passes as "name milliseconds" lines, with MIPS
+# emission (register allocation included), register allocation alone and
+# the whole compile, parsing and all, as "compile"
+function pass_times() {
+    start=$(date +%s%N)
+    ./parser -time-passes < $1 2>&1 > /dev/null | awk '
+        /^Pass/        { on = 1; next }
+        /^Total/       { on = 0 }
+        on && NF >= 3  { print $1, $3 }
+        /^Functions:/  { print "emission", $(NF - 1) }
+        /^Allocator:/  { print "regalloc", $(NF - 1) }'
+    echo "compile $((($(date +%s%N) - start) / 1000000))"
+}
+
+# Twice the loops should take about twice the time; a pass taking more than
+# three times as long (and long enough to measure) grows faster than that
+function scale() {
+    n=${1:-200}
+    mkdir -p ${OUTFILES}
+    for size in $n $((2 * n)); do
+        bench/big_function.sh $size > ${OUTFILES}/big$size.java
+        pass_times ${OUTFILES}/big$size.java > ${OUTFILES}/big$size.times
+    done
+
+    awk -v green="${TXT_GREEN}" -v red="${TXT_RED}" -v reset="${TXT_RESET}" -v n=$n '
+        NR == FNR { before[$1] = $2; next }
+        {
+            slow = $2 > 50 && $2 > 3 * before[$1]
+            printf "%s[%s]%s %-10s %10.1f ms for %d loops, %10.1f ms for %d\n",
+                   slow ? red : green, slow ? "FAILED" : "PASSED", reset, $1, before[$1], n, $2, 2 * n
+            failed += slow
+        }
+        END { exit failed > 0 }' ${OUTFILES}/big$n.times ${OUTFILES}/big$((2 * n)).times
+    status=$?
+
+    rm -rf ${OUTFILES}
+    return $status
+}
+
 function rebuild() {
     make clean
     make > /dev/null
@@ -66,6 +113,7 @@ while true; do
     case "$1" in
         --all  ) compare_all; break ;;
         --alld ) compare_all $1; break ;;
+        --scale ) scale $2; exit $? ;;
         -p    ) compare_pattern $2; break ;;
         -d    ) compare_diff $2 $3; break ;;
         -r    ) rebuild; break ;;
@@ -11,6 +11,10 @@
 using std::vector;
 
 static vector<const char*> debugKeys;
+static vector<const char*> optionNames;
+static vector<int> optionValues;
+static vector<const char*> stringOptionNames;
+static vector<const char*> stringOptionValues;
 static const int BufferSize = 2048;
 
 void Failure(const char *format, ...) {
@@ -58,19 +62,81 @@ void PrintDebug(const char *key, const char *format, ...) {
   printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
-void ParseCommandLine(int argc, char *argv[]) {
-  if (argc == 1)
-    return;
-  
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Incorrect Use:   ");
-    for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
-    printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
-    exit(2);
+int GetOption(const char *name, int defaultValue) {
+  for (unsigned int i = 0; i < optionNames.size(); i++)
+    if (!strcmp(optionNames[i], name))
+      return optionValues[i];
+
+  return defaultValue;
+}
+
+const char *GetStringOption(const char *name, const char *defaultValue) {
+  for (unsigned int i = 0; i < stringOptionNames.size(); i++)
+    if (!strcmp(stringOptionNames[i], name))
+      return stringOptionValues[i];
+
+  return defaultValue;
+}
+
+// Records -f<name>=<value>, -O<level>, -passes=<list>, -regalloc=<name>
+// or -time-passes, returns false if the argument isn't one of them
+static bool ParseOption(char *arg) {
+  static const char *stringOptions[] = { "passes", "regalloc" };
+
+  if (!strcmp(arg, "-time-passes")) {
+    optionNames.push_back("time-passes");
+    optionValues.push_back(1);
+    return true;
   }
+  for (const char *name : stringOptions) {
+    size_t length = strlen(name);
+    if (arg[0] == '-' && !strncmp(arg + 1, name, length) && arg[length + 1] == '=') {
+      stringOptionNames.push_back(name);
+      stringOptionValues.push_back(arg + length + 2);
+      return true;
+    }
+  }
+  if (!strncmp(arg, "-O", 2)) {
+    char *end;
+    int level = strtol(arg + 2, &end, 10);
+    if (*end != '\0' || end == arg + 2)
+      return false;
+    optionNames.push_back("opt-level");
+    optionValues.push_back(level);
+    return true;
+  }
+
+  char *equals = strchr(arg, '=');
+  if (strncmp(arg, "-f", 2) != 0 || equals == NULL || equals == arg + 2)
+    return false;
+
+  char *end;
+  int value = strtol(equals + 1, &end, 10);
+  if (*end != '\0' || end == equals + 1)
+    return false;
 
-  for (int i = 2; i < argc; i++)
-    SetDebugForKey(argv[i], true);
+  *equals = '\0';
+  optionNames.push_back(arg + 2);
+  optionValues.push_back(value);
+  return true;
 }
 
+void ParseCommandLine(int argc, char *argv[]) {
+  bool debugFlags = false;     // after -d
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-d")) {
+      debugFlags = true;
+    } else if (ParseOption(argv[i])) {
+      debugFlags = false;
+    } else if (debugFlags) {
+      SetDebugForKey(argv[i], true);
+    } else {
+      printf("Incorrect Use:   ");
+      for (int j = 1; j < argc; j++) printf("%s ", argv[j]);
+      printf("\n");
+      printf("Correct Usage:   [-O<level>] [-passes=<pass>,...] [-regalloc=<linear|graph>] [-time-passes] [-f<option>=<value> ...] -d <debug-key-1> <debug-key-2> ... \n");
+      exit(2);
+    }
+  }
+}
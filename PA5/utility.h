@@ -73,12 +73,35 @@ void SetDebugForKey(const char *key, bool val);
 
 bool IsDebugOn(const char *key);
 
+/**
+ * Function: GetOption()
+ * Usage: int limit = GetOption("inline-limit", 30);
+ * -------------------------------------------------
+ * Return the value of an option given on the command line as
+ * -f<name>=<value>, or the default when it was not given.
+ */
+
+int GetOption(const char *name, int defaultValue);
+
+/**
+ * Function: GetStringOption()
+ * Usage: const char *pipeline = GetStringOption("passes", NULL);
+ * --------------------------------------------------------------
+ * Return the value of an option given on the command line as
+ * -<name>=<value> (-passes=..., -regalloc=...), or the default when it
+ * was not given.
+ */
+
+const char *GetStringOption(const char *name, const char *defaultValue);
+
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the debugging flags and set the options from the command line.
+ * Options are given as -f<name>=<value>, -O<level> (the option
+ * "opt-level"), -passes=<pass,...>, -regalloc=<linear|graph> and
+ * -time-passes (the option "time-passes", set to 1); the arguments
+ * following -d are the debugging flags to turn on.
  */
 
 void ParseCommandLine(int argc, char *argv[]);